@@ -0,0 +1,106 @@
+/**
+ * @file adaptive_window.h
+ *
+ * Flow control for a single sender in a subgroup: decides how many of its
+ * messages may be outstanding at once, between a configured minimum and
+ * the maximum for which SST slots and RDMC buffers were provisioned.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include "derecho_internal.h"
+
+namespace derecho {
+
+/**
+ * An additive-increase/multiplicative-decrease controller for a sender's
+ * window. The window grows by one message per round (a round is one window's
+ * worth of messages) in which the sender was blocked by the window, and is
+ * halved when the time from handing out a send buffer to the message being
+ * retired at every shard member grows beyond twice the smallest time seen,
+ * since a bigger window then only lengthens the queue at the receivers.
+ */
+class AdaptiveWindow {
+    const unsigned int min_size;
+    const unsigned int max_size;
+    /** The current limit; read without the lock by the sender thread and predicates. */
+    std::atomic<unsigned int> active_size;
+    /** Highest message index retired at all shard members; -1 if none. */
+    std::atomic<message_id_t> last_retired_index{-1};
+
+    std::mutex mtx;
+    /** Time each outstanding message was handed out, indexed by message index modulo max_size. */
+    std::vector<uint64_t> send_times;
+    uint64_t min_rtt = std::numeric_limits<uint64_t>::max();
+    uint64_t smoothed_rtt = 0;
+    bool blocked_this_round = false;
+    message_id_t round_end_index;
+
+public:
+    AdaptiveWindow(unsigned int min_size, unsigned int max_size)
+            : min_size(std::max(1u, std::min(min_size, max_size))),
+              max_size(max_size),
+              active_size(max_size),
+              send_times(max_size, 0),
+              round_end_index(max_size) {}
+
+    /** @return the number of messages the sender may currently have outstanding. */
+    unsigned int size() const { return active_size.load(std::memory_order_relaxed); }
+    /** @return true if the window can change at all. */
+    bool is_adaptive() const { return min_size < max_size; }
+    message_id_t get_last_retired_index() const { return last_retired_index.load(std::memory_order_relaxed); }
+
+    /** Records that a buffer for the message with this index was handed out at time now. */
+    void on_send(message_id_t index, uint64_t now) {
+        std::lock_guard<std::mutex> lock(mtx);
+        send_times[index % max_size] = now;
+    }
+
+    /** Records that the sender asked for a buffer but the active window was full. */
+    void on_blocked() {
+        std::lock_guard<std::mutex> lock(mtx);
+        blocked_this_round = true;
+    }
+
+    /**
+     * Records that every message up to retired_index has been retired by all
+     * shard members, and adjusts the window at the end of each round.
+     */
+    void on_retired(message_id_t retired_index, uint64_t now) {
+        std::lock_guard<std::mutex> lock(mtx);
+        message_id_t previous = last_retired_index.load(std::memory_order_relaxed);
+        if(retired_index <= previous) {
+            return;
+        }
+        for(message_id_t index = previous + 1; index <= retired_index; ++index) {
+            uint64_t& send_time = send_times[index % max_size];
+            // Indices skipped by pause_sending_turns have no send time
+            if(send_time != 0 && now >= send_time) {
+                const uint64_t rtt = now - send_time;
+                min_rtt = std::min(min_rtt, rtt);
+                smoothed_rtt = smoothed_rtt ? (7 * smoothed_rtt + rtt) / 8 : rtt;
+            }
+            send_time = 0;
+        }
+        last_retired_index.store(retired_index, std::memory_order_relaxed);
+        if(retired_index < round_end_index) {
+            return;
+        }
+        unsigned int new_size = size();
+        if(smoothed_rtt > 2 * min_rtt) {
+            new_size = std::max(min_size, new_size / 2);
+        } else if(blocked_this_round) {
+            new_size = std::min(max_size, new_size + 1);
+        }
+        active_size.store(new_size, std::memory_order_relaxed);
+        blocked_this_round = false;
+        round_end_index = retired_index + new_size;
+    }
+};
+}  // namespace derecho
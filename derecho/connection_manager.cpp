@@ -64,14 +64,11 @@ bool tcp_connections::add_connection(const node_id_t other_id,
 void tcp_connections::establish_node_connections(const std::map<node_id_t, ip_addr_t>& ip_addrs) {
     conn_listener = std::make_unique<connection_listener>(port);
 
+    sockets = establish_connections(my_id, ip_addrs, port, *conn_listener);
     for(auto it = ip_addrs.begin(); it != ip_addrs.end(); it++) {
-        //Check that there isn't already a connection to this ID,
-        //since an earlier add_connection could have connected to it by "mistake"
         if(it->first != my_id && sockets.count(it->first) == 0) {
-            if(!add_connection(it->first, it->second)) {
-                std::cerr << "WARNING: failed to connect to node " << it->first
-                          << " at " << it->second << std::endl;
-            }
+            std::cerr << "WARNING: failed to connect to node " << it->first
+                      << " at " << it->second << std::endl;
         }
     }
 }
@@ -36,4 +36,12 @@ struct empty_reference_exception : public derecho_exception {
 struct invalid_subgroup_exception : public derecho_exception {
     invalid_subgroup_exception(const std::string& message) : derecho_exception(message) {}
 };
+
+/**
+ * Exception that means a message tracked by a MessageCompletion was dropped
+ * by a view change, and so will not reach the milestone it was waited on for.
+ */
+struct message_abandoned_exception : public derecho_exception {
+    message_abandoned_exception(const std::string& message) : derecho_exception(message) {}
+};
 }
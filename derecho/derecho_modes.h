@@ -2,7 +2,12 @@
 
 namespace derecho {
 enum class Mode {
+    /** Total order across senders, delivered once stable at all shard members */
     ORDERED,
-    UNORDERED
+    /** Raw mode: each message is delivered as soon as it is received */
+    UNORDERED,
+    /** Each sender's messages are delivered in that sender's order once
+     * stable at all shard members, without waiting for other senders */
+    FIFO_STABLE
 };
 }
@@ -66,16 +66,16 @@ std::string DerechoSST::to_string() const {
             s << changes[row][n] << " ";
         }
         s << "}, num_acked= " << num_acked[row] << ", num_received={ ";
-        for(unsigned int n = 0; n < num_received.size(); n++) {
-            s << num_received[row][n] << " ";
+        for(unsigned int n = 0; n < receive_counters.size(); n++) {
+            s << receive_counters[row][n].num_received << " ";
         }
         s << "}, joiner_ips={ ";
         for(int n = 0; n < (num_changes[row] - num_installed[row]); ++n) {
             s << joiner_ips[row][n] << " ";
         }
         s << "}, seq_num={ ";
-        for(unsigned int n = 0; n < seq_num.size(); n++) {
-            s << seq_num[row][n] << " ";
+        for(unsigned int n = 0; n < receive_counters.size(); n++) {
+            s << receive_counters[row][n].seq_num << " ";
         }
         s << "}"
           << ", stable_num={ ";
@@ -10,30 +10,54 @@
 #include "derecho_internal.h"
 #include "sst/multicast_msg.h"
 #include "sst/sst.h"
+#include "time/time.h"
 
 namespace derecho {
 
 using sst::SSTField;
 using sst::SSTFieldVector;
+
 /**
- * The GMS and derecho_group will share the same SST for efficiency. This class
- * defines all the fields in this SST.
+ * The counters a receiver updates on every receive, for one sender of a
+ * subgroup; an entry of receive_counters is indexed like num_received_offset
+ * + sender rank. A subgroup's entries are next to each other, so they are all
+ * acknowledged with a single put.
  */
-class DerechoSST : public sst::SST<DerechoSST> {
-public:
-    // MulticastGroup members, related only to tracking message delivery
+struct ReceiveCounters {
+    /** The index of the last message received from the sender through SST
+     * multicast. */
+    int32_t num_received_sst;
+    /** Local count of number of received messages from the sender (a.k.a.
+     * "locally stable"). */
+    int32_t num_received;
     /**
-     * Sequence numbers are interpreted like a row-major pair:
-     * (sender, index) becomes sender + num_members * index.
-     * Since the global order is round-robin, the correct global order of
-     * messages becomes a consecutive sequence of these numbers: with 4
+     * Only used in a subgroup's first entry. Sequence numbers are interpreted
+     * like a row-major pair: (sender, index) becomes sender + num_members *
+     * index. Since the global order is round-robin, the correct global order
+     * of messages becomes a consecutive sequence of these numbers: with 4
      * senders, we expect to receive (0,0), (1,0), (2,0), (3,0), (0,1),
      * (1,1), ... which is 0, 1, 2, 3, 4, 5, ....
      *
      * This variable is the highest sequence number that has been received
      * in-order by this node; if a node updates seq_num, it has received all
-     * messages up to seq_num in the global round-robin order. */
-    SSTFieldVector<message_id_t> seq_num;
+     * messages of the subgroup up to seq_num in the global round-robin order.
+     */
+    message_id_t seq_num;
+};
+
+/**
+ * The GMS and derecho_group will share the same SST for efficiency. This class
+ * defines all the fields in this SST.
+ */
+class DerechoSST : public sst::SST<DerechoSST> {
+public:
+    // MulticastGroup members, related only to tracking message delivery.
+    // receive_counters is updated on every receive, so it starts on its own
+    // cache line; the other counters that change on the delivery path follow
+    // it.
+    /** For each sender in each subgroup, the counters updated as its
+     * messages are received, with the subgroup's seq_num in its first entry. */
+    SSTFieldVector<ReceiveCounters> receive_counters;
     /** This represents the highest sequence number that has been received
      * by every node, as observed by this node. If a node updates stable_num,
      * then it believes that all messages up to stable_num in the global
@@ -47,6 +71,9 @@ public:
      * persisted to disk at this node, if persistence is enabled. This is
      * updated by the PersistenceManager. */
     SSTFieldVector<persistent::version_t> persisted_num;
+    /** For FIFO_STABLE subgroups, the index of the last message delivered at
+     * this node from each sender. Indexed the same way as num_received. */
+    SSTFieldVector<int32_t> delivered_index;
 
     // Group management service members, related only to handling view changes
     /** View ID associated with this SST. VIDs monotonically increase as views change. */
@@ -79,24 +106,19 @@ public:
     /** How many previously proposed view changes have been installed in the
      * current view. Monotonically increases, lower bound on num_committed. */
     SSTField<int> num_installed;
-    /** Local count of number of received messages by sender.  For each
-     * sender k, nReceived[k] is the number received (a.k.a. "locally stable").
-     */
-    SSTFieldVector<int32_t> num_received;
     /** Set after calling rdmc::wedged(), reports that this member is wedged.
-     * Must be after num_received!*/
+     * Must be after receive_counters!*/
     SSTField<bool> wedged;
     /** Array of how many messages to accept from each sender in the current view change */
     SSTFieldVector<int> global_min;
     /** Array indicating whether each shard leader (indexed by subgroup number)
      * has published a global_min for the current view change*/
     SSTFieldVector<bool> global_min_ready;
-    /** for SST multicast */
-    SSTFieldVector<sst::Message> slots;
-    SSTFieldVector<int32_t> num_received_sst;
-
     /** to check for failures - used by the thread running check_failures_loop in derecho_group **/
     SSTFieldVector<uint64_t> local_stability_frontier;
+    /** For SST multicast. Written by the NICs of remote senders, so it is kept
+     * off the cache lines of the counters above. */
+    SSTFieldVector<sst::Message> slots;
     /**
      * Constructs an SST, and initializes the GMS fields to "safe" initial values
      * (0, false, etc.). Initializing the MulticastGroup fields is left to MulticastGroup.
@@ -105,24 +127,29 @@ public:
      */
     DerechoSST(const sst::SSTParams& parameters, const uint32_t num_subgroups, const uint32_t num_received_size, uint32_t window_size)
             : sst::SST<DerechoSST>(this, parameters),
-              seq_num(num_subgroups),
+              receive_counters(num_received_size),
               stable_num(num_subgroups),
               delivered_num(num_subgroups),
               persisted_num(num_subgroups),
+              delivered_index(num_received_size),
               suspected(parameters.members.size()),
               changes(100 + parameters.members.size()),
               joiner_ips(100 + parameters.members.size()),
-              num_received(num_received_size),
               global_min(num_received_size),
               global_min_ready(num_subgroups),
-              slots(window_size * num_subgroups),
-              num_received_sst(num_received_size),
-              local_stability_frontier(num_subgroups) {
-        SSTInit(seq_num, stable_num, delivered_num,
-                persisted_num, vid, suspected, changes, joiner_ips,
+              local_stability_frontier(num_subgroups),
+              slots(window_size * num_subgroups) {
+        receive_counters.set_placement(sst::Placement::CACHE_LINE_ALIGNED);
+        vid.set_placement(sst::Placement::CACHE_LINE_ALIGNED);
+        slots.set_placement(sst::Placement::CACHE_LINE_ISOLATED);
+        // The membership fields are only ever put to every member, so they can be relayed
+        set_relay_fields(vid, wedged);
+        SSTInit(receive_counters,
+                stable_num, delivered_num, persisted_num, delivered_index,
+                vid, suspected, changes, joiner_ips,
                 num_changes, num_committed, num_acked, num_installed,
-                num_received, wedged, global_min, global_min_ready,
-                slots, num_received_sst, local_stability_frontier);
+                wedged, global_min, global_min_ready,
+                local_stability_frontier, slots);
         //Once superclass constructor has finished, table entries can be initialized
         for(unsigned int row = 0; row < get_num_rows(); ++row) {
             vid[row] = 0;
@@ -145,9 +172,7 @@ public:
             num_acked[row] = 0;
             wedged[row] = false;
             // start off local_stability_frontier with the current time
-            struct timespec start_time;
-            clock_gettime(CLOCK_REALTIME, &start_time);
-            auto current_time = start_time.tv_sec * 1e9 + start_time.tv_nsec;
+            const uint64_t current_time = get_walltime();
             for(size_t i = 0; i < local_stability_frontier.size(); ++i) {
                 local_stability_frontier[row][i] = current_time;
             }
@@ -174,6 +199,12 @@ public:
      */
     void init_local_change_proposals(const int other_row);
 
+    /** The SST multicast receive counter of a sender, as sst::multicast_group
+     * reads and writes it. */
+    volatile int32_t& num_received_sst_at(const int row, const uint32_t index) const {
+        return receive_counters[row][index].num_received_sst;
+    }
+
     /**
      * Creates a string representation of the local row (not the whole table).
      * This should be converted to an ostream operator<< to follow standards.
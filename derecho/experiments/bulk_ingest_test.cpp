@@ -0,0 +1,139 @@
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "block_size.h"
+#include "bytes_object.h"
+#include "derecho/derecho.h"
+#include "initialize.h"
+#include "log_results.h"
+#include <mutils-serialization/SerializationSupport.hpp>
+#include <persistent/Persistent.hpp>
+
+using std::cout;
+using std::endl;
+using namespace persistent;
+
+// Loads count records of record_size bytes into a persistent subgroup from
+// one sender, first with one ordered_send per record, each of which is
+// versioned and persisted, then with a bulk-ingest session that packs the
+// records into messages of up to max_msg_size bytes and versions them once.
+// Each load is timed until its last record is persisted at every member.
+
+class RecordStore : public mutils::ByteRepresentable {
+public:
+    Persistent<Bytes> last_record;
+
+    void put(const Bytes& record) {
+        *last_record = record;
+    }
+
+    enum Functions { PUT };
+
+    static auto register_functions() {
+        return std::make_tuple(derecho::rpc::tag<PUT>(&RecordStore::put));
+    }
+
+    DEFAULT_SERIALIZATION_SUPPORT(RecordStore, last_record);
+
+    RecordStore(Persistent<Bytes>& _last_record) : last_record(std::move(_last_record)) {}
+    RecordStore(PersistentRegistry* pr) : last_record(nullptr, pr) {}
+};
+
+struct exp_result {
+    uint32_t num_nodes;
+    int record_size;
+    int count;
+    long long unsigned int max_msg_size;
+    double ordered_send_ms;
+    double bulk_ingest_ms;
+
+    void print(std::ofstream& fout) {
+        fout << num_nodes << " " << record_size << " " << count << " " << max_msg_size << " "
+             << ordered_send_ms << " " << bulk_ingest_ms << endl;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    if(argc < 5) {
+        cout << "usage:" << argv[0] << " <num_of_nodes> <record_size> <count> <max_msg_size>" << endl;
+        return -1;
+    }
+    const uint32_t num_of_nodes = atoi(argv[1]);
+    const int record_size = atoi(argv[2]);
+    const int count = atoi(argv[3]);
+    const long long unsigned int max_msg_size = atoll(argv[4]);
+
+    derecho::node_id_t node_id;
+    derecho::ip_addr my_ip;
+    derecho::ip_addr leader_ip;
+    query_node_info(node_id, my_ip, leader_ip);
+    derecho::DerechoParams derecho_params{max_msg_size, get_block_size(max_msg_size)};
+
+    derecho::SubgroupInfo subgroup_info{
+            {{std::type_index(typeid(RecordStore)), [num_of_nodes](const derecho::View& curr_view, int& next_unassigned_rank, bool previous_was_successful) {
+                  if(curr_view.num_members < (int)num_of_nodes) {
+                      throw derecho::subgroup_provisioning_exception();
+                  }
+                  derecho::subgroup_shard_layout_t subgroup_vector(1);
+                  std::vector<uint32_t> members(num_of_nodes);
+                  //Only the last member sends
+                  std::vector<int> senders(num_of_nodes, 0);
+                  for(uint32_t i = 0; i < num_of_nodes; i++) {
+                      members[i] = i;
+                  }
+                  senders[num_of_nodes - 1] = 1;
+                  subgroup_vector[0].emplace_back(curr_view.make_subview(members, derecho::Mode::ORDERED, senders));
+                  next_unassigned_rank = std::max(next_unassigned_rank, (int)num_of_nodes);
+                  return subgroup_vector;
+              }}},
+            {std::type_index(typeid(RecordStore))}};
+
+    auto store_factory = [](PersistentRegistry* pr) { return std::make_unique<RecordStore>(pr); };
+
+    std::unique_ptr<derecho::Group<RecordStore>> group;
+    if(my_ip == leader_ip) {
+        group = std::make_unique<derecho::Group<RecordStore>>(
+                node_id, my_ip, derecho::CallbackSet{nullptr, nullptr}, subgroup_info, derecho_params,
+                std::vector<derecho::view_upcall_t>{}, derecho::derecho_gms_port,
+                store_factory);
+    } else {
+        group = std::make_unique<derecho::Group<RecordStore>>(
+                node_id, my_ip, leader_ip, derecho::CallbackSet{nullptr, nullptr}, subgroup_info,
+                std::vector<derecho::view_upcall_t>{}, derecho::derecho_gms_port,
+                store_factory);
+    }
+
+    auto members_order = group->get_members();
+    if(members_order[num_of_nodes - 1] == node_id) {
+        derecho::Replicated<RecordStore>& handle = group->get_subgroup<RecordStore>();
+        std::vector<char> record_buf(record_size, 0);
+        Bytes record(record_buf.data(), record_size);
+
+        auto start_time = std::chrono::steady_clock::now();
+        for(int i = 0; i < count - 1; i++) {
+            handle.ordered_send<RecordStore::PUT>(record);
+        }
+        handle.ordered_send_tracked<RecordStore::PUT>(derecho::MessageMilestone::PERSISTED, record)
+                .wait(derecho::MessageMilestone::PERSISTED);
+        double ordered_send_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+
+        start_time = std::chrono::steady_clock::now();
+        derecho::BulkIngestSession<RecordStore> session = handle.begin_bulk_ingest();
+        for(int i = 0; i < count; i++) {
+            session.add<RecordStore::PUT>(record);
+        }
+        session.end().wait(derecho::MessageMilestone::PERSISTED);
+        double bulk_ingest_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+
+        cout << "ordered_send: " << ordered_send_ms << " ms, bulk ingest: " << bulk_ingest_ms << " ms" << endl;
+        log_results(exp_result{num_of_nodes, record_size, count, max_msg_size, ordered_send_ms, bulk_ingest_ms},
+                    "data_bulk_ingest_test");
+    }
+
+    group->barrier_sync();
+    group->leave();
+}
@@ -27,13 +27,17 @@ struct exp_result {
     unsigned int window_size;
     int num_messages;
     int raw_mode;
+    long long int sst_threshold;
+    unsigned int ack_hold_us;
     double bw;
+    double acks_per_message;
 
     void print(std::ofstream &fout) {
         fout << num_nodes << " " << num_senders_selector << " "
              << max_msg_size << " " << window_size << " "
              << num_messages << " " << raw_mode << " "
-	     << bw << endl;
+             << sst_threshold << " " << ack_hold_us << " "
+             << bw << " " << acks_per_message << endl;
     }
 };
 
@@ -41,7 +45,9 @@ int main(int argc, char *argv[]) {
     try {
         if(argc < 6) {
             cout << "Insufficient number of command line arguments" << endl;
-            cout << "Enter max_msg_size, num_senders_selector, window_size, num_messages, raw_mode" << endl;
+            cout << "Enter max_msg_size, num_senders_selector, window_size, num_messages, raw_mode, [sst_threshold], [ack_hold_us], [ack_hold_messages]" << endl;
+            cout << "sst_threshold defaults to -1 (derived from the cost model); use 0 to force RDMC" << endl;
+            cout << "ack_hold_us defaults to 0 (acknowledge every receive pass)" << endl;
             cout << "Thank you" << endl;
             exit(1);
         }
@@ -68,6 +74,10 @@ int main(int argc, char *argv[]) {
         const unsigned int window_size = atoi(argv[3]);
         const int num_messages = atoi(argv[4]);
         const int raw_mode = atoi(argv[5]);
+        // Sweeping sst_threshold across max_msg_size finds the SST/RDMC crossover
+        const long long int sst_threshold = argc > 6 ? atoll(argv[6]) : -1;
+        const unsigned int ack_hold_us = argc > 7 ? atoi(argv[7]) : 0;
+        const unsigned int ack_hold_messages = argc > 8 ? atoi(argv[8]) : 0;
 
         volatile bool done = false;
         auto stability_callback = [
@@ -136,7 +146,9 @@ int main(int argc, char *argv[]) {
                     node_id, node_addresses[node_id],
                     derecho::CallbackSet{stability_callback, nullptr},
                     one_raw_group,
-                    derecho::DerechoParams{max_msg_size, block_size, window_size});
+                    derecho::DerechoParams{max_msg_size, block_size, window_size, 1,
+                                           rdmc::BINOMIAL_SEND, derecho::derecho_rpc_port,
+                                           sst_threshold, 0, ack_hold_us, ack_hold_messages});
         } else {
             managed_group = std::make_unique<derecho::Group<>>(
                     node_id, node_addresses[node_id],
@@ -202,10 +214,13 @@ int main(int argc, char *argv[]) {
             bw = (max_msg_size * num_messages + 0.0) / nanoseconds_elapsed;
         }
         double avg_bw = aggregate_bandwidth(members, node_id, bw);
+        // Fewer acknowledgement puts per message means fewer RDMA writes at large fan-in
+        double acks_per_message = managed_group->get_subgroup<RawObject>().get_acks_per_message();
         if(node_rank == 0) {
             log_results(exp_result{num_nodes, num_senders_selector, max_msg_size,
                                    window_size, num_messages,
-                                   raw_mode, avg_bw},
+                                   raw_mode, sst_threshold, ack_hold_us,
+                                   avg_bw, acks_per_message},
                         "data_derecho_bw");
         }
 
@@ -15,6 +15,7 @@ using namespace std;
 
 #include "block_size.h"
 #include "derecho/derecho.h"
+#include "derecho/placement.h"
 #include "log_results.h"
 
 unique_ptr<rdmc::barrier_group> universal_barrier_group;
@@ -174,6 +175,9 @@ int main(int argc, char *argv[]) {
         if(node_id == 0) {
 	  log_results(exp_result{num_nodes, max_msg_size, window_size, num_messages, send_medium, raw_mode, ((double)total_time) / (num_messages * 1000)}, "data_latency");
         }
+        // Set DERECHO_CORES_<ROLE>, DERECHO_NUMA_NODE and DERECHO_HUGE_PAGES
+        // to compare placements
+        cout << derecho::get_placement_report();
         // managed_group->barrier_sync();
         // flush_events();
         // for(int i = 100; i < num_messages - 100; i+= 5){
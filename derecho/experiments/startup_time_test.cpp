@@ -0,0 +1,87 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "derecho/derecho.h"
+#include "log_results.h"
+#include "rdmc/util.h"
+
+using std::vector;
+using std::map;
+using std::cout;
+using std::endl;
+
+using namespace derecho;
+
+// Measures how long it takes a group to start: from the moment each node
+// starts constructing its Group until the first view containing all
+// num_nodes members is installed, which includes setting up the TCP, RDMC
+// and SST connections to every other member. Run it for a range of group
+// sizes to see how startup time scales.
+
+struct exp_result {
+    uint32_t num_nodes;
+    uint32_t node_id;
+    double time_to_first_view_ms;
+
+    void print(std::ofstream &fout) {
+        fout << num_nodes << " " << node_id << " "
+             << time_to_first_view_ms << endl;
+    }
+};
+
+int main(int argc, char *argv[]) {
+    pthread_setname_np(pthread_self(), "startup_time");
+
+    uint32_t server_rank = 0;
+    uint32_t node_id;
+    uint32_t num_nodes;
+
+    map<uint32_t, std::string> node_addresses;
+
+    rdmc::query_addresses(node_addresses, node_id);
+    num_nodes = node_addresses.size();
+
+    const long long unsigned int max_msg_size = 1000;
+    const long long unsigned int block_size = 1000;
+
+    auto membership_function = [num_nodes](const View &curr_view, int &next_unassigned_rank, bool previous_was_successful) {
+        if(curr_view.members.size() < num_nodes) {
+            throw derecho::subgroup_provisioning_exception();
+        }
+        subgroup_shard_layout_t subgroup_vector(1);
+        subgroup_vector[0].emplace_back(curr_view.make_subview(curr_view.members));
+        next_unassigned_rank = curr_view.members.size();
+        return subgroup_vector;
+    };
+    derecho::SubgroupInfo one_raw_group({{std::type_index(typeid(RawObject)), membership_function}});
+
+    auto start_time = std::chrono::steady_clock::now();
+    std::unique_ptr<derecho::Group<>> managed_group;
+    if(node_id == server_rank) {
+        managed_group = std::make_unique<derecho::Group<>>(
+                node_id, node_addresses[node_id],
+                derecho::CallbackSet{nullptr, nullptr},
+                one_raw_group,
+                derecho::DerechoParams{max_msg_size, block_size});
+    } else {
+        managed_group = std::make_unique<derecho::Group<>>(
+                node_id, node_addresses[node_id],
+                node_addresses[server_rank],
+                derecho::CallbackSet{nullptr, nullptr},
+                one_raw_group);
+    }
+    while(managed_group->get_members().size() < num_nodes) {
+    }
+    auto end_time = std::chrono::steady_clock::now();
+    double time_to_first_view_ms = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+    cout << "Time to first view with " << num_nodes << " members: " << time_to_first_view_ms << " ms" << endl;
+
+    log_results(exp_result{num_nodes, node_id, time_to_first_view_ms}, "data_startup_time_test");
+
+    managed_group->barrier_sync();
+    managed_group->leave();
+}
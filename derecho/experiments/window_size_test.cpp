@@ -23,9 +23,10 @@ constexpr int MAX_GROUP_SIZE = 8;
 int main(int argc, char *argv[]) {
     srand(time(NULL));
 
-    if(argc < 2) {
-        cout << "Error: Expected number of nodes in experiment as the first argument."
-             << endl;
+    if(argc < 4) {
+        cout << "Error: Expected num_nodes, msg_size, window_size, [min_window_size]" << endl;
+        cout << "With min_window_size below window_size the window adapts between the two;" << endl;
+        cout << "otherwise it stays fixed at window_size" << endl;
         return -1;
     }
     uint32_t num_nodes = std::atoi(argv[1]);
@@ -36,8 +37,9 @@ int main(int argc, char *argv[]) {
 
     query_node_info(node_id, my_ip, leader_ip);
 
-    long long unsigned int msg_size = atoll(argv[1]);
-    unsigned int window_size = atoll(argv[2]);
+    long long unsigned int msg_size = atoll(argv[2]);
+    unsigned int window_size = atoll(argv[3]);
+    unsigned int min_window_size = argc > 4 ? atoll(argv[4]) : window_size;
     long long unsigned int block_size = get_block_size(msg_size);
     int num_messages = 1000;
 
@@ -57,7 +59,9 @@ int main(int argc, char *argv[]) {
         g = std::make_unique<derecho::Group<>>(
                 node_id, my_ip, derecho::CallbackSet{stability_callback, nullptr},
                 one_raw_group,
-                derecho::DerechoParams{msg_size, block_size, window_size});
+                derecho::DerechoParams{msg_size, block_size, window_size, 1,
+                                       rdmc::BINOMIAL_SEND, derecho::derecho_rpc_port,
+                                       -1, min_window_size});
     } else {
         g = std::make_unique<derecho::Group<>>(
                 node_id, my_ip, leader_ip,
@@ -87,12 +91,13 @@ int main(int argc, char *argv[]) {
     struct params {
         long long unsigned int msg_size;
         unsigned int window_size;
+        unsigned int min_window_size;
         double avg_bw;
 
         void print(std::ofstream &fout) {
-            fout << msg_size << " " << window_size << " " << avg_bw << endl;
+            fout << msg_size << " " << window_size << " " << min_window_size << " " << avg_bw << endl;
         }
-    } t{msg_size, window_size, avg_bw};
+    } t{msg_size, window_size, min_window_size, avg_bw};
     log_results(t, "data_window_size");
     return 0;
 }
@@ -292,6 +292,24 @@ public:
     template <typename SubgroupType>
     ShardIterator<SubgroupType> get_shard_iterator(uint32_t subgroup_index = 0);
 
+    /**
+     * Gets a ShardRouter that sends P2P messages about a key only to the shard
+     * of the subgroup responsible for it. Like get_nonmember_subgroup, this
+     * can only be used by a node that is not a member of the subgroup.
+     *
+     * @param key_hash The hash function that keys are mapped to shards by
+     * @param subgroup_index The index of the subgroup within the set of
+     * subgroups that replicate the same type of object.
+     * @tparam SubgroupType The object type identifying the subgroup
+     * @tparam Key The type of the keys used to route messages
+     * @throws invalid_subgroup_exception If this node is actually a member of
+     * the requested subgroup, or if no such subgroup exists
+     */
+    template <typename SubgroupType, typename Key>
+    ShardRouter<SubgroupType, Key> get_shard_router(
+            typename ShardRouter<SubgroupType, Key>::key_hash_t key_hash = std::hash<Key>(),
+            uint32_t subgroup_index = 0);
+
     /** Causes this node to cleanly leave the group by setting itself to "failed." */
     void leave();
     /** Creates and returns a vector listing the nodes that are currently members of the group. */
@@ -243,13 +243,16 @@ void Group<ReplicatedTypes...>::set_up_components() {
     });
     view_manager.register_send_object_upcall([this](subgroup_id_t subgroup_id, node_id_t new_node_id) {
         LockedReference<std::unique_lock<std::mutex>, tcp::socket> joiner_socket = rpc_manager.get_socket(new_node_id);
-        //First, read the log tail length sent by the joining node
+        //First, read the latest version the joining node has in its own logs.
+        //If it has one, only the log entries after it are sent, and the joiner
+        //rebuilds the object's Persistent fields from its log.
         int64_t persistent_log_length = 0;
         joiner_socket.get().read(persistent_log_length);
         PersistentRegistry::setEarliestVersionToSerialize(persistent_log_length);
         logger->debug("Got log tail length {}", persistent_log_length);
         logger->debug("Sending Replicated Object state for subgroup {} to node {}", subgroup_id, new_node_id);
         objects_by_subgroup_id.at(subgroup_id).get().send_object(joiner_socket.get());
+        PersistentRegistry::resetEarliestVersionToSerialize();
     });
     view_manager.register_initialize_objects_upcall([this](node_id_t my_id, const View& view,
                                                            const vector_int64_2d& old_shard_leaders) {
@@ -345,6 +348,20 @@ ShardIterator<SubgroupType> Group<ReplicatedTypes...>::get_shard_iterator(uint32
     }
 }
 
+template <typename... ReplicatedTypes>
+template <typename SubgroupType, typename Key>
+ShardRouter<SubgroupType, Key> Group<ReplicatedTypes...>::get_shard_router(
+        typename ShardRouter<SubgroupType, Key>::key_hash_t key_hash, uint32_t subgroup_index) {
+    try {
+        auto& EC = external_callers.template get<SubgroupType>().at(subgroup_index);
+        View& curr_view = view_manager.get_current_view().get();
+        auto subgroup_id = curr_view.subgroup_ids_by_type.at(typeid(SubgroupType)).at(subgroup_index);
+        return ShardRouter<SubgroupType, Key>(EC, view_manager, subgroup_id, std::move(key_hash));
+    } catch(std::out_of_range& ex) {
+        throw invalid_subgroup_exception("No ExternalCaller exists for the requested subgroup; this node may be a member of the subgroup");
+    }
+}
+
 template <typename... ReplicatedTypes>
 void Group<ReplicatedTypes...>::receive_objects(const std::set<std::pair<subgroup_id_t, node_id_t>>& subgroups_and_leaders) {
     //This will receive one object from each shard leader in ascending order of subgroup ID
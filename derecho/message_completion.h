@@ -0,0 +1,140 @@
+/**
+ * @file message_completion.h
+ *
+ * Handles that let the sender of an ordered multicast wait for that one
+ * message to be stable, delivered, or persisted, without correlating the
+ * subgroup-wide stability and persistence callbacks itself.
+ */
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include "derecho_exception.h"
+#include "persistent/Persistent.hpp"
+
+namespace derecho {
+
+/**
+ * The points an ordered-mode message passes, in the order it passes them:
+ * received by every shard member, delivered at the sender, and persisted by
+ * every shard member.
+ */
+enum class MessageMilestone {
+    STABLE = 0,
+    DELIVERED = 1,
+    PERSISTED = 2
+};
+
+constexpr int num_message_milestones = 3;
+
+/**
+ * State shared between a MessageCompletion and the MulticastGroup that
+ * advances it. The group holds it in a waiter queue until it reaches the
+ * milestone it was requested for, or until it is abandoned.
+ */
+struct CompletionState {
+    /** The last milestone the sender asked to be told about. */
+    const MessageMilestone until;
+    std::mutex mtx;
+    std::condition_variable cv;
+    /** The last milestone reached, as an int; -1 if none. */
+    int reached = -1;
+    /** True if the message can no longer reach a milestone it has not reached yet. */
+    bool abandoned = false;
+    /** The version the message was delivered as; -1 until it is delivered. */
+    persistent::version_t version = -1;
+
+    CompletionState(MessageMilestone until) : until(until) {}
+
+    void advance(MessageMilestone milestone, persistent::version_t delivered_version) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if(static_cast<int>(milestone) > reached) {
+            reached = static_cast<int>(milestone);
+        }
+        if(milestone >= MessageMilestone::DELIVERED) {
+            version = delivered_version;
+        }
+        cv.notify_all();
+    }
+
+    void abandon() {
+        std::lock_guard<std::mutex> lock(mtx);
+        abandoned = true;
+        cv.notify_all();
+    }
+};
+
+/**
+ * A handle to one ordered-mode message sent by this node, returned by
+ * Replicated<T>::ordered_send_tracked and RawSubgroup::send_tracked.
+ * Copies share the same state. A message can only be waited on up to the
+ * milestone requested when it was sent.
+ */
+class MessageCompletion {
+    std::shared_ptr<CompletionState> state;
+
+    void check_requested(MessageMilestone milestone) const {
+        if(!state) {
+            throw empty_reference_exception("Attempted to use an empty MessageCompletion");
+        }
+        if(milestone > state->until) {
+            throw derecho_exception("Waited for a milestone past the one requested when the message was sent");
+        }
+    }
+    bool is_settled(MessageMilestone milestone) const {
+        if(state->reached >= static_cast<int>(milestone)) {
+            return true;
+        }
+        if(state->abandoned) {
+            throw message_abandoned_exception("The message was dropped by a view change before it was "
+                                              + std::string(milestone == MessageMilestone::PERSISTED ? "persisted" : "delivered"));
+        }
+        return false;
+    }
+
+public:
+    MessageCompletion() = default;
+    MessageCompletion(std::shared_ptr<CompletionState> state) : state(std::move(state)) {}
+
+    /** @return true if this handle tracks a message. */
+    bool is_valid() const { return state != nullptr; }
+
+    /** @return true if the message has reached the milestone; never blocks. */
+    bool reached(MessageMilestone milestone) const {
+        check_requested(milestone);
+        std::lock_guard<std::mutex> lock(state->mtx);
+        return state->reached >= static_cast<int>(milestone);
+    }
+
+    /**
+     * Blocks until the message reaches the milestone.
+     * @throws message_abandoned_exception if it never will
+     */
+    void wait(MessageMilestone milestone) const {
+        check_requested(milestone);
+        std::unique_lock<std::mutex> lock(state->mtx);
+        state->cv.wait(lock, [&]() { return is_settled(milestone); });
+    }
+
+    /**
+     * Blocks until the message reaches the milestone or the timeout passes.
+     * @return true if the milestone was reached
+     * @throws message_abandoned_exception if it never will be
+     */
+    template <typename Rep, typename Period>
+    bool wait_for(MessageMilestone milestone, const std::chrono::duration<Rep, Period>& timeout) const {
+        check_requested(milestone);
+        std::unique_lock<std::mutex> lock(state->mtx);
+        return state->cv.wait_for(lock, timeout, [&]() { return is_settled(milestone); });
+    }
+
+    /** @return the version the message was delivered as, or -1 if it has not been delivered. */
+    persistent::version_t get_version() const {
+        std::lock_guard<std::mutex> lock(state->mtx);
+        return state->version;
+    }
+};
+}  // namespace derecho
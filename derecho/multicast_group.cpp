@@ -1,9 +1,11 @@
 #include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <cstring>
 #include <limits>
 #include <thread>
 
+#include "derecho_exception.h"
 #include "derecho_internal.h"
 #include "multicast_group.h"
 #include "rdmc/util.h"
@@ -23,6 +25,56 @@ size_t index_of(T container, U elem) {
     return container.size();
 }
 
+OwnedMessage::OwnedMessage(subgroup_id_t subgroup_num, MessageBuffer&& message_buffer,
+                           uint32_t header_size, long long int payload_size,
+                           std::weak_ptr<ReleasedBufferQueue> release_queue)
+        : subgroup_num(subgroup_num),
+          message_buffer(std::move(message_buffer)),
+          release_queue(release_queue),
+          payload(this->message_buffer.buffer.get() + header_size),
+          payload_size(payload_size) {}
+
+OwnedMessage::OwnedMessage(OwnedMessage&& other)
+        : subgroup_num(other.subgroup_num),
+          message_buffer(std::move(other.message_buffer)),
+          release_queue(std::move(other.release_queue)),
+          payload(other.payload),
+          payload_size(other.payload_size) {
+    other.payload = nullptr;
+    other.payload_size = 0;
+}
+
+OwnedMessage& OwnedMessage::operator=(OwnedMessage&& other) {
+    if(this != &other) {
+        release();
+        subgroup_num = other.subgroup_num;
+        message_buffer = std::move(other.message_buffer);
+        release_queue = std::move(other.release_queue);
+        payload = other.payload;
+        payload_size = other.payload_size;
+        other.payload = nullptr;
+        other.payload_size = 0;
+    }
+    return *this;
+}
+
+void OwnedMessage::release() {
+    if(!message_buffer.buffer) {
+        return;
+    }
+    payload = nullptr;
+    payload_size = 0;
+    auto queue = release_queue.lock();
+    // Buffers without a memory region were copied out of the SST and can't
+    // be used for RDMC receives, so they are simply freed
+    if(queue && message_buffer.mr) {
+        std::lock_guard<std::mutex> lock(queue->mtx);
+        queue->buffers[subgroup_num].push_back(std::move(message_buffer));
+    } else {
+        message_buffer = MessageBuffer();
+    }
+}
+
 /**
  *
  * @param _members A list of node IDs of members in this group
@@ -50,31 +102,44 @@ MulticastGroup::MulticastGroup(
           max_msg_size(compute_max_msg_size(derecho_params.max_payload_size, derecho_params.block_size)),
           type(derecho_params.type),
           window_size(derecho_params.window_size),
+          min_window_size(derecho_params.min_window_size ? derecho_params.min_window_size : window_size),
+          max_persistence_lag(derecho_params.max_persistence_lag),
+          ack_hold_us(derecho_params.ack_hold_us),
+          ack_hold_messages(derecho_params.ack_hold_messages),
+          configured_sst_threshold(derecho_params.sst_threshold),
           callbacks(callbacks),
           total_num_subgroups(total_num_subgroups),
           subgroup_settings(subgroup_settings_by_id),
-          received_intervals(sst->num_received.size(), {-1, -1}),
-          rdmc_group_num_offset(0),
+          received_intervals(sst->receive_counters.size(), {-1, -1}),
+          rdmc_context(rdma::transport_context::get(my_node_id)),
+          rdmc_port(derecho_params.rdmc_port),
           future_message_indices(total_num_subgroups, 0),
           next_sends(total_num_subgroups),
           pending_sends(total_num_subgroups),
           current_sends(total_num_subgroups),
           next_message_to_deliver(total_num_subgroups),
+          optimistic_seq_nums(total_num_subgroups, -1),
           sender_timeout(derecho_params.timeout_ms),
           sst(sst),
           sst_multicast_group_ptrs(total_num_subgroups),
           last_transfer_medium(total_num_subgroups),
-          persistence_manager_callbacks(_persistence_manager_callbacks) {
+          sst_thresholds(total_num_subgroups, sst::max_msg_size),
+          persistence_manager_callbacks(_persistence_manager_callbacks),
+          released_buffers(std::make_shared<ReleasedBufferQueue>()) {
     assert(window_size >= 1);
 
     for(uint i = 0; i < num_members; ++i) {
         node_id_to_sst_index[members[i]] = i;
     }
 
+    for(uint32_t subgroup_num = 0; subgroup_num < total_num_subgroups; ++subgroup_num) {
+        msg_state_locks.push_back(std::make_shared<SubgroupStateLock>());
+    }
     for(const auto p : subgroup_settings_by_id) {
+        create_message_state(p.first);
         auto num_shard_members = p.second.members.size();
         while(free_message_buffers[p.first].size() < window_size * num_shard_members) {
-            free_message_buffers[p.first].emplace_back(max_msg_size);
+            free_message_buffers[p.first].push_back(allocate_message_buffer(p.first));
         }
     }
 
@@ -89,9 +154,13 @@ MulticastGroup::MulticastGroup(
         }
     }
     if(!already_failed.size() || no_member_failed) {
+        // Calibrate only in the first view; later views inherit the model
+        calibrate_transfer_cost_model();
         // if groups are created successfully, rdmc_sst_groups_created will be set to true
         rdmc_sst_groups_created = create_rdmc_sst_groups();
     }
+    compute_sst_thresholds();
+    create_sender_windows();
     register_predicates();
     sender_thread = std::thread(&MulticastGroup::send_loop, this);
     timeout_thread = std::thread(&MulticastGroup::check_failures_loop, this);
@@ -113,25 +182,32 @@ MulticastGroup::MulticastGroup(
           max_msg_size(old_group.max_msg_size),
           type(old_group.type),
           window_size(old_group.window_size),
+          min_window_size(old_group.min_window_size),
+          max_persistence_lag(old_group.max_persistence_lag),
+          ack_hold_us(old_group.ack_hold_us),
+          ack_hold_messages(old_group.ack_hold_messages),
+          configured_sst_threshold(old_group.configured_sst_threshold),
           callbacks(old_group.callbacks),
           total_num_subgroups(total_num_subgroups),
           subgroup_settings(subgroup_settings_by_id),
-          received_intervals(sst->num_received.size(), {-1, -1}),
+          received_intervals(sst->receive_counters.size(), {-1, -1}),
           rpc_callback(old_group.rpc_callback),
-          rdmc_group_num_offset(old_group.rdmc_group_num_offset + old_group.num_members),
+          rdmc_context(old_group.rdmc_context),
+          rdmc_port(old_group.rdmc_port),
           future_message_indices(total_num_subgroups, 0),
           next_sends(total_num_subgroups),
           pending_sends(total_num_subgroups),
           current_sends(total_num_subgroups),
           next_message_to_deliver(total_num_subgroups),
+          optimistic_seq_nums(total_num_subgroups, -1),
           sender_timeout(old_group.sender_timeout),
           sst(sst),
           sst_multicast_group_ptrs(total_num_subgroups),
           last_transfer_medium(total_num_subgroups),
-          persistence_manager_callbacks(_persistence_manager_callbacks) {
-    // Make sure rdmc_group_num_offset didn't overflow.
-    assert(old_group.rdmc_group_num_offset <= std::numeric_limits<uint16_t>::max() - old_group.num_members - num_members);
-
+          transfer_cost_model(old_group.transfer_cost_model),
+          sst_thresholds(total_num_subgroups, sst::max_msg_size),
+          persistence_manager_callbacks(_persistence_manager_callbacks),
+          released_buffers(old_group.released_buffers) {
     // Just in case
     old_group.wedge();
 
@@ -139,10 +215,14 @@ MulticastGroup::MulticastGroup(
         node_id_to_sst_index[members[i]] = i;
     }
 
+    // The index each re-sent message of this node gets in this group, by its old index
+    std::map<std::pair<subgroup_id_t, message_id_t>, message_id_t> new_indices;
+
     // Convience function that takes a msg from the old group and
     // produces one suitable for this group.
-    auto convert_msg = [this](RDMCMessage& msg, subgroup_id_t subgroup_num) {
+    auto convert_msg = [this, &new_indices](RDMCMessage& msg, subgroup_id_t subgroup_num) {
         msg.sender_id = members[member_index];
+        new_indices[{subgroup_num, msg.index}] = future_message_indices[subgroup_num];
         msg.index = future_message_indices[subgroup_num]++;
 
         header* h = (header*)msg.message_buffer.buffer.get();
@@ -163,28 +243,37 @@ MulticastGroup::MulticastGroup(
         return std::move(msg);
     };
 
+    for(uint32_t subgroup_num = 0; subgroup_num < total_num_subgroups; ++subgroup_num) {
+        msg_state_locks.push_back(std::make_shared<SubgroupStateLock>());
+    }
     for(const auto p : subgroup_settings_by_id) {
+        create_message_state(p.first);
         auto num_shard_members = p.second.members.size();
         while(free_message_buffers[p.first].size() < window_size * num_shard_members) {
-            free_message_buffers[p.first].emplace_back(max_msg_size);
+            free_message_buffers[p.first].push_back(allocate_message_buffer(p.first));
         }
     }
 
     // Reclaim RDMCMessageBuffers from the old group, and supplement them with
     // additional if the group has grown.
-    std::lock_guard<std::mutex> lock(old_group.msg_state_mtx);
+    std::vector<std::unique_lock<std::mutex>> old_state_locks;
+    for(auto& state_lock : old_group.msg_state_locks) {
+        old_state_locks.emplace_back(state_lock->mtx);
+    }
     for(const auto p : subgroup_settings_by_id) {
         const auto subgroup_num = p.first;
         auto num_shard_members = p.second.members.size();
         // for later: don't move extra message buffers
         free_message_buffers[subgroup_num].swap(old_group.free_message_buffers[subgroup_num]);
         while(free_message_buffers[subgroup_num].size() < old_group.window_size * num_shard_members) {
-            free_message_buffers[subgroup_num].emplace_back(max_msg_size);
+            free_message_buffers[subgroup_num].push_back(allocate_message_buffer(subgroup_num));
         }
     }
 
-    for(auto& msg : old_group.current_receives) {
-        free_message_buffers[msg.first.first].push_back(std::move(msg.second.message_buffer));
+    for(auto& p : old_group.current_receives) {
+        for(auto& msg : p.second) {
+            free_message_buffers[p.first].push_back(std::move(msg.second.message_buffer));
+        }
     }
     old_group.current_receives.clear();
 
@@ -242,6 +331,7 @@ MulticastGroup::MulticastGroup(
         }
         old_group.non_persistent_sst_messages.clear();
     }
+    adopt_completions(old_group, new_indices);
 
     initialize_sst_row();
     bool no_member_failed = true;
@@ -257,11 +347,30 @@ MulticastGroup::MulticastGroup(
         // if groups are created successfully, rdmc_sst_groups_created will be set to true
         rdmc_sst_groups_created = create_rdmc_sst_groups();
     }
+    compute_sst_thresholds();
+    create_sender_windows();
     register_predicates();
     sender_thread = std::thread(&MulticastGroup::send_loop, this);
     timeout_thread = std::thread(&MulticastGroup::check_failures_loop, this);
 }
 
+void MulticastGroup::create_message_state(subgroup_id_t subgroup_num) {
+    free_message_buffers[subgroup_num];
+    current_receives[subgroup_num];
+    locally_stable_rdmc_messages[subgroup_num];
+    locally_stable_sst_messages[subgroup_num];
+    pending_message_timestamps[subgroup_num];
+    pending_persistence[subgroup_num];
+    non_persistent_messages[subgroup_num];
+    non_persistent_sst_messages[subgroup_num];
+    unstable_completions[subgroup_num];
+    undelivered_completions[subgroup_num];
+    unpersisted_completions[subgroup_num];
+    ack_states[subgroup_num];
+    pending_sst_sends[subgroup_num] = false;
+    next_sst_send_indices[subgroup_num] = 0;
+}
+
 bool MulticastGroup::create_rdmc_sst_groups() {
     for(const auto& p : subgroup_settings) {
         uint32_t subgroup_num = p.first;
@@ -289,7 +398,7 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                                     num_shard_members, num_shard_senders,
                                     shard_sst_indices](char* data, size_t size) {
                 assert(this->sst);
-                std::lock_guard<std::mutex> lock(msg_state_mtx);
+                std::lock_guard<std::mutex> lock(msg_state_locks[subgroup_num]->mtx);
                 header* h = (header*)data;
                 auto index = h->index;
                 auto beg_index = index;
@@ -303,11 +412,11 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                     locally_stable_rdmc_messages[subgroup_num][sequence_number] = std::move(*current_sends[subgroup_num]);
                     current_sends[subgroup_num] = std::experimental::nullopt;
                 } else {
-                    auto it = current_receives.find({subgroup_num, sequence_number});
-                    assert(it != current_receives.end());
+                    auto it = current_receives[subgroup_num].find(sequence_number);
+                    assert(it != current_receives[subgroup_num].end());
                     auto& message = it->second;
                     locally_stable_rdmc_messages[subgroup_num].emplace(sequence_number, std::move(message));
-                    current_receives.erase(it);
+                    current_receives[subgroup_num].erase(it);
                 }
                 // Add empty messages to locally_stable_rdmc_messages for each turn that the sender is skipping.
                 for(unsigned int j = 0; j < h->pause_sending_turns; ++j) {
@@ -321,23 +430,18 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                 // deliver immediately if in raw mode
                 if(curr_subgroup_settings.mode == Mode::UNORDERED) {
                     // issue stability upcalls for the recently sequenced messages
-                    for(int i = sst->num_received[member_index][curr_subgroup_settings.num_received_offset + sender_rank] + 1;
+                    for(int i = sst->receive_counters[member_index][curr_subgroup_settings.num_received_offset + sender_rank].num_received + 1;
                         i <= new_num_received; ++i) {
                         message_id_t seq_num = i * num_shard_senders + sender_rank;
                         if(!locally_stable_sst_messages[subgroup_num].empty()
                            && locally_stable_sst_messages[subgroup_num].begin()->first == seq_num) {
                             auto& msg = locally_stable_sst_messages[subgroup_num].begin()->second;
                             if(msg.size > 0) {
-                                char* buf = const_cast<char*>(msg.buf);
-                                header* h = (header*)(buf);
-                                if(callbacks.global_stability_callback) {
-                                    callbacks.global_stability_callback(subgroup_num, msg.sender_id,
-                                                                        msg.index, buf + h->header_size,
-                                                                        msg.size - h->header_size);
-                                }
+                                header* h = (header*)(const_cast<char*>(msg.buf));
                                 if(node_id == members[member_index]) {
                                     pending_message_timestamps[subgroup_num].erase(h->timestamp);
                                 }
+                                deliver_raw_message(msg, subgroup_num);
                             }
                             locally_stable_sst_messages[subgroup_num].erase(locally_stable_sst_messages[subgroup_num].begin());
                         } else {
@@ -346,46 +450,41 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                             assert(it2->first == seq_num);
                             auto& msg = it2->second;
                             if(msg.size > 0) {
-                                char* buf = msg.message_buffer.buffer.get();
-                                header* h = (header*)(buf);
-                                if(callbacks.global_stability_callback) {
-                                    callbacks.global_stability_callback(subgroup_num, msg.sender_id,
-                                                                        msg.index, buf + h->header_size,
-                                                                        msg.size - h->header_size);
-                                }
-                                free_message_buffers[subgroup_num].push_back(std::move(msg.message_buffer));
+                                header* h = (header*)(msg.message_buffer.buffer.get());
                                 if(node_id == members[member_index]) {
                                     pending_message_timestamps[subgroup_num].erase(h->timestamp);
                                 }
+                                deliver_raw_message(msg, subgroup_num);
                             }
                             locally_stable_rdmc_messages[subgroup_num].erase(it2);
                         }
                     }
                 }
-                if(new_num_received > sst->num_received[member_index][curr_subgroup_settings.num_received_offset + sender_rank]) {
-                    sst->num_received[member_index][curr_subgroup_settings.num_received_offset + sender_rank] = new_num_received;
+                volatile ReceiveCounters* counters = sst->receive_counters[member_index] + curr_subgroup_settings.num_received_offset;
+                if(new_num_received > counters[sender_rank].num_received) {
+                    counters[sender_rank].num_received = new_num_received;
                     // std::atomic_signal_fence(std::memory_order_acq_rel);
-                    auto* min_ptr = std::min_element(&sst->num_received[member_index][curr_subgroup_settings.num_received_offset],
-                                                     &sst->num_received[member_index][curr_subgroup_settings.num_received_offset + num_shard_senders]);
-                    uint min_index = std::distance(&sst->num_received[member_index][curr_subgroup_settings.num_received_offset], min_ptr);
-                    auto new_seq_num = (*min_ptr + 1) * num_shard_senders + min_index - 1;
-                    if(static_cast<message_id_t>(new_seq_num) > sst->seq_num[member_index][subgroup_num]) {
+                    uint min_index = 0;
+                    for(uint i = 1; i < num_shard_senders; ++i) {
+                        if(counters[i].num_received < counters[min_index].num_received) {
+                            min_index = i;
+                        }
+                    }
+                    auto new_seq_num = (counters[min_index].num_received + 1) * num_shard_senders + min_index - 1;
+                    if(static_cast<message_id_t>(new_seq_num) > counters[0].seq_num) {
                         logger->trace("Updating seq_num for subgroup {} to {}", subgroup_num, new_seq_num);
-                        sst->seq_num[member_index][subgroup_num] = new_seq_num;
+                        counters[0].seq_num = new_seq_num;
+                        if(curr_subgroup_settings.mode == Mode::ORDERED) {
+                            deliver_optimistically(subgroup_num, new_seq_num);
+                        }
                         // std::atomic_signal_fence(std::memory_order_acq_rel);
                         // DERECHO_LOG(node_id, index, "received_message");
-                        // DERECHO_LOG(-1, -1, "stable_num_put_start");
-                        sst->put(shard_sst_indices,
-                                 (char*)std::addressof(sst->seq_num[0][subgroup_num]) - sst->getBaseAddress(),
-                                 sizeof(decltype(sst->seq_num)::value_type));
-                        // DERECHO_LOG(node_id, new_seq_num, "updated_seq_num");
-                        // DERECHO_LOG(-1, -1, "stable_num_put_end");
                     }
+                    // One put carries seq_num, in the subgroup's first entry, and this sender's num_received
                     // DERECHO_LOG(-1, -1, "num_received_put_start");
                     sst->put(shard_sst_indices,
-                             (char*)std::addressof(sst->num_received[0][curr_subgroup_settings.num_received_offset + sender_rank])
-                                     - sst->getBaseAddress(),
-                             sizeof(decltype(sst->num_received)::value_type));
+                             (char*)std::addressof(sst->receive_counters[0][curr_subgroup_settings.num_received_offset]) - sst->getBaseAddress(),
+                             sizeof(ReceiveCounters) * (sender_rank + 1));
                     // DERECHO_LOG(-1, -1, "num_received_put_end");
                 }
             };
@@ -394,7 +493,7 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                     [this, rdmc_receive_handler](char* data, size_t size) {
                         rdmc_receive_handler(data, size);
                         // signal background writer thread
-                        sender_cv.notify_all();
+                        wake_sender();
                     };
 
             // Create a "rotated" vector of members in which the currently selected shard member (shard_rank) is first
@@ -408,45 +507,50 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                 continue;
             }
 
+            const uint16_t rdmc_group_number = rdmc::new_group_number(*rdmc_context);
             if(node_id == members[member_index]) {
                 //Create a group in which this node is the sender, and only self-receives happen
                 if(!rdmc::create_group(
-                           rdmc_group_num_offset, rotated_shard_members, block_size, type,
+                           rdmc_context, rdmc_group_number, rotated_shard_members, block_size, type,
                            [this](size_t length) -> rdmc::receive_destination {
                                assert(false);
                                return {nullptr, 0};
                            },
                            receive_handler_plus_notify,
-                           [](std::experimental::optional<uint32_t>) {})) {
+                           [](std::experimental::optional<uint32_t>) {}, rdmc_port)) {
                     return false;
                 }
-                subgroup_to_rdmc_group[subgroup_num] = rdmc_group_num_offset;
-                rdmc_group_num_offset++;
+                rdmc_group_numbers.push_back(rdmc_group_number);
+                subgroup_to_rdmc_group[subgroup_num] = rdmc_group_number;
             } else {
                 if(!rdmc::create_group(
-                           rdmc_group_num_offset, rotated_shard_members, block_size, type,
+                           rdmc_context, rdmc_group_number, rotated_shard_members, block_size, type,
                            [this, subgroup_num, node_id, sender_rank, num_shard_senders](size_t length) {
-                               std::lock_guard<std::mutex> lock(msg_state_mtx);
-                               assert(!free_message_buffers[subgroup_num].empty());
+                               std::lock_guard<std::mutex> lock(msg_state_locks[subgroup_num]->mtx);
+                               reclaim_released_buffers(subgroup_num);
+                               if(free_message_buffers[subgroup_num].empty()) {
+                                   // The client is still holding buffers from owned deliveries
+                                   free_message_buffers[subgroup_num].push_back(allocate_message_buffer(subgroup_num));
+                               }
                                //Create a Message struct to receive the data into.
                                RDMCMessage msg;
                                msg.sender_id = node_id;
-                               msg.index = sst->num_received[member_index][subgroup_settings.at(subgroup_num).num_received_offset + sender_rank] + 1;
+                               msg.index = sst->receive_counters[member_index][subgroup_settings.at(subgroup_num).num_received_offset + sender_rank].num_received + 1;
                                msg.size = length;
                                msg.message_buffer = std::move(free_message_buffers[subgroup_num].back());
                                free_message_buffers[subgroup_num].pop_back();
 
                                rdmc::receive_destination ret{msg.message_buffer.mr, 0};
                                auto sequence_number = msg.index * num_shard_senders + sender_rank;
-                               current_receives[{subgroup_num, sequence_number}] = std::move(msg);
+                               current_receives[subgroup_num][sequence_number] = std::move(msg);
 
                                assert(ret.mr->buffer != nullptr);
                                return ret;
                            },
-                           rdmc_receive_handler, [](std::experimental::optional<uint32_t>) {})) {
+                           rdmc_receive_handler, [](std::experimental::optional<uint32_t>) {}, rdmc_port)) {
                     return false;
                 }
-                rdmc_group_num_offset++;
+                rdmc_group_numbers.push_back(rdmc_group_number);
             }
         }
     }
@@ -458,19 +562,69 @@ bool MulticastGroup::create_rdmc_sst_groups() {
     return true;
 }
 
+void MulticastGroup::calibrate_transfer_cost_model() {
+    if(num_members <= 1 || sst->slots.size() == 0) {
+        return;
+    }
+    // Putting this node's own slots is harmless: a put only copies the current
+    // contents of the local row, and no message has been sent yet
+    const long long int slots_offset = (char*)std::addressof(sst->slots[0][0]) - sst->getBaseAddress();
+    const int num_trials = 5;
+    uint64_t min_small_put_ns = std::numeric_limits<uint64_t>::max();
+    uint64_t min_large_put_ns = std::numeric_limits<uint64_t>::max();
+    for(int trial = 0; trial < num_trials; ++trial) {
+        uint64_t start_time = get_time();
+        sst->put_with_completion(slots_offset, sizeof(uint64_t));
+        uint64_t mid_time = get_time();
+        sst->put_with_completion(slots_offset, sizeof(sst::Message));
+        uint64_t end_time = get_time();
+        min_small_put_ns = std::min(min_small_put_ns, mid_time - start_time);
+        min_large_put_ns = std::min(min_large_put_ns, end_time - mid_time);
+    }
+    transfer_cost_model.write_latency_ns = min_small_put_ns;
+    if(min_large_put_ns > min_small_put_ns) {
+        transfer_cost_model.bytes_per_ns = (double)(num_members - 1) * (sizeof(sst::Message) - sizeof(uint64_t))
+                                           / (min_large_put_ns - min_small_put_ns);
+    }
+    logger->debug("Calibrated transfer costs: write latency {} ns, {} bytes/ns",
+                  transfer_cost_model.write_latency_ns, transfer_cost_model.bytes_per_ns);
+}
+
+void MulticastGroup::compute_sst_thresholds() {
+    for(const auto& p : subgroup_settings) {
+        const uint32_t num_shard_members = p.second.members.size();
+        long long unsigned int threshold;
+        if(num_shard_members <= 1) {
+            // There is no RDMC group for a single-member shard
+            threshold = sst::max_msg_size;
+        } else if(configured_sst_threshold >= 0) {
+            threshold = std::min<long long unsigned int>(configured_sst_threshold, sst::max_msg_size);
+        } else {
+            // sst::multicast_group puts its slots to every row of the SST
+            threshold = transfer_cost_model.sst_threshold(num_members - 1, num_shard_members,
+                                                          block_size, type, sst::max_msg_size);
+        }
+        sst_thresholds[p.first] = threshold;
+        logger->debug("Subgroup {} sends messages of up to {} bytes through SST", p.first, threshold);
+    }
+}
+
 void MulticastGroup::initialize_sst_row() {
-    auto num_received_size = sst->num_received.size();
-    auto seq_num_size = sst->seq_num.size();
+    auto num_received_size = sst->receive_counters.size();
+    auto seq_num_size = sst->stable_num.size();
     for(uint i = 0; i < num_members; ++i) {
         for(uint j = 0; j < num_received_size; ++j) {
-            sst->num_received[i][j] = -1;
+            sst->receive_counters[i][j].num_received = -1;
+            sst->receive_counters[i][j].seq_num = -1;
         }
         for(uint j = 0; j < seq_num_size; ++j) {
-            sst->seq_num[i][j] = -1;
             sst->stable_num[i][j] = -1;
             sst->delivered_num[i][j] = -1;
             sst->persisted_num[i][j] = -1;
         }
+        for(uint j = 0; j < num_received_size; ++j) {
+            sst->delivered_index[i][j] = -1;
+        }
     }
     sst->put();
     sst->sync_with_members();
@@ -488,10 +642,8 @@ void MulticastGroup::deliver_message(RDMCMessage& msg, subgroup_id_t subgroup_nu
         }
         // raw send
         else {
-            if(callbacks.global_stability_callback) {
-                callbacks.global_stability_callback(subgroup_num, msg.sender_id, msg.index,
-                                                    buf + h->header_size, msg.size - h->header_size);
-            }
+            deliver_raw_message(msg, subgroup_num);
+            return;
         }
         free_message_buffers[subgroup_num].push_back(std::move(msg.message_buffer));
     }
@@ -511,15 +663,80 @@ void MulticastGroup::deliver_message(SSTMessage& msg, subgroup_id_t subgroup_num
         // raw send
         else {
             // DERECHO_LOG(-1, -1, "start_stability_callback");
-            if(callbacks.global_stability_callback) {
-                callbacks.global_stability_callback(subgroup_num, msg.sender_id, msg.index,
-                                                    buf + h->header_size, msg.size - h->header_size);
-            }
+            deliver_raw_message(msg, subgroup_num);
             // DERECHO_LOG(-1, -1, "end_stability_callback");
         }
     }
 }
 
+void MulticastGroup::deliver_raw_message(RDMCMessage& msg, subgroup_id_t subgroup_num) {
+    char* buf = msg.message_buffer.buffer.get();
+    header* h = (header*)(buf);
+    if(callbacks.owned_stability_callback) {
+        const uint32_t header_size = h->header_size;
+        callbacks.owned_stability_callback(subgroup_num, msg.sender_id, msg.index,
+                                           OwnedMessage(subgroup_num, std::move(msg.message_buffer),
+                                                        header_size, msg.size - header_size,
+                                                        released_buffers));
+        return;
+    }
+    if(callbacks.global_stability_callback) {
+        callbacks.global_stability_callback(subgroup_num, msg.sender_id, msg.index,
+                                            buf + h->header_size, msg.size - h->header_size);
+    }
+    free_message_buffers[subgroup_num].push_back(std::move(msg.message_buffer));
+}
+
+void MulticastGroup::deliver_raw_message(SSTMessage& msg, subgroup_id_t subgroup_num) {
+    char* buf = const_cast<char*>(msg.buf);
+    header* h = (header*)(buf);
+    if(callbacks.owned_stability_callback) {
+        // The copy is not registered memory, so OwnedMessage::release frees it
+        // instead of returning it to the pool
+        MessageBuffer copy(msg.size);
+        memcpy(copy.buffer.get(), buf, msg.size);
+        callbacks.owned_stability_callback(subgroup_num, msg.sender_id, msg.index,
+                                           OwnedMessage(subgroup_num, std::move(copy),
+                                                        h->header_size, msg.size - h->header_size,
+                                                        released_buffers));
+        return;
+    }
+    if(callbacks.global_stability_callback) {
+        callbacks.global_stability_callback(subgroup_num, msg.sender_id, msg.index,
+                                            buf + h->header_size, msg.size - h->header_size);
+    }
+}
+
+MessageBuffer MulticastGroup::allocate_message_buffer(subgroup_id_t subgroup_num) {
+    if(!callbacks.receive_buffer_allocator) {
+        return MessageBuffer(*rdmc_context, max_msg_size);
+    }
+    char* buffer = callbacks.receive_buffer_allocator(subgroup_num, max_msg_size);
+    if(buffer == nullptr) {
+        throw derecho_exception("receive_buffer_allocator returned no memory for subgroup "
+                                + std::to_string(subgroup_num));
+    }
+    // Copy the deallocator, since the buffer may outlive this MulticastGroup
+    buffer_deallocator_t deallocator = callbacks.receive_buffer_deallocator;
+    return MessageBuffer(*rdmc_context, buffer, max_msg_size, [subgroup_num, deallocator](char* p) {
+        if(deallocator) {
+            deallocator(subgroup_num, p);
+        }
+    });
+}
+
+void MulticastGroup::reclaim_released_buffers(subgroup_id_t subgroup_num) {
+    std::lock_guard<std::mutex> lock(released_buffers->mtx);
+    auto released = released_buffers->buffers.find(subgroup_num);
+    if(released == released_buffers->buffers.end()) {
+        return;
+    }
+    for(auto& buffer : released->second) {
+        free_message_buffers[subgroup_num].push_back(std::move(buffer));
+    }
+    released_buffers->buffers.erase(released);
+}
+
 void MulticastGroup::version_message(RDMCMessage& msg, subgroup_id_t subgroup_num, message_id_t seq_num) {
     char* buf = msg.message_buffer.buffer.get();
     header* h = (header*)(buf);
@@ -528,11 +745,9 @@ void MulticastGroup::version_message(RDMCMessage& msg, subgroup_id_t subgroup_nu
         pending_persistence[subgroup_num][locally_stable_rdmc_messages[subgroup_num].begin()->first] = msg_ts;
     }
     // make a version for persistent<t>/volatile<t>
-    uint64_t msg_ts_us = msg_ts / 1e3;
+    uint64_t msg_ts_us = msg_ts / 1000;
     if(msg_ts_us == 0) {
-        struct timespec now;
-        clock_gettime(CLOCK_REALTIME, &now);
-        msg_ts_us = (uint64_t)now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+        msg_ts_us = get_walltime() / 1000;
     }
     std::get<0>(persistence_manager_callbacks)(subgroup_num,
                                                persistent::combine_int32s(sst->vid[member_index], seq_num), HLC{msg_ts_us, 0});
@@ -546,11 +761,9 @@ void MulticastGroup::version_message(SSTMessage& msg, subgroup_id_t subgroup_num
         pending_persistence[subgroup_num][locally_stable_sst_messages[subgroup_num].begin()->first] = msg_ts;
     }
     // make a version for persistent<t>/volatile<t>
-    uint64_t msg_ts_us = msg_ts / 1e3;
+    uint64_t msg_ts_us = msg_ts / 1000;
     if(msg_ts_us == 0) {
-        struct timespec now;
-        clock_gettime(CLOCK_REALTIME, &now);
-        msg_ts_us = (uint64_t)now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+        msg_ts_us = get_walltime() / 1000;
     }
     std::get<0>(persistence_manager_callbacks)(subgroup_num,
                                                persistent::combine_int32s(sst->vid[member_index], seq_num), HLC{msg_ts_us, 0});
@@ -561,7 +774,8 @@ void MulticastGroup::deliver_messages_upto(
         subgroup_id_t subgroup_num, uint32_t num_shard_senders) {
     // DERECHO_LOG(-1, -1, "deliver_messages_upto");
     assert(max_indices_for_senders.size() == (size_t)num_shard_senders);
-    std::lock_guard<std::mutex> lock(msg_state_mtx);
+    std::lock_guard<std::mutex> lock(msg_state_locks[subgroup_num]->mtx);
+    const SubgroupSettings& curr_subgroup_settings = subgroup_settings.at(subgroup_num);
     int32_t curr_seq_num = sst->delivered_num[member_index][subgroup_num];
     int32_t max_seq_num = curr_seq_num;
     for(uint sender = 0; sender < num_shard_senders; sender++) {
@@ -576,6 +790,15 @@ void MulticastGroup::deliver_messages_upto(
         if(index > max_indices_for_senders[sender_rank]) {
             continue;
         }
+        if(curr_subgroup_settings.mode == Mode::FIFO_STABLE) {
+            // Messages up to delivered_index were already delivered in FIFO order
+            auto& delivered_index = sst->delivered_index[member_index][curr_subgroup_settings.num_received_offset + sender_rank];
+            if(index > delivered_index) {
+                deliver_unversioned_message(subgroup_num, seq_num);
+                delivered_index = index;
+            }
+            continue;
+        }
         auto rdmc_msg_ptr = locally_stable_rdmc_messages[subgroup_num].find(seq_num);
         if(rdmc_msg_ptr != locally_stable_rdmc_messages[subgroup_num].end()) {
             deliver_message(rdmc_msg_ptr->second, subgroup_num);
@@ -589,11 +812,21 @@ void MulticastGroup::deliver_messages_upto(
             locally_stable_sst_messages[subgroup_num].erase(seq_num);
         }
     }
+    if(curr_subgroup_settings.mode == Mode::ORDERED) {
+        roll_back_optimistic_deliveries(subgroup_num);
+    }
     gmssst::set(sst->delivered_num[member_index][subgroup_num], max_seq_num);
+    complete_stable(subgroup_num, max_seq_num);
+    complete_delivered(subgroup_num, max_seq_num);
     sst->put(get_shard_sst_indices(subgroup_num),
              (char*)std::addressof(sst->delivered_num[0][subgroup_num]) - sst->getBaseAddress(),
              sizeof(decltype(sst->delivered_num)::value_type));
-    if(subgroup_settings.at(subgroup_num).mode != Mode::UNORDERED) {
+    if(curr_subgroup_settings.mode == Mode::FIFO_STABLE) {
+        sst->put(get_shard_sst_indices(subgroup_num),
+                 (char*)std::addressof(sst->delivered_index[0][curr_subgroup_settings.num_received_offset]) - sst->getBaseAddress(),
+                 sizeof(decltype(sst->delivered_index)::value_type) * num_shard_senders);
+    }
+    if(curr_subgroup_settings.mode == Mode::ORDERED) {
         //Call the persistence_manager_post_persist_func
         std::get<1>(persistence_manager_callbacks)(subgroup_num,
                                                    persistent::combine_int32s(sst->vid[member_index], sst->delivered_num[member_index][subgroup_num]));
@@ -643,7 +876,7 @@ bool MulticastGroup::receiver_predicate(subgroup_id_t subgroup_num, const Subgro
                                         const std::map<uint32_t, uint32_t>& shard_ranks_by_sender_rank,
                                         uint32_t num_shard_senders, const DerechoSST& sst) {
     for(uint sender_count = 0; sender_count < num_shard_senders; ++sender_count) {
-        int32_t num_received = sst.num_received_sst[member_index][curr_subgroup_settings.num_received_offset + sender_count] + 1;
+        int32_t num_received = sst.receive_counters[member_index][curr_subgroup_settings.num_received_offset + sender_count].num_received_sst + 1;
         uint32_t slot = num_received % window_size;
         if(static_cast<long long int>(sst.slots[node_id_to_sst_index.at(curr_subgroup_settings.members[shard_ranks_by_sender_rank.at(sender_count)])]
                                                [subgroup_num * window_size + slot]
@@ -681,22 +914,17 @@ void MulticastGroup::sst_receive_handler(subgroup_id_t subgroup_num, const Subgr
     auto new_num_received = resolve_num_received(beg_index, index, curr_subgroup_settings.num_received_offset + sender_rank);
     if(curr_subgroup_settings.mode == Mode::UNORDERED) {
         // issue stability upcalls for the recently sequenced messages
-        for(int i = sst->num_received[member_index][curr_subgroup_settings.num_received_offset + sender_rank] + 1; i <= new_num_received; ++i) {
+        for(int i = sst->receive_counters[member_index][curr_subgroup_settings.num_received_offset + sender_rank].num_received + 1; i <= new_num_received; ++i) {
             message_id_t seq_num = i * num_shard_senders + sender_rank;
             if(!locally_stable_sst_messages[subgroup_num].empty()
                && locally_stable_sst_messages[subgroup_num].begin()->first == seq_num) {
                 auto& msg = locally_stable_sst_messages[subgroup_num].begin()->second;
                 if(msg.size > 0) {
-                    char* buf = const_cast<char*>(msg.buf);
-                    header* h = (header*)(buf);
-                    if(callbacks.global_stability_callback) {
-                        callbacks.global_stability_callback(subgroup_num, msg.sender_id,
-                                                            msg.index, buf + h->header_size,
-                                                            msg.size - h->header_size);
-                    }
+                    header* h = (header*)(const_cast<char*>(msg.buf));
                     if(node_id == members[member_index]) {
                         pending_message_timestamps[subgroup_num].erase(h->timestamp);
                     }
+                    deliver_raw_message(msg, subgroup_num);
                 }
                 locally_stable_sst_messages[subgroup_num].erase(locally_stable_sst_messages[subgroup_num].begin());
             } else {
@@ -705,23 +933,17 @@ void MulticastGroup::sst_receive_handler(subgroup_id_t subgroup_num, const Subgr
                 assert(it2->first == seq_num);
                 auto& msg = it2->second;
                 if(msg.size > 0) {
-                    char* buf = msg.message_buffer.buffer.get();
-                    header* h = (header*)(buf);
-                    if(callbacks.global_stability_callback) {
-                        callbacks.global_stability_callback(subgroup_num, msg.sender_id,
-                                                            msg.index, buf + h->header_size,
-                                                            msg.size - h->header_size);
-                    }
-                    free_message_buffers[subgroup_num].push_back(std::move(msg.message_buffer));
+                    header* h = (header*)(msg.message_buffer.buffer.get());
                     if(node_id == members[member_index]) {
                         pending_message_timestamps[subgroup_num].erase(h->timestamp);
                     }
+                    deliver_raw_message(msg, subgroup_num);
                 }
                 locally_stable_rdmc_messages[subgroup_num].erase(it2);
             }
         }
     }
-    sst->num_received[member_index][curr_subgroup_settings.num_received_offset + sender_rank] = new_num_received;
+    sst->receive_counters[member_index][curr_subgroup_settings.num_received_offset + sender_rank].num_received = new_num_received;
 }
 
 void MulticastGroup::receiver_function(subgroup_id_t subgroup_num, const SubgroupSettings& curr_subgroup_settings,
@@ -729,10 +951,10 @@ void MulticastGroup::receiver_function(subgroup_id_t subgroup_num, const Subgrou
                                        uint32_t num_shard_senders, DerechoSST& sst, unsigned int batch_size,
                                        const std::function<void(uint32_t, volatile char*, uint32_t)>& sst_receive_handler_lambda) {
     // DERECHO_LOG(receiver_cnt, -1, "in receiver_trig");
-    std::lock_guard<std::mutex> lock(msg_state_mtx);
+    uint32_t num_newly_received = 0;
     for(uint i = 0; i < batch_size; ++i) {
         for(uint sender_count = 0; sender_count < num_shard_senders; ++sender_count) {
-            auto num_received = sst.num_received_sst[member_index][curr_subgroup_settings.num_received_offset + sender_count] + 1;
+            auto num_received = sst.receive_counters[member_index][curr_subgroup_settings.num_received_offset + sender_count].num_received_sst + 1;
             uint32_t slot = num_received % window_size;
             message_id_t next_seq = sst.slots[node_id_to_sst_index.at(curr_subgroup_settings.members[shard_ranks_by_sender_rank.at(sender_count)])][subgroup_num * window_size + slot].next_seq;
             if(next_seq == num_received / static_cast<int32_t>(window_size) + 1) {
@@ -741,31 +963,96 @@ void MulticastGroup::receiver_function(subgroup_id_t subgroup_num, const Subgrou
                 sst_receive_handler_lambda(sender_count,
                                            sst.slots[node_id_to_sst_index.at(curr_subgroup_settings.members[shard_ranks_by_sender_rank.at(sender_count)])][subgroup_num * window_size + slot].buf,
                                            sst.slots[node_id_to_sst_index.at(curr_subgroup_settings.members[shard_ranks_by_sender_rank.at(sender_count)])][subgroup_num * window_size + slot].size);
-                sst.num_received_sst[member_index][curr_subgroup_settings.num_received_offset + sender_count] = num_received;
+                sst.receive_counters[member_index][curr_subgroup_settings.num_received_offset + sender_count].num_received_sst = num_received;
+                num_newly_received++;
             }
         }
     }
-    sst.put((char*)std::addressof(sst.num_received_sst[0][curr_subgroup_settings.num_received_offset]) - sst.getBaseAddress(),
-            sizeof(decltype(sst.num_received_sst)::value_type) * num_shard_senders);
     // std::atomic_signal_fence(std::memory_order_acq_rel);
-    auto* min_ptr = std::min_element(&sst.num_received[member_index][curr_subgroup_settings.num_received_offset],
-                                     &sst.num_received[member_index][curr_subgroup_settings.num_received_offset + num_shard_senders]);
-    int min_index = std::distance(&sst.num_received[member_index][curr_subgroup_settings.num_received_offset], min_ptr);
-    message_id_t new_seq_num = (*min_ptr + 1) * num_shard_senders + min_index - 1;
-    if(new_seq_num > sst.seq_num[member_index][subgroup_num]) {
+    volatile ReceiveCounters* counters = sst.receive_counters[member_index] + curr_subgroup_settings.num_received_offset;
+    int min_index = 0;
+    for(uint sender_count = 1; sender_count < num_shard_senders; ++sender_count) {
+        if(counters[sender_count].num_received < counters[min_index].num_received) {
+            min_index = sender_count;
+        }
+    }
+    message_id_t new_seq_num = (counters[min_index].num_received + 1) * num_shard_senders + min_index - 1;
+    if(new_seq_num > counters[0].seq_num) {
         logger->trace("Updating seq_num for subgroup {} to {}", subgroup_num, new_seq_num);
-        sst.seq_num[member_index][subgroup_num] = new_seq_num;
-        sst.put((char*)std::addressof(sst.seq_num[0][subgroup_num]) - sst.getBaseAddress(),
-                sizeof(decltype(sst.seq_num)::value_type));
+        counters[0].seq_num = new_seq_num;
+        if(curr_subgroup_settings.mode == Mode::ORDERED) {
+            deliver_optimistically(subgroup_num, new_seq_num);
+        }
+    }
+
+    AckState& acks = ack_states[subgroup_num];
+    if(num_newly_received) {
+        acks.messages_received += num_newly_received;
+        if(!acks.unacked_messages) {
+            acks.oldest_unacked_time = get_time();
+        }
+        acks.unacked_messages += num_newly_received;
+    }
+    // Without holding, every pass acknowledges, whether or not it received anything
+    if(ack_hold_us) {
+        if(!acks.unacked_messages) {
+            return;
+        }
+        bool flush = ack_hold_messages && acks.unacked_messages >= ack_hold_messages;
+        flush = flush || get_time() - acks.oldest_unacked_time >= ack_hold_us * 1000ull;
+        // A sender whose window may fill up with messages we haven't acknowledged must not wait
+        const int32_t near_window_limit = std::max(1u, min_window_size / 2);
+        for(uint sender_count = 0; !flush && sender_count < num_shard_senders; ++sender_count) {
+            flush = sst.receive_counters[member_index][curr_subgroup_settings.num_received_offset + sender_count].num_received_sst
+                            - acks.last_acked_num_received[sender_count]
+                    >= near_window_limit;
+        }
+        if(!flush) {
+            return;
+        }
     }
-    sst.put((char*)std::addressof(sst.num_received[0][curr_subgroup_settings.num_received_offset]) - sst.getBaseAddress(),
-            sizeof(decltype(sst.num_received)::value_type) * num_shard_senders);
+
+    // The subgroup's counters are next to each other, so one put acknowledges
+    // them all without touching other subgroups' held acknowledgements
+    sst.put((char*)std::addressof(sst.receive_counters[0][curr_subgroup_settings.num_received_offset]) - sst.getBaseAddress(),
+            sizeof(ReceiveCounters) * num_shard_senders);
+    for(uint sender_count = 0; sender_count < num_shard_senders; ++sender_count) {
+        acks.last_acked_num_received[sender_count]
+                = sst.receive_counters[member_index][curr_subgroup_settings.num_received_offset + sender_count].num_received_sst;
+    }
+    acks.unacked_messages = 0;
+    acks.oldest_unacked_time = 0;
+    acks.ack_flushes++;
+}
+
+int32_t MulticastGroup::sender_progress(const DerechoSST& sst, Mode mode, uint32_t row, uint32_t num_received_entry) {
+    return mode == Mode::FIFO_STABLE ? sst.delivered_index[row][num_received_entry]
+                                     : sst.receive_counters[row][num_received_entry].num_received;
+}
+
+bool MulticastGroup::ack_flush_due(subgroup_id_t subgroup_num) {
+    if(!ack_hold_us) {
+        return false;
+    }
+    const AckState& acks = ack_states[subgroup_num];
+    return acks.unacked_messages && get_time() - acks.oldest_unacked_time >= ack_hold_us * 1000ull;
+}
+
+double MulticastGroup::get_acks_per_message(subgroup_id_t subgroup_num) {
+    if(subgroup_num >= msg_state_locks.size()) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(msg_state_locks[subgroup_num]->mtx);
+    auto acks = ack_states.find(subgroup_num);
+    if(acks == ack_states.end() || !acks->second.messages_received) {
+        return 0;
+    }
+    return static_cast<double>(acks->second.ack_flushes) / acks->second.messages_received;
 }
 
 void MulticastGroup::delivery_trigger(subgroup_id_t subgroup_num, const SubgroupSettings& curr_subgroup_settings,
                                       const uint32_t num_shard_members, DerechoSST& sst) {
     // DERECHO_LOG(delivery_cnt, -1, "in delivery_trig");
-    std::lock_guard<std::mutex> lock(msg_state_mtx);
     // compute the min of the stable_num
     message_id_t min_stable_num
             = sst.stable_num[node_id_to_sst_index.at(curr_subgroup_settings.members[0])][subgroup_num];
@@ -818,6 +1105,8 @@ void MulticastGroup::delivery_trigger(subgroup_id_t subgroup_num, const Subgroup
             break;
         }
     }
+    complete_stable(subgroup_num, min_stable_num);
+    complete_delivered(subgroup_num, sst.delivered_num[member_index][subgroup_num]);
     if(update_sst) {
         // DERECHO_LOG(-1, -1, "delivery_put_start");
         sst.put(get_shard_sst_indices(subgroup_num),
@@ -831,6 +1120,126 @@ void MulticastGroup::delivery_trigger(subgroup_id_t subgroup_num, const Subgroup
         }
     }
 }
+void MulticastGroup::fifo_delivery_trigger(subgroup_id_t subgroup_num, const SubgroupSettings& curr_subgroup_settings,
+                                           uint32_t num_shard_senders, DerechoSST& sst) {
+    bool update_sst = false;
+    for(uint32_t sender_rank = 0; sender_rank < num_shard_senders; ++sender_rank) {
+        const uint32_t num_received_entry = curr_subgroup_settings.num_received_offset + sender_rank;
+        // a sender's message is stable once every shard member has received it
+        int32_t min_num_received = std::numeric_limits<int32_t>::max();
+        for(auto member : curr_subgroup_settings.members) {
+            const int32_t num_received = sst.receive_counters[node_id_to_sst_index.at(member)][num_received_entry].num_received;
+            min_num_received = std::min(min_num_received, num_received);
+        }
+        for(int32_t index = sst.delivered_index[member_index][num_received_entry] + 1; index <= min_num_received; ++index) {
+            deliver_unversioned_message(subgroup_num, index * num_shard_senders + sender_rank);
+            sst.delivered_index[member_index][num_received_entry] = index;
+            update_sst = true;
+        }
+    }
+    if(!update_sst) {
+        return;
+    }
+    sst.put(get_shard_sst_indices(subgroup_num),
+            (char*)std::addressof(sst.delivered_index[0][curr_subgroup_settings.num_received_offset]) - sst.getBaseAddress(),
+            sizeof(decltype(sst.delivered_index)::value_type) * num_shard_senders);
+    // delivered_num is the prefix of the round-robin order delivered so far,
+    // which is where ragged edge cleanup resumes delivery
+    auto* min_ptr = std::min_element(&sst.delivered_index[member_index][curr_subgroup_settings.num_received_offset],
+                                     &sst.delivered_index[member_index][curr_subgroup_settings.num_received_offset + num_shard_senders]);
+    int min_index = std::distance(&sst.delivered_index[member_index][curr_subgroup_settings.num_received_offset], min_ptr);
+    message_id_t new_delivered_num = (*min_ptr + 1) * num_shard_senders + min_index - 1;
+    if(new_delivered_num > sst.delivered_num[member_index][subgroup_num]) {
+        sst.delivered_num[member_index][subgroup_num] = new_delivered_num;
+        sst.put(get_shard_sst_indices(subgroup_num),
+                (char*)std::addressof(sst.delivered_num[0][subgroup_num]) - sst.getBaseAddress(),
+                sizeof(decltype(sst.delivered_num)::value_type));
+    }
+}
+
+void MulticastGroup::deliver_optimistically(subgroup_id_t subgroup_num, message_id_t seq_num) {
+    if(!callbacks.local_receipt_callback) {
+        return;
+    }
+    for(message_id_t next = optimistic_seq_nums[subgroup_num] + 1; next <= seq_num; ++next) {
+        node_id_t sender_id;
+        message_id_t index;
+        char* buf;
+        long long int size;
+        auto rdmc_msg = locally_stable_rdmc_messages[subgroup_num].find(next);
+        if(rdmc_msg != locally_stable_rdmc_messages[subgroup_num].end()) {
+            const RDMCMessage& msg = rdmc_msg->second;
+            std::tie(sender_id, index, buf, size) = std::make_tuple(msg.sender_id, msg.index, msg.message_buffer.buffer.get(), msg.size);
+        } else {
+            auto sst_msg = locally_stable_sst_messages[subgroup_num].find(next);
+            if(sst_msg == locally_stable_sst_messages[subgroup_num].end()) {
+                continue;
+            }
+            const SSTMessage& msg = sst_msg->second;
+            std::tie(sender_id, index, buf, size) = std::make_tuple(msg.sender_id, msg.index, const_cast<char*>(msg.buf), msg.size);
+        }
+        if(size == 0) {
+            continue;
+        }
+        header* h = (header*)buf;
+        // RPC calls are not speculative; only raw messages can be withdrawn by the client
+        if(!h->cooked_send) {
+            callbacks.local_receipt_callback(subgroup_num, sender_id, index, buf + h->header_size, size - h->header_size);
+        }
+    }
+    optimistic_seq_nums[subgroup_num] = std::max(optimistic_seq_nums[subgroup_num], seq_num);
+}
+
+void MulticastGroup::roll_back_optimistic_deliveries(subgroup_id_t subgroup_num) {
+    const message_id_t optimistic_seq_num = optimistic_seq_nums[subgroup_num];
+    if(!callbacks.local_receipt_rollback_callback || optimistic_seq_num < 0) {
+        return;
+    }
+    // Whatever ragged edge cleanup delivered has been erased; the rest is trimmed
+    std::map<message_id_t, std::pair<node_id_t, message_id_t>, std::greater<message_id_t>> trimmed;
+    for(const auto& p : locally_stable_rdmc_messages[subgroup_num]) {
+        if(p.first <= optimistic_seq_num && p.second.size > 0
+           && !((header*)p.second.message_buffer.buffer.get())->cooked_send) {
+            trimmed[p.first] = {p.second.sender_id, p.second.index};
+        }
+    }
+    for(const auto& p : locally_stable_sst_messages[subgroup_num]) {
+        if(p.first <= optimistic_seq_num && p.second.size > 0
+           && !((header*)const_cast<char*>(p.second.buf))->cooked_send) {
+            trimmed[p.first] = {p.second.sender_id, p.second.index};
+        }
+    }
+    for(const auto& p : trimmed) {
+        logger->debug("Subgroup {}: rolling back message {} from {}, trimmed by the view change",
+                      subgroup_num, p.second.second, p.second.first);
+        callbacks.local_receipt_rollback_callback(subgroup_num, p.second.first, p.second.second);
+    }
+    optimistic_seq_nums[subgroup_num] = -1;
+}
+
+void MulticastGroup::deliver_unversioned_message(subgroup_id_t subgroup_num, message_id_t seq_num) {
+    auto rdmc_msg = locally_stable_rdmc_messages[subgroup_num].find(seq_num);
+    if(rdmc_msg != locally_stable_rdmc_messages[subgroup_num].end()) {
+        RDMCMessage& msg = rdmc_msg->second;
+        if(msg.size > 0 && msg.sender_id == members[member_index]) {
+            // nothing is persisted, so the message leaves the stability frontier once delivered
+            pending_message_timestamps[subgroup_num].erase(((header*)msg.message_buffer.buffer.get())->timestamp);
+        }
+        deliver_message(msg, subgroup_num);
+        locally_stable_rdmc_messages[subgroup_num].erase(rdmc_msg);
+        return;
+    }
+    auto sst_msg = locally_stable_sst_messages[subgroup_num].find(seq_num);
+    if(sst_msg != locally_stable_sst_messages[subgroup_num].end()) {
+        SSTMessage& msg = sst_msg->second;
+        if(msg.size > 0 && msg.sender_id == members[member_index]) {
+            pending_message_timestamps[subgroup_num].erase(((header*)const_cast<char*>(msg.buf))->timestamp);
+        }
+        deliver_message(msg, subgroup_num);
+        locally_stable_sst_messages[subgroup_num].erase(sst_msg);
+    }
+}
+
 void MulticastGroup::register_predicates() {
     for(const auto& p : subgroup_settings) {
         subgroup_id_t subgroup_num = p.first;
@@ -846,9 +1255,11 @@ void MulticastGroup::register_predicates() {
             }
         }
 
+        ack_states[subgroup_num].last_acked_num_received.assign(num_shard_senders, -1);
         auto receiver_pred = [=](const DerechoSST& sst) {
             return receiver_predicate(subgroup_num, curr_subgroup_settings,
-                                      shard_ranks_by_sender_rank, num_shard_senders, sst);
+                                      shard_ranks_by_sender_rank, num_shard_senders, sst)
+                   || ack_flush_due(subgroup_num);
         };
         auto batch_size = window_size / 2;
         if(!batch_size) {
@@ -864,20 +1275,21 @@ void MulticastGroup::register_predicates() {
                               shard_ranks_by_sender_rank, num_shard_senders, sst,
                               batch_size, sst_receive_handler_lambda);
         };
-        receiver_pred_handles.emplace_back(sst->predicates.insert(receiver_pred, receiver_trig,
-                                                                  sst::PredicateType::RECURRENT));
+        receiver_pred_handles.emplace_back(sst->predicates.insert(receiver_pred, locked_trigger(subgroup_num, receiver_trig),
+                                                                  sst::PredicateType::RECURRENT, subgroup_num));
 
-        if(curr_subgroup_settings.mode != Mode::UNORDERED) {
+        if(curr_subgroup_settings.mode == Mode::ORDERED) {
             auto stability_pred = [this](const DerechoSST& sst) { return true; };
             auto shard_sst_indices = get_shard_sst_indices(subgroup_num);
             auto stability_trig = [this, subgroup_num, curr_subgroup_settings,
                                    num_shard_members, shard_sst_indices](DerechoSST& sst) mutable {
                 // DERECHO_LOG(stability_cnt, -1, "in stability_trig");
                 // compute the min of the seq_num
-                message_id_t min_seq_num = sst.seq_num[node_id_to_sst_index.at(curr_subgroup_settings.members[0])][subgroup_num];
+                const uint32_t num_received_offset = curr_subgroup_settings.num_received_offset;
+                message_id_t min_seq_num = sst.receive_counters[node_id_to_sst_index.at(curr_subgroup_settings.members[0])][num_received_offset].seq_num;
                 for(uint i = 0; i < num_shard_members; ++i) {
-                    if(sst.seq_num[node_id_to_sst_index.at(curr_subgroup_settings.members[i])][subgroup_num] < min_seq_num) {
-                        min_seq_num = sst.seq_num[node_id_to_sst_index.at(curr_subgroup_settings.members[i])][subgroup_num];
+                    if(sst.receive_counters[node_id_to_sst_index.at(curr_subgroup_settings.members[i])][num_received_offset].seq_num < min_seq_num) {
+                        min_seq_num = sst.receive_counters[node_id_to_sst_index.at(curr_subgroup_settings.members[i])][num_received_offset].seq_num;
                     }
                 }
                 if(min_seq_num > sst.stable_num[member_index][subgroup_num]) {
@@ -893,19 +1305,19 @@ void MulticastGroup::register_predicates() {
                 }
             };
             stability_pred_handles.emplace_back(sst->predicates.insert(
-                    stability_pred, stability_trig, sst::PredicateType::RECURRENT));
+                    stability_pred, locked_trigger(subgroup_num, stability_trig), sst::PredicateType::RECURRENT, subgroup_num));
 
             auto delivery_pred = [this](const DerechoSST& sst) { return true; };
             auto delivery_trig = [=](DerechoSST& sst) mutable {
                 delivery_trigger(subgroup_num, curr_subgroup_settings, num_shard_members, sst);
             };
 
-            delivery_pred_handles.emplace_back(sst->predicates.insert(delivery_pred, delivery_trig,
-                                                                      sst::PredicateType::RECURRENT));
+            delivery_pred_handles.emplace_back(sst->predicates.insert(delivery_pred, locked_trigger(subgroup_num, delivery_trig),
+                                                                      sst::PredicateType::RECURRENT, subgroup_num));
 
             auto persistence_pred = [this](const DerechoSST& sst) { return true; };
-            auto persistence_trig = [this, subgroup_num, curr_subgroup_settings, num_shard_members](DerechoSST& sst) mutable {
-                std::lock_guard<std::mutex> lock(msg_state_mtx);
+            auto persistence_trig = [this, subgroup_num, curr_subgroup_settings, num_shard_members,
+                                     notified_persisted_num = persistent::version_t(-1)](DerechoSST& sst) mutable {
                 // compute the min of the persisted_num
                 persistent::version_t min_persisted_num
                         = sst.persisted_num[node_id_to_sst_index.at(curr_subgroup_settings.members[0])][subgroup_num];
@@ -918,49 +1330,145 @@ void MulticastGroup::register_predicates() {
                 if(callbacks.global_persistence_callback) {
                     callbacks.global_persistence_callback(subgroup_num, min_persisted_num);
                 }
+                complete_persisted(subgroup_num, min_persisted_num);
+                // with a max_persistence_lag, sender_pred no longer follows persistence,
+                // so a sender held back by the lag is woken here
+                if(max_persistence_lag && curr_subgroup_settings.sender_rank >= 0
+                   && min_persisted_num > notified_persisted_num) {
+                    notified_persisted_num = min_persisted_num;
+                    wake_sender();
+                }
             };
 
-            persistence_pred_handles.emplace_back(sst->predicates.insert(persistence_pred, persistence_trig, sst::PredicateType::RECURRENT));
+            persistence_pred_handles.emplace_back(sst->predicates.insert(persistence_pred, locked_trigger(subgroup_num, persistence_trig), sst::PredicateType::RECURRENT, subgroup_num));
 
             if(curr_subgroup_settings.sender_rank >= 0) {
                 auto sender_pred = [this, subgroup_num, curr_subgroup_settings, num_shard_members, num_shard_senders](const DerechoSST& sst) {
                     message_id_t seq_num = next_message_to_deliver[subgroup_num] * num_shard_senders + curr_subgroup_settings.sender_rank;
                     for(uint i = 0; i < num_shard_members; ++i) {
-                        if(sst.delivered_num[node_id_to_sst_index.at(curr_subgroup_settings.members[i])][subgroup_num] < seq_num
-                           || (sst.persisted_num[node_id_to_sst_index.at(curr_subgroup_settings.members[i])][subgroup_num] < seq_num)) {
+                        if(sst.delivered_num[node_id_to_sst_index.at(curr_subgroup_settings.members[i])][subgroup_num] < seq_num) {
                             return false;
                         }
                     }
-                    return true;
+                    return max_persistence_lag || shard_persisted_upto(subgroup_num, seq_num, sst);
                 };
                 auto sender_trig = [this, subgroup_num](DerechoSST& sst) {
-                    sender_cv.notify_all();
+                    wake_sender();
                     next_message_to_deliver[subgroup_num]++;
                 };
-                sender_pred_handles.emplace_back(sst->predicates.insert(sender_pred, sender_trig,
-                                                                        sst::PredicateType::RECURRENT));
+                sender_pred_handles.emplace_back(sst->predicates.insert(sender_pred, locked_trigger(subgroup_num, sender_trig),
+                                                                        sst::PredicateType::RECURRENT, subgroup_num));
             }
         } else {
-            //This subgroup is in raw mode
+            //Stability and delivery are per sender, with no persistence
+            if(curr_subgroup_settings.mode == Mode::FIFO_STABLE) {
+                auto delivery_pred = [this](const DerechoSST& sst) { return true; };
+                auto delivery_trig = [=](DerechoSST& sst) mutable {
+                    fifo_delivery_trigger(subgroup_num, curr_subgroup_settings, num_shard_senders, sst);
+                };
+                delivery_pred_handles.emplace_back(sst->predicates.insert(delivery_pred, locked_trigger(subgroup_num, delivery_trig),
+                                                                          sst::PredicateType::RECURRENT, subgroup_num));
+            }
+            //A raw sender's slot is free once received everywhere, a FIFO_STABLE sender's once delivered everywhere
             if(curr_subgroup_settings.sender_rank >= 0) {
                 auto sender_pred = [this, subgroup_num, curr_subgroup_settings, num_shard_members](const DerechoSST& sst) {
+                    const int32_t active_window = active_window_size(subgroup_num);
                     for(uint i = 0; i < num_shard_members; ++i) {
                         uint32_t num_received_offset = subgroup_settings.at(subgroup_num).num_received_offset;
-                        if(sst.num_received[node_id_to_sst_index.at(curr_subgroup_settings.members[i])][num_received_offset + curr_subgroup_settings.sender_rank]
-                           < static_cast<int32_t>(future_message_indices[subgroup_num] - 1 - window_size)) {
+                        if(sender_progress(sst, curr_subgroup_settings.mode, node_id_to_sst_index.at(curr_subgroup_settings.members[i]),
+                                           num_received_offset + curr_subgroup_settings.sender_rank)
+                           < static_cast<int32_t>(future_message_indices[subgroup_num] - 1 - active_window)) {
                             return false;
                         }
                     }
                     return true;
                 };
                 auto sender_trig = [this, subgroup_num](DerechoSST& sst) {
-                    sender_cv.notify_all();
+                    wake_sender();
                 };
-                sender_pred_handles.emplace_back(sst->predicates.insert(sender_pred, sender_trig,
-                                                                        sst::PredicateType::RECURRENT));
+                sender_pred_handles.emplace_back(sst->predicates.insert(sender_pred, locked_trigger(subgroup_num, sender_trig),
+                                                                        sst::PredicateType::RECURRENT, subgroup_num));
             }
         }
+        // Feed the retirement of this node's messages to its adaptive window
+        if(curr_subgroup_settings.sender_rank >= 0 && sender_windows.at(subgroup_num).is_adaptive()) {
+            auto window_pred = [this, subgroup_num, curr_subgroup_settings, num_shard_senders](const DerechoSST& sst) {
+                return compute_retired_index(subgroup_num, curr_subgroup_settings, num_shard_senders, sst)
+                       > sender_windows.at(subgroup_num).get_last_retired_index();
+            };
+            auto window_trig = [this, subgroup_num, curr_subgroup_settings, num_shard_senders](DerechoSST& sst) {
+                AdaptiveWindow& sender_window = sender_windows.at(subgroup_num);
+                const unsigned int old_size = sender_window.size();
+                sender_window.on_retired(compute_retired_index(subgroup_num, curr_subgroup_settings, num_shard_senders, sst),
+                                         get_time());
+                if(sender_window.size() != old_size) {
+                    logger->debug("Subgroup {}: window changed from {} to {}", subgroup_num, old_size, sender_window.size());
+                    wake_sender();
+                }
+            };
+            sender_pred_handles.emplace_back(sst->predicates.insert(window_pred, locked_trigger(subgroup_num, window_trig),
+                                                                    sst::PredicateType::RECURRENT, subgroup_num));
+        }
+    }
+}
+
+void MulticastGroup::create_sender_windows() {
+    for(const auto& p : subgroup_settings) {
+        if(p.second.sender_rank >= 0) {
+            sender_windows.emplace(std::piecewise_construct,
+                                   std::forward_as_tuple(p.first),
+                                   std::forward_as_tuple(min_window_size, window_size));
+        }
+    }
+}
+
+bool MulticastGroup::shard_persisted_upto(subgroup_id_t subgroup_num, message_id_t seq_num, const DerechoSST& sst) {
+    for(auto member : subgroup_settings.at(subgroup_num).members) {
+        // persisted_num holds a version, which packs the vid above the sequence number
+        const persistent::version_t persisted_num = sst.persisted_num[node_id_to_sst_index.at(member)][subgroup_num];
+        if(persistent::unpack_version<int32_t>(persisted_num).second < seq_num) {
+            return false;
+        }
+    }
+    return true;
+}
+
+unsigned int MulticastGroup::active_window_size(subgroup_id_t subgroup_num) {
+    auto window = sender_windows.find(subgroup_num);
+    if(window == sender_windows.end()) {
+        return window_size;
+    }
+    return window->second.size();
+}
+
+message_id_t MulticastGroup::compute_retired_index(subgroup_id_t subgroup_num, const SubgroupSettings& curr_subgroup_settings,
+                                                   uint32_t num_shard_senders, const DerechoSST& sst) {
+    const int32_t sender_rank = curr_subgroup_settings.sender_rank;
+    if(curr_subgroup_settings.mode != Mode::ORDERED) {
+        const uint32_t num_received_entry = curr_subgroup_settings.num_received_offset + sender_rank;
+        message_id_t min_num_received = std::numeric_limits<message_id_t>::max();
+        for(auto member : curr_subgroup_settings.members) {
+            const message_id_t num_received = sender_progress(sst, curr_subgroup_settings.mode, node_id_to_sst_index.at(member), num_received_entry);
+            min_num_received = std::min(min_num_received, num_received);
+        }
+        return min_num_received;
     }
+    // Same condition as send_loop: a message is retired once it is delivered everywhere, and
+    // persisted everywhere unless persistence has its own lag, which must not shrink the window
+    int64_t min_seq_num = std::numeric_limits<int64_t>::max();
+    for(auto member : curr_subgroup_settings.members) {
+        const uint32_t row = node_id_to_sst_index.at(member);
+        const int64_t delivered_num = sst.delivered_num[row][subgroup_num];
+        min_seq_num = std::min(min_seq_num, delivered_num);
+        if(!max_persistence_lag) {
+            const int64_t persisted_num = persistent::unpack_version<int32_t>(sst.persisted_num[row][subgroup_num]).second;
+            min_seq_num = std::min(min_seq_num, persisted_num);
+        }
+    }
+    if(min_seq_num < sender_rank) {
+        return -1;
+    }
+    return (min_seq_num - sender_rank) / num_shard_senders;
 }
 
 MulticastGroup::~MulticastGroup() {
@@ -968,6 +1476,19 @@ MulticastGroup::~MulticastGroup() {
     if(timeout_thread.joinable()) {
         timeout_thread.join();
     }
+    // Whatever a successor group did not adopt can no longer complete
+    for(auto& queues : {&unstable_completions, &undelivered_completions}) {
+        for(auto& subgroup_queue : *queues) {
+            for(auto& waiter : subgroup_queue.second) {
+                waiter.second->abandon();
+            }
+        }
+    }
+    for(auto& subgroup_queue : unpersisted_completions) {
+        for(auto& waiter : subgroup_queue.second) {
+            waiter.second->abandon();
+        }
+    }
 }
 
 long long unsigned int MulticastGroup::compute_max_msg_size(
@@ -1007,12 +1528,20 @@ void MulticastGroup::wedge() {
         sst->predicates.remove(*handle_iter);
         handle_iter = persistence_pred_handles.erase(handle_iter);
     }
+    // Rather than wait for the predicate threads, which may be blocked on a
+    // lock our caller holds, take each subgroup's lock: a trigger running now
+    // finishes first, and one that starts later finds the subgroup wedged
+    for(auto& state_lock : msg_state_locks) {
+        std::lock_guard<std::mutex> lock(state_lock->mtx);
+        state_lock->wedged = true;
+    }
 
-    for(uint i = 0; i < num_members; ++i) {
-        rdmc::destroy_group(i + rdmc_group_num_offset);
+    for(uint16_t rdmc_group_number : rdmc_group_numbers) {
+        rdmc::destroy_group(*rdmc_context, rdmc_group_number);
     }
+    rdmc_group_numbers.clear();
 
-    sender_cv.notify_all();
+    wake_sender();
     if(sender_thread.joinable()) {
         sender_thread.join();
     }
@@ -1020,6 +1549,7 @@ void MulticastGroup::wedge() {
 
 void MulticastGroup::send_loop() {
     pthread_setname_np(pthread_self(), "sender_thread");
+    pin_thread(ThreadRole::SENDER);
     subgroup_id_t subgroup_to_send = 0;
     auto should_send_to_subgroup = [&](subgroup_id_t subgroup_num) {
         if(!rdmc_sst_groups_created) {
@@ -1036,27 +1566,32 @@ void MulticastGroup::send_loop() {
         assert(shard_sender_index >= 0);
 
         // std::cout << "num_received offset = " << subgroup_to_num_received_offset.at(subgroup_num) + shard_sender_index <<
-        //         ", num_received entry " <<  sst->num_received[member_index][subgroup_to_num_received_offset.at(subgroup_num) + shard_sender_index] <<
+        //         ", num_received entry " <<  sst->receive_counters[member_index][subgroup_to_num_received_offset.at(subgroup_num) + shard_sender_index].num_received <<
         //         ", message index = " << msg.index << std::endl;
-        if(sst->num_received[member_index][subgroup_settings.at(subgroup_num).num_received_offset + shard_sender_index] < msg.index - 1) {
+        if(sst->receive_counters[member_index][subgroup_settings.at(subgroup_num).num_received_offset + shard_sender_index].num_received < msg.index - 1) {
             return false;
         }
 
         std::vector<node_id_t> shard_members = subgroup_settings.at(subgroup_num).members;
         auto num_shard_members = shard_members.size();
         assert(num_shard_members >= 1);
-        if(subgroup_settings.at(subgroup_num).mode != Mode::UNORDERED) {
+        const int32_t active_window = active_window_size(subgroup_num);
+        if(subgroup_settings.at(subgroup_num).mode == Mode::ORDERED) {
             for(uint i = 0; i < num_shard_members; ++i) {
-                if(sst->delivered_num[node_id_to_sst_index.at(shard_members[i])][subgroup_num] < static_cast<message_id_t>((msg.index - window_size) * num_shard_senders + shard_sender_index)
-                   || (sst->persisted_num[node_id_to_sst_index.at(shard_members[i])][subgroup_num] < static_cast<message_id_t>((msg.index - window_size) * num_shard_senders + shard_sender_index))) {
+                if(sst->delivered_num[node_id_to_sst_index.at(shard_members[i])][subgroup_num] < static_cast<message_id_t>((msg.index - active_window) * num_shard_senders + shard_sender_index)) {
                     return false;
                 }
             }
+            const int32_t persistence_window = max_persistence_lag ? max_persistence_lag : active_window;
+            if(!shard_persisted_upto(subgroup_num, (msg.index - persistence_window) * num_shard_senders + shard_sender_index, *sst)) {
+                return false;
+            }
         } else {
             for(uint i = 0; i < num_shard_members; ++i) {
                 auto num_received_offset = subgroup_settings.at(subgroup_num).num_received_offset;
-                if(sst->num_received[node_id_to_sst_index.at(shard_members[i])][num_received_offset + shard_sender_index]
-                   < static_cast<int32_t>(future_message_indices[subgroup_num] - 1 - window_size)) {
+                if(sender_progress(*sst, subgroup_settings.at(subgroup_num).mode, node_id_to_sst_index.at(shard_members[i]),
+                                   num_received_offset + shard_sender_index)
+                   < static_cast<int32_t>(future_message_indices[subgroup_num] - 1 - active_window)) {
                     return false;
                 }
             }
@@ -1064,34 +1599,42 @@ void MulticastGroup::send_loop() {
 
         return true;
     };
-    auto should_send = [&]() {
+    // Sends the next message of the first subgroup, after the last one sent
+    // to, that has one ready; each subgroup is examined under its own lock
+    auto send_next = [&]() {
         for(uint i = 1; i <= total_num_subgroups; ++i) {
             auto subgroup_num = (subgroup_to_send + i) % total_num_subgroups;
-            if(should_send_to_subgroup(subgroup_num)) {
-                subgroup_to_send = subgroup_num;
-                return true;
+            std::lock_guard<std::mutex> lock(msg_state_locks[subgroup_num]->mtx);
+            if(thread_shutdown || !should_send_to_subgroup(subgroup_num)) {
+                continue;
+            }
+            subgroup_to_send = subgroup_num;
+            current_sends[subgroup_to_send] = std::move(pending_sends[subgroup_to_send].front());
+            // DERECHO_LOG(-1, -1, "got_current_send");
+            logger->trace("Calling send in subgroup {} on message {} from sender {}", subgroup_to_send, current_sends[subgroup_to_send]->index, current_sends[subgroup_to_send]->sender_id);
+            // DERECHO_LOG(-1, -1, "did_log_event");
+            if(!rdmc::send(*rdmc_context, subgroup_to_rdmc_group[subgroup_to_send],
+                           current_sends[subgroup_to_send]->message_buffer.mr, 0,
+                           current_sends[subgroup_to_send]->size)) {
+                throw std::runtime_error("rdmc::send returned false");
             }
+            // DERECHO_LOG(-1, -1, "issued_rdmc_send");
+            pending_sends[subgroup_to_send].pop();
+            return true;
         }
         return false;
     };
-    auto should_wake = [&]() { return thread_shutdown || should_send(); };
     try {
-        std::unique_lock<std::mutex> lock(msg_state_mtx);
+        std::unique_lock<std::mutex> lock(sender_mtx);
         while(!thread_shutdown) {
-            sender_cv.wait(lock, should_wake);
-            // DERECHO_LOG(send_cnt, -1, "sender thread woke up");
-            if(!thread_shutdown) {
-                current_sends[subgroup_to_send] = std::move(pending_sends[subgroup_to_send].front());
-                // DERECHO_LOG(-1, -1, "got_current_send");
-                logger->trace("Calling send in subgroup {} on message {} from sender {}", subgroup_to_send, current_sends[subgroup_to_send]->index, current_sends[subgroup_to_send]->sender_id);
-                // DERECHO_LOG(-1, -1, "did_log_event");
-                if(!rdmc::send(subgroup_to_rdmc_group[subgroup_to_send],
-                               current_sends[subgroup_to_send]->message_buffer.mr, 0,
-                               current_sends[subgroup_to_send]->size)) {
-                    throw std::runtime_error("rdmc::send returned false");
-                }
-                // DERECHO_LOG(-1, -1, "issued_rdmc_send");
-                pending_sends[subgroup_to_send].pop();
+            // A wake_sender() after this point makes the wait below return at once
+            const uint64_t wakeups_seen = sender_wakeups;
+            lock.unlock();
+            const bool sent = send_next();
+            lock.lock();
+            if(!sent) {
+                sender_cv.wait(lock, [&]() { return thread_shutdown || sender_wakeups != wakeups_seen; });
+                // DERECHO_LOG(send_cnt, -1, "sender thread woke up");
             }
         }
         std::cout << "DerechoGroup send thread shutting down" << std::endl;
@@ -1100,10 +1643,14 @@ void MulticastGroup::send_loop() {
     }
 }
 
+void MulticastGroup::wake_sender() {
+    std::lock_guard<std::mutex> lock(sender_mtx);
+    sender_wakeups++;
+    sender_cv.notify_all();
+}
+
 uint64_t MulticastGroup::get_time() {
-    struct timespec start_time;
-    clock_gettime(CLOCK_REALTIME, &start_time);
-    return start_time.tv_sec * 1e9 + start_time.tv_nsec;
+    return get_walltime();
 }
 
 const uint64_t MulticastGroup::compute_global_stability_frontier(uint32_t subgroup_num) {
@@ -1117,13 +1664,14 @@ const uint64_t MulticastGroup::compute_global_stability_frontier(uint32_t subgro
 
 void MulticastGroup::check_failures_loop() {
     pthread_setname_np(pthread_self(), "timeout_thread");
+    pin_thread(ThreadRole::TIMEOUT);
     while(!thread_shutdown) {
         std::this_thread::sleep_for(std::chrono::milliseconds(sender_timeout));
         if(sst) {
-            std::unique_lock<std::mutex> lock(msg_state_mtx);
             auto current_time = get_time();
             for(auto p : subgroup_settings) {
                 auto subgroup_num = p.first;
+                std::lock_guard<std::mutex> lock(msg_state_locks[subgroup_num]->mtx);
                 auto members = p.second.members;
                 auto sst_indices = get_shard_sst_indices(subgroup_num);
                 // clean up timestamps of persisted messages
@@ -1185,29 +1733,40 @@ char* MulticastGroup::get_sendbuffer_ptr(subgroup_id_t subgroup_num,
     num_shard_senders = get_num_senders(shard_senders);
     assert(shard_sender_index >= 0);
 
-    if(subgroup_settings.at(subgroup_num).mode != Mode::UNORDERED) {
+    AdaptiveWindow& sender_window = sender_windows.at(subgroup_num);
+    const int32_t active_window = sender_window.size();
+    if(subgroup_settings.at(subgroup_num).mode == Mode::ORDERED) {
         for(uint i = 0; i < num_shard_members; ++i) {
             if(sst->delivered_num[node_id_to_sst_index.at(shard_members[i])][subgroup_num]
-               < static_cast<int32_t>((future_message_indices[subgroup_num] - window_size) * num_shard_senders + shard_sender_index)) {
+               < static_cast<int32_t>((future_message_indices[subgroup_num] - active_window) * num_shard_senders + shard_sender_index)) {
+                sender_window.on_blocked();
                 return nullptr;
             }
         }
+        // Falling behind on persistence holds the sender back without shrinking its window
+        if(max_persistence_lag
+           && !shard_persisted_upto(subgroup_num, (future_message_indices[subgroup_num] - static_cast<int32_t>(max_persistence_lag)) * num_shard_senders + shard_sender_index, *sst)) {
+            return nullptr;
+        }
     } else {
         for(uint i = 0; i < num_shard_members; ++i) {
             auto num_received_offset = subgroup_settings.at(subgroup_num).num_received_offset;
-            if(sst->num_received[node_id_to_sst_index.at(shard_members[i])][num_received_offset + shard_sender_index]
-               < static_cast<int32_t>(future_message_indices[subgroup_num] - window_size)) {
+            if(sender_progress(*sst, subgroup_settings.at(subgroup_num).mode, node_id_to_sst_index.at(shard_members[i]),
+                               num_received_offset + shard_sender_index)
+               < static_cast<int32_t>(future_message_indices[subgroup_num] - active_window)) {
+                sender_window.on_blocked();
                 return nullptr;
             }
         }
     }
 
-    if(msg_size > sst::max_msg_size) {
+    if(msg_size > sst_thresholds[subgroup_num]) {
         if(thread_shutdown) {
             return nullptr;
         }
 
-        std::unique_lock<std::mutex> lock(msg_state_mtx);
+        std::unique_lock<std::mutex> lock(msg_state_locks[subgroup_num]->mtx);
+        reclaim_released_buffers(subgroup_num);
         if(free_message_buffers[subgroup_num].empty()) return nullptr;
 
         // Create new Message
@@ -1220,6 +1779,7 @@ char* MulticastGroup::get_sendbuffer_ptr(subgroup_id_t subgroup_num,
 
         auto current_time = get_time();
         pending_message_timestamps[subgroup_num].insert(current_time);
+        sender_window.on_send(msg.index, current_time);
 
         // Fill header
         char* buf = msg.message_buffer.buffer.get();
@@ -1236,7 +1796,7 @@ char* MulticastGroup::get_sendbuffer_ptr(subgroup_id_t subgroup_num,
         // DERECHO_LOG(-1, -1, "provided a buffer");
         return buf + sizeof(header);
     } else {
-        std::unique_lock<std::mutex> lock(msg_state_mtx);
+        std::unique_lock<std::mutex> lock(msg_state_locks[subgroup_num]->mtx);
         pending_sst_sends[subgroup_num] = true;
         if(thread_shutdown) {
             pending_sst_sends[subgroup_num] = false;
@@ -1249,12 +1809,14 @@ char* MulticastGroup::get_sendbuffer_ptr(subgroup_id_t subgroup_num,
         }
         auto current_time = get_time();
         pending_message_timestamps[subgroup_num].insert(current_time);
+        sender_window.on_send(future_message_indices[subgroup_num], current_time);
 
         ((header*)buf)->header_size = sizeof(header);
         ((header*)buf)->pause_sending_turns = pause_sending_turns;
         ((header*)buf)->index = future_message_indices[subgroup_num];
         ((header*)buf)->timestamp = current_time;
         ((header*)buf)->cooked_send = cooked_send;
+        next_sst_send_indices[subgroup_num] = future_message_indices[subgroup_num];
         future_message_indices[subgroup_num] += pause_sending_turns + 1;
         logger->trace("Subgroup {}: get_sendbuffer_ptr increased future_message_indices to {}", subgroup_num, future_message_indices[subgroup_num]);
 
@@ -1264,24 +1826,34 @@ char* MulticastGroup::get_sendbuffer_ptr(subgroup_id_t subgroup_num,
     }
 }
 
-bool MulticastGroup::send(subgroup_id_t subgroup_num) {
+bool MulticastGroup::send(subgroup_id_t subgroup_num, std::shared_ptr<CompletionState> completion) {
     if(!rdmc_sst_groups_created) {
         return false;
     }
+    if(completion && subgroup_settings.at(subgroup_num).mode != Mode::ORDERED) {
+        completion->abandon();
+        completion = nullptr;
+    }
     if(last_transfer_medium[subgroup_num]) {
         // check thread_shutdown only for RDMC sends
         if(thread_shutdown) {
             return false;
         }
-        std::lock_guard<std::mutex> lock(msg_state_mtx);
+        std::lock_guard<std::mutex> lock(msg_state_locks[subgroup_num]->mtx);
         assert(next_sends[subgroup_num]);
+        if(completion) {
+            track_completion(subgroup_num, next_sends[subgroup_num]->index, std::move(completion));
+        }
         pending_sends[subgroup_num].push(std::move(*next_sends[subgroup_num]));
         next_sends[subgroup_num] = std::experimental::nullopt;
-        sender_cv.notify_all();
+        wake_sender();
         // DERECHO_LOG(-1, -1, "user_send_finished");
         return true;
     } else {
-        std::lock_guard<std::mutex> lock(msg_state_mtx);
+        std::lock_guard<std::mutex> lock(msg_state_locks[subgroup_num]->mtx);
+        if(completion) {
+            track_completion(subgroup_num, next_sst_send_indices[subgroup_num], std::move(completion));
+        }
         sst_multicast_group_ptrs[subgroup_num]->send();
         pending_sst_sends[subgroup_num] = false;
         // DERECHO_LOG(-1, -1, "user_send_finished");
@@ -1290,10 +1862,103 @@ bool MulticastGroup::send(subgroup_id_t subgroup_num) {
 }
 
 bool MulticastGroup::check_pending_sst_sends(subgroup_id_t subgroup_num) {
-    std::lock_guard<std::mutex> lock(msg_state_mtx);
+    std::lock_guard<std::mutex> lock(msg_state_locks[subgroup_num]->mtx);
     return pending_sst_sends[subgroup_num];
 }
 
+void MulticastGroup::track_completion(subgroup_id_t subgroup_num, message_id_t index,
+                                      std::shared_ptr<CompletionState> completion) {
+    const SubgroupSettings& settings = subgroup_settings.at(subgroup_num);
+    const message_id_t seq_num = index * get_num_senders(settings.senders) + settings.sender_rank;
+    unstable_completions[subgroup_num].emplace(seq_num, std::move(completion));
+}
+
+void MulticastGroup::complete_stable(subgroup_id_t subgroup_num, message_id_t min_stable_num) {
+    auto& waiters = unstable_completions[subgroup_num];
+    while(!waiters.empty() && waiters.begin()->first <= min_stable_num) {
+        auto& completion = waiters.begin()->second;
+        completion->advance(MessageMilestone::STABLE, -1);
+        if(completion->until > MessageMilestone::STABLE) {
+            undelivered_completions[subgroup_num].emplace(waiters.begin()->first, std::move(completion));
+        }
+        waiters.erase(waiters.begin());
+    }
+}
+
+void MulticastGroup::complete_delivered(subgroup_id_t subgroup_num, message_id_t delivered_num) {
+    auto& waiters = undelivered_completions[subgroup_num];
+    while(!waiters.empty() && waiters.begin()->first <= delivered_num) {
+        auto& completion = waiters.begin()->second;
+        const persistent::version_t version = persistent::combine_int32s(sst->vid[member_index], waiters.begin()->first);
+        completion->advance(MessageMilestone::DELIVERED, version);
+        if(completion->until > MessageMilestone::DELIVERED) {
+            unpersisted_completions[subgroup_num].emplace(version, std::move(completion));
+        }
+        waiters.erase(waiters.begin());
+    }
+}
+
+void MulticastGroup::complete_persisted(subgroup_id_t subgroup_num, persistent::version_t min_persisted_num) {
+    auto& waiters = unpersisted_completions[subgroup_num];
+    while(!waiters.empty() && waiters.begin()->first <= min_persisted_num) {
+        waiters.begin()->second->advance(MessageMilestone::PERSISTED, waiters.begin()->first);
+        waiters.erase(waiters.begin());
+    }
+}
+
+void MulticastGroup::adopt_completions(MulticastGroup& old_group,
+                                       const std::map<std::pair<subgroup_id_t, message_id_t>, message_id_t>& new_indices) {
+    // Delivered messages keep their versions, and only wait for persistence.
+    // This group's persisted_num starts over, so the versions the old group's
+    // shard members had persisted are applied first, and only the rest move.
+    for(auto& subgroup_queue : old_group.unpersisted_completions) {
+        const subgroup_id_t subgroup_num = subgroup_queue.first;
+        if(subgroup_queue.second.empty()) {
+            continue;
+        }
+        const SubgroupSettings& old_settings = old_group.subgroup_settings.at(subgroup_num);
+        // Failed members' rows are frozen, so like the ragged edge cleanup, only survivors count
+        persistent::version_t min_persisted_num = std::numeric_limits<persistent::version_t>::max();
+        for(const node_id_t member : old_settings.members) {
+            const uint32_t sst_index = old_group.node_id_to_sst_index.at(member);
+            if(old_group.sst->suspected[old_group.member_index][sst_index]) {
+                continue;
+            }
+            const persistent::version_t persisted_num = old_group.sst->persisted_num[sst_index][subgroup_num];
+            if(persisted_num < min_persisted_num) {
+                min_persisted_num = persisted_num;
+            }
+        }
+        old_group.complete_persisted(subgroup_num, min_persisted_num);
+        if(subgroup_settings.count(subgroup_num)) {
+            unpersisted_completions[subgroup_num].swap(subgroup_queue.second);
+        }
+    }
+    // Undelivered ones are tracked again under the index they are re-sent with, if any
+    for(auto& queues : {&old_group.unstable_completions, &old_group.undelivered_completions}) {
+        for(auto& subgroup_queue : *queues) {
+            const subgroup_id_t subgroup_num = subgroup_queue.first;
+            if(subgroup_queue.second.empty()) {
+                continue;
+            }
+            const SubgroupSettings& old_settings = old_group.subgroup_settings.at(subgroup_num);
+            const uint32_t old_num_senders = old_group.get_num_senders(old_settings.senders);
+            for(auto& waiter : subgroup_queue.second) {
+                const message_id_t old_index = (waiter.first - old_settings.sender_rank) / old_num_senders;
+                auto new_index = new_indices.find({subgroup_num, old_index});
+                if(new_index != new_indices.end() && subgroup_settings.count(subgroup_num)
+                   && subgroup_settings.at(subgroup_num).sender_rank >= 0) {
+                    track_completion(subgroup_num, new_index->second, std::move(waiter.second));
+                }
+            }
+            // Anything not moved is left for old_group's destructor to abandon
+            for(auto it = subgroup_queue.second.begin(); it != subgroup_queue.second.end();) {
+                it = it->second ? std::next(it) : subgroup_queue.second.erase(it);
+            }
+        }
+    }
+}
+
 std::vector<uint32_t> MulticastGroup::get_shard_sst_indices(subgroup_id_t subgroup_num) {
     std::vector<node_id_t> shard_members = subgroup_settings.at(subgroup_num).members;
 
@@ -1315,7 +1980,7 @@ void MulticastGroup::debug_print() {
         cout << "Subgroup " << subgroup_num << endl;
         cout << "Printing seq_num, stable_num, delivered_num" << endl;
         for(uint i = 0; i < num_members; ++i) {
-            cout << sst->seq_num[i][subgroup_num] << " " << sst->stable_num[i][subgroup_num] << " " << sst->delivered_num[i][subgroup_num] << endl;
+            cout << sst->receive_counters[i][subgroup_settings.at(subgroup_num).num_received_offset].seq_num << " " << sst->stable_num[i][subgroup_num] << " " << sst->delivered_num[i][subgroup_num] << endl;
         }
         cout << endl;
 
@@ -1325,7 +1990,7 @@ void MulticastGroup::debug_print() {
         cout << "Printing last_received_messages" << endl;
         for(uint k = 0; k < num_members; ++k) {
             for(uint i = 0; i < num_shard_senders; ++i) {
-                cout << sst->num_received[k][num_received_offset + i] << " ";
+                cout << sst->receive_counters[k][num_received_offset + i].num_received << " ";
             }
             cout << endl;
         }
@@ -14,11 +14,14 @@
 #include <tuple>
 #include <vector>
 
+#include "adaptive_window.h"
 #include "connection_manager.h"
 #include "derecho_internal.h"
 #include "derecho_modes.h"
 #include "derecho_ports.h"
 #include "derecho_sst.h"
+#include "message_completion.h"
+#include "placement.h"
 #include "mutils-serialization/SerializationMacros.hpp"
 #include "mutils-serialization/SerializationSupport.hpp"
 #include "rdmc/rdmc.h"
@@ -26,6 +29,7 @@
 #include "sst/multicast.h"
 #include "sst/sst.h"
 #include "subgroup_info.h"
+#include "transfer_cost_model.h"
 
 namespace derecho {
 
@@ -39,6 +43,16 @@ using message_callback_t = std::function<void(subgroup_id_t, node_id_t, message_
 using persistence_callback_t = std::function<void(subgroup_id_t, persistent::version_t)>;
 using rpc_handler_t = std::function<void(subgroup_id_t, node_id_t, char*, uint32_t)>;
 
+class OwnedMessage;
+/** Alias for the delivery callback that hands ownership of a received message's buffer to the client. */
+using owned_message_callback_t = std::function<void(subgroup_id_t, node_id_t, message_id_t, OwnedMessage&&)>;
+/** Alias for the callback that withdraws a message handed out before it was stable. */
+using rollback_callback_t = std::function<void(subgroup_id_t, node_id_t, message_id_t)>;
+/** Alias for a client-supplied function that provides memory for a subgroup's message buffers. */
+using buffer_allocator_t = std::function<char*(subgroup_id_t, std::size_t)>;
+/** Alias for a client-supplied function that takes back memory obtained from a buffer_allocator_t. */
+using buffer_deallocator_t = std::function<void(subgroup_id_t, char*)>;
+
 /**
  * Bundles together a set of callback functions for message delivery events.
  * These will be invoked by DerechoGroup to hand control back to the client
@@ -48,6 +62,33 @@ struct CallbackSet {
     message_callback_t global_stability_callback;
     persistence_callback_t local_persistence_callback = nullptr;
     persistence_callback_t global_persistence_callback = nullptr;
+    /**
+     * If set, raw messages are delivered through this callback instead of
+     * global_stability_callback, and the client owns the message buffer until
+     * it calls OwnedMessage::release(). This avoids copying the payload out of
+     * the receive buffer when the client wants to keep it.
+     */
+    owned_message_callback_t owned_stability_callback = nullptr;
+    /**
+     * If set, called to obtain the memory for each message buffer (send and
+     * receive) in a subgroup. Derecho registers the memory for RDMA itself.
+     * The buffer must be at least the requested size and stay valid until it
+     * is handed to receive_buffer_deallocator.
+     */
+    buffer_allocator_t receive_buffer_allocator = nullptr;
+    buffer_deallocator_t receive_buffer_deallocator = nullptr;
+    /**
+     * If set, raw messages in ordered subgroups are also handed to this
+     * callback as soon as this node has received them and every message
+     * before them in the total order, one SST round trip before they are
+     * stable. The buffer is only valid during the call. The message is
+     * confirmed by the stability callback as usual; if a view change trims
+     * it instead, local_receipt_rollback_callback is called for it.
+     */
+    message_callback_t local_receipt_callback = nullptr;
+    /** Called, newest first, for each message given to local_receipt_callback
+     * that the ragged edge cleanup of a view change did not deliver. */
+    rollback_callback_t local_receipt_rollback_callback = nullptr;
 };
 
 struct DerechoParams : public mutils::ByteRepresentable {
@@ -57,22 +98,77 @@ struct DerechoParams : public mutils::ByteRepresentable {
     unsigned int timeout_ms = 1;
     rdmc::send_algorithm type = rdmc::BINOMIAL_SEND;
     uint32_t rpc_port = derecho_rpc_port;
+    /** If smaller than window_size, each sender's window adapts between
+     * min_window_size and window_size; 0 keeps the window fixed. Slots and
+     * buffers are always provisioned for window_size. */
+    unsigned int min_window_size = 0;
+    /** If nonzero, a receiver holds its acknowledgements of SST messages
+     * (the put of its ReceiveCounters) for up to this many microseconds, so
+     * that one put acknowledges several messages. If 0, every pass of the
+     * receiver acknowledges, as without coalescing. */
+    unsigned int ack_hold_us = 0;
+    /** If nonzero, held acknowledgements are flushed once this many
+     * messages have been received. Only used when ack_hold_us is nonzero. */
+    unsigned int ack_hold_messages = 0;
+    /** Messages up to this size (including the header) are sent through SST
+     * slots rather than RDMC. A negative value means the threshold is derived
+     * per subgroup from a calibrated TransferCostModel. Either way it is
+     * capped by the size of an SST slot. */
+    long long int sst_threshold = -1;
+    /** If nonzero, group-wide updates of the membership fields of the SST are
+     * relayed over a tree of members with this many children per node,
+     * instead of being written by the updating node to every member. */
+    unsigned int sst_relay_fanout = 0;
+    /** The number of threads that evaluate SST predicates. The membership
+     * predicates stay on one thread; with more than one, the predicates of
+     * each subgroup are assigned to one of the others by subgroup number. */
+    unsigned int sst_detect_threads = 1;
+    /** In ordered mode, how many of its messages a sender may have delivered
+     * everywhere but not yet persisted everywhere before it is held back,
+     * independently of window_size. 0 holds persistence to the send window. */
+    unsigned int max_persistence_lag = 0;
+    /** The ports SST and RDMC connect to the other members on. Groups in one
+     * process share the RDMA device and polling threads either way, but
+     * groups that are set up at the same time, here or on any other member,
+     * need their own ports. */
+    uint32_t sst_port = sst_tcp_port;
+    uint32_t rdmc_port = rdmc_tcp_port;
 
     DerechoParams(long long unsigned int max_payload_size,
                   long long unsigned int block_size,
                   unsigned int window_size = 3,
                   unsigned int timeout_ms = 1,
                   rdmc::send_algorithm type = rdmc::BINOMIAL_SEND,
-                  uint32_t rpc_port = derecho_rpc_port)
+                  uint32_t rpc_port = derecho_rpc_port,
+                  long long int sst_threshold = -1,
+                  unsigned int min_window_size = 0,
+                  unsigned int ack_hold_us = 0,
+                  unsigned int ack_hold_messages = 0,
+                  unsigned int sst_relay_fanout = 0,
+                  unsigned int sst_detect_threads = 1,
+                  unsigned int max_persistence_lag = 0,
+                  uint32_t sst_port = sst_tcp_port,
+                  uint32_t rdmc_port = rdmc_tcp_port)
             : max_payload_size(max_payload_size),
               block_size(block_size),
               window_size(window_size),
               timeout_ms(timeout_ms),
               type(type),
-              rpc_port(rpc_port) {
+              rpc_port(rpc_port),
+              min_window_size(min_window_size),
+              ack_hold_us(ack_hold_us),
+              ack_hold_messages(ack_hold_messages),
+              sst_threshold(sst_threshold),
+              sst_relay_fanout(sst_relay_fanout),
+              sst_detect_threads(sst_detect_threads),
+              max_persistence_lag(max_persistence_lag),
+              sst_port(sst_port),
+              rdmc_port(rdmc_port) {
     }
 
-    DEFAULT_SERIALIZATION_SUPPORT(DerechoParams, max_payload_size, block_size, window_size, timeout_ms, type, rpc_port);
+    DEFAULT_SERIALIZATION_SUPPORT(DerechoParams, max_payload_size, block_size, window_size, timeout_ms, type, rpc_port, sst_threshold, min_window_size,
+                                  ack_hold_us, ack_hold_messages, sst_relay_fanout, sst_detect_threads,
+                                  max_persistence_lag, sst_port, rdmc_port);
 };
 
 struct __attribute__((__packed__)) header {
@@ -90,22 +186,92 @@ struct __attribute__((__packed__)) header {
  * This is a move-only type, since memory regions can't be copied.
  */
 struct MessageBuffer {
-    std::unique_ptr<char[]> buffer;
+    std::unique_ptr<char[], std::function<void(char*)>> buffer;
     std::shared_ptr<rdma::memory_region> mr;
 
     MessageBuffer() {}
+    /** Allocates a buffer, registered with the context's RDMA device. */
+    MessageBuffer(rdma::transport_context& context, size_t size) {
+        if(size != 0) {
+            buffer = std::unique_ptr<char[], std::function<void(char*)>>(
+                    allocate_registered_memory(size), free_registered_memory);
+            mr = std::make_shared<rdma::memory_region>(context, buffer.get(), size);
+        }
+    }
+    /** Allocates a buffer that is not registered for RDMA. */
     MessageBuffer(size_t size) {
         if(size != 0) {
-            buffer = std::unique_ptr<char[]>(new char[size]);
-            mr = std::make_shared<rdma::memory_region>(buffer.get(), size);
+            buffer = std::unique_ptr<char[], std::function<void(char*)>>(
+                    new char[size], [](char* p) { delete[] p; });
         }
     }
+    /** Wraps memory supplied by the client, which will be handed to deleter
+     * when this MessageBuffer is destroyed. */
+    MessageBuffer(rdma::transport_context& context, char* client_buffer, size_t size,
+                  std::function<void(char*)> deleter)
+            : buffer(client_buffer, std::move(deleter)),
+              mr(std::make_shared<rdma::memory_region>(context, client_buffer, size)) {}
     MessageBuffer(const MessageBuffer&) = delete;
     MessageBuffer(MessageBuffer&&) = default;
     MessageBuffer& operator=(const MessageBuffer&) = delete;
     MessageBuffer& operator=(MessageBuffer&&) = default;
 };
 
+/**
+ * Message buffers that clients have released, waiting to be reclaimed into the
+ * free buffer pool of the current MulticastGroup. It is shared by successive
+ * MulticastGroups so that releasing a buffer never needs a subgroup's state
+ * lock or the view lock, and can therefore be done from inside a delivery
+ * callback.
+ */
+struct ReleasedBufferQueue {
+    std::mutex mtx;
+    std::map<subgroup_id_t, std::vector<MessageBuffer>> buffers;
+};
+
+/**
+ * The lock on the message state of one subgroup of a MulticastGroup. The
+ * subgroup's predicate triggers share ownership of it, so that a trigger a
+ * predicate thread picked up just before the group was wedged can still take
+ * the lock and find the group wedged, without touching the group itself.
+ */
+struct SubgroupStateLock {
+    std::mutex mtx;
+    /** Set, with mtx held, when the group is wedged. */
+    bool wedged = false;
+};
+
+/**
+ * A raw message delivered through CallbackSet::owned_stability_callback. The
+ * client owns the buffer the message was received into until it calls
+ * release() or destroys this object; the buffer then goes back to the
+ * subgroup's pool. This is a move-only type.
+ */
+class OwnedMessage {
+    subgroup_id_t subgroup_num;
+    MessageBuffer message_buffer;
+    std::weak_ptr<ReleasedBufferQueue> release_queue;
+    char* payload;
+    long long int payload_size;
+
+public:
+    OwnedMessage(subgroup_id_t subgroup_num, MessageBuffer&& message_buffer,
+                 uint32_t header_size, long long int payload_size,
+                 std::weak_ptr<ReleasedBufferQueue> release_queue);
+    OwnedMessage(const OwnedMessage&) = delete;
+    OwnedMessage(OwnedMessage&& other);
+    OwnedMessage& operator=(const OwnedMessage&) = delete;
+    OwnedMessage& operator=(OwnedMessage&& other);
+    ~OwnedMessage() { release(); }
+
+    /** @return a pointer to the message payload, or nullptr once released. */
+    char* data() const { return payload; }
+    /** @return the size of the message payload in bytes. */
+    long long int size() const { return payload_size; }
+    /** Gives the message buffer back to Derecho. The payload must not be used afterwards. */
+    void release();
+};
+
 struct RDMCMessage {
     /** The unique node ID of the message's sender. */
     uint32_t sender_id;
@@ -129,6 +295,22 @@ struct SSTMessage {
     volatile char* buf;
 };
 
+/**
+ * Tracks the acknowledgements a receiver has not yet put for one subgroup,
+ * when acknowledgements are coalesced (see DerechoParams::ack_hold_us).
+ */
+struct AckState {
+    /** Messages received through SST since acknowledgements were last put */
+    uint32_t unacked_messages = 0;
+    /** When the oldest unacknowledged message was received, in nanoseconds; 0 if none */
+    uint64_t oldest_unacked_time = 0;
+    /** num_received_sst for each sender when acknowledgements were last put */
+    std::vector<int32_t> last_acked_num_received;
+    /** Total messages received through SST, and total acknowledgement flushes */
+    uint64_t messages_received = 0;
+    uint64_t ack_flushes = 0;
+};
+
 /**
  * A collection of settings for a single subgroup that this node is a member of.
  * Mostly extracted from SubView, but tailored specifically to what MulticastGroup
@@ -178,7 +360,19 @@ public:  //consts can be public, right?
     /** Send algorithm for constructing a multicast from point-to-point unicast.
      *  Binomial pipeline by default. */
     const rdmc::send_algorithm type;
+    /** The number of messages each sender may have outstanding, at most;
+     * SST slots and message buffers are provisioned for this many. */
     const unsigned int window_size;
+    /** The smallest window an adaptive sender window may shrink to. */
+    const unsigned int min_window_size;
+    /** How far, in a sender's messages, persistence may trail delivery in
+     * ordered mode; 0 means it is bounded by the send window instead. */
+    const unsigned int max_persistence_lag;
+    /** How long, and for how many messages, acknowledgements may be held. */
+    const unsigned int ack_hold_us;
+    const unsigned int ack_hold_messages;
+    /** The SST threshold requested in DerechoParams; negative means "use the cost model". */
+    const long long int configured_sst_threshold;
 
 private:
     /** Message-delivery event callbacks, supplied by the client, for "raw" sends */
@@ -195,12 +389,18 @@ private:
     /** These two callbacks are internal, not exposed to clients, so they're not in CallbackSet */
     rpc_handler_t rpc_callback;
 
-    /** Offset to add to member ranks to form RDMC group numbers. */
-    uint16_t rdmc_group_num_offset;
+    /** The RDMC context of this node, whose connections, groups and RDMA
+     * device the RDMC groups and message buffers use. */
+    const std::shared_ptr<rdma::transport_context> rdmc_context;
+    /** The port RDMC connects to the members on. */
+    const uint32_t rdmc_port;
+    /** The numbers of the RDMC groups this MulticastGroup created. They are
+     * unique in the context, so that other Derecho groups can share RDMC. */
+    std::vector<uint16_t> rdmc_group_numbers;
     /** false if RDMC groups haven't been created successfully */
     bool rdmc_sst_groups_created = false;
     /** Stores message buffers not currently in use. Protected by
-     * msg_state_mtx */
+     * the subgroup's state lock */
     std::map<uint32_t, std::vector<MessageBuffer>> free_message_buffers;
 
     /** Index to be used the next time get_sendbuffer_ptr is called.
@@ -211,14 +411,16 @@ private:
      * It is boost::none when there is no message to send. */
     std::vector<std::experimental::optional<RDMCMessage>> next_sends;
     std::map<uint32_t, bool> pending_sst_sends;
+    /** The index of the message whose SST slot was last handed out by get_sendbuffer_ptr. */
+    std::map<uint32_t, message_id_t> next_sst_send_indices;
     /** Messages that are ready to be sent, but must wait until the current send finishes. */
     std::vector<std::queue<RDMCMessage>> pending_sends;
     /** Vector of messages that are currently being sent out using RDMC, or boost::none otherwise. */
     /** one per subgroup */
     std::vector<std::experimental::optional<RDMCMessage>> current_sends;
 
-    /** Messages that are currently being received. */
-    std::map<std::pair<subgroup_id_t, message_id_t>, RDMCMessage> current_receives;
+    /** Messages that are currently being received, by subgroup and then sequence number. */
+    std::map<subgroup_id_t, std::map<message_id_t, RDMCMessage>> current_receives;
 
     /** Messages that have finished sending/receiving but aren't yet globally stable.
      * Organized by [subgroup number] -> [sequence number] -> [message] */
@@ -233,7 +435,28 @@ private:
     std::map<subgroup_id_t, std::map<message_id_t, SSTMessage>> non_persistent_sst_messages;
 
     std::vector<message_id_t> next_message_to_deliver;
-    std::mutex msg_state_mtx;
+    /** For each subgroup, the last sequence number handed to local_receipt_callback. */
+    std::vector<message_id_t> optimistic_seq_nums;
+    /** Completion handles of this node's ordered messages, by subgroup and then in
+     * the order the messages will pass their next milestone: by sequence number
+     * until they are delivered, and by version after. */
+    std::map<subgroup_id_t, std::map<message_id_t, std::shared_ptr<CompletionState>>> unstable_completions;
+    std::map<subgroup_id_t, std::map<message_id_t, std::shared_ptr<CompletionState>>> undelivered_completions;
+    std::map<subgroup_id_t, std::map<persistent::version_t, std::shared_ptr<CompletionState>>> unpersisted_completions;
+    /**
+     * The state lock of each subgroup, indexed by subgroup ID. A subgroup's
+     * lock guards its entries in the maps and vectors above, which all exist
+     * from construction on so that no subgroup changes the maps themselves;
+     * triggers and RDMC callbacks of different subgroups never contend, and
+     * deliver to the client concurrently. Lock order: the view lock, then
+     * subgroup state locks in increasing subgroup ID, then sender_mtx.
+     */
+    std::vector<std::shared_ptr<SubgroupStateLock>> msg_state_locks;
+    /** Counts the calls to wake_sender(), so that the sender thread can tell
+     * whether it missed one while it looked for a message to send. Protected
+     * by sender_mtx. */
+    uint64_t sender_wakeups = 0;
+    std::mutex sender_mtx;
     std::condition_variable sender_cv;
 
     /** The time, in milliseconds, that a sender can wait to send a message before it is considered failed. */
@@ -261,13 +484,47 @@ private:
 
     std::vector<bool> last_transfer_medium;
 
+    /** Estimates of the RDMA costs on this node, calibrated when the first
+     * view is installed and carried over to later views. */
+    TransferCostModel transfer_cost_model;
+    /** For each subgroup, the largest message (including the header) that
+     * is sent through SST slots rather than RDMC. */
+    std::vector<long long unsigned int> sst_thresholds;
+    /** Acknowledgements not yet put, for each subgroup. Only used with
+     * the subgroup's state lock held. */
+    std::map<subgroup_id_t, AckState> ack_states;
+    /** The flow-control window of each subgroup this node sends in. */
+    std::map<subgroup_id_t, AdaptiveWindow> sender_windows;
+
     /** persistence manager callbacks */
     persistence_manager_callbacks_t persistence_manager_callbacks;
 
+    /** Buffers given back by the client after an owned delivery. Reclaimed
+     * into free_message_buffers while holding the subgroup's state lock. */
+    std::shared_ptr<ReleasedBufferQueue> released_buffers;
+
     /** Continuously waits for a new pending send, then sends it. This function
      * implements the sender thread. */
     void send_loop();
+    /** Wakes the sender thread to look for a message it can send. */
+    void wake_sender();
+    /** Creates the subgroup's entries in the message state maps. */
+    void create_message_state(subgroup_id_t subgroup_num);
+    /**
+     * Wraps a trigger of the subgroup so that it runs with the subgroup's
+     * state lock held, and does nothing once the group is wedged.
+     */
+    template <typename Trigger>
+    auto locked_trigger(subgroup_id_t subgroup_num, Trigger trigger) {
+        return [state_lock = msg_state_locks[subgroup_num], trigger](DerechoSST& sst) mutable {
+            std::lock_guard<std::mutex> lock(state_lock->mtx);
+            if(!state_lock->wedged) {
+                trigger(sst);
+            }
+        };
+    }
 
+    /** @return the current time in nanoseconds since the epoch, from the TSC clock. */
     uint64_t get_time();
 
     /** Checks for failures when a sender reaches its timeout. This function
@@ -275,6 +532,27 @@ private:
     void check_failures_loop();
 
     bool create_rdmc_sst_groups();
+    /** Measures the latency and bandwidth of RDMA writes to the other members
+     * by timing puts of this node's own SST row, and updates transfer_cost_model. */
+    void calibrate_transfer_cost_model();
+    /** Fills in sst_thresholds for every subgroup this node belongs to. */
+    void compute_sst_thresholds();
+    /** Creates the sender window of every subgroup this node sends in. */
+    void create_sender_windows();
+    /** @return the number of messages this node may currently have outstanding in the subgroup. */
+    unsigned int active_window_size(subgroup_id_t subgroup_num);
+    /**
+     * @return true if every member of the subgroup's shard has persisted
+     * the message with this sequence number (or a later one).
+     */
+    bool shard_persisted_upto(subgroup_id_t subgroup_num, message_id_t seq_num, const DerechoSST& sst);
+    /**
+     * @return the index of this node's latest message in the subgroup that
+     * every shard member has delivered and persisted (or, in unordered mode,
+     * received; with a max_persistence_lag, just delivered); -1 if there is none.
+     */
+    message_id_t compute_retired_index(subgroup_id_t subgroup_num, const SubgroupSettings& curr_subgroup_settings,
+                                       uint32_t num_shard_senders, const DerechoSST& sst);
     void initialize_sst_row();
     void register_predicates();
 
@@ -291,6 +569,26 @@ private:
      * @param subgroup_num The ID of the subgroup this message is in
      */
     void deliver_message(SSTMessage& msg, subgroup_id_t subgroup_num);
+    /**
+     * Delivers a raw (non-RPC) message to the client, handing over ownership of
+     * its buffer if CallbackSet::owned_stability_callback is set. Otherwise the
+     * buffer goes straight back to free_message_buffers.
+     * @param msg A reference to the message to deliver
+     * @param subgroup_num The ID of the subgroup this message is in
+     */
+    void deliver_raw_message(RDMCMessage& msg, subgroup_id_t subgroup_num);
+    /**
+     * Same as the other deliver_raw_message, but for the SSTMessage type. SST
+     * slots are reused by the sender, so an owned delivery copies the message
+     * out of the slot once.
+     */
+    void deliver_raw_message(SSTMessage& msg, subgroup_id_t subgroup_num);
+
+    /** Creates a message buffer for the subgroup, using the client's allocator if it supplied one. */
+    MessageBuffer allocate_message_buffer(subgroup_id_t subgroup_num);
+    /** Moves buffers the client has released back into free_message_buffers.
+     * The caller must hold the subgroup's state lock. */
+    void reclaim_released_buffers(subgroup_id_t subgroup_num);
 
     /**
      * Enqueues a single message for persistence with the persistence manager.
@@ -329,6 +627,42 @@ private:
     void delivery_trigger(subgroup_id_t subgroup_num, const SubgroupSettings& curr_subgroup_settings,
                           const uint32_t num_shard_members, DerechoSST& sst);
 
+    /**
+     * Delivery for FIFO_STABLE subgroups: delivers each sender's messages in
+     * order up to the lowest num_received for that sender among the shard
+     * members, independently of the other senders.
+     */
+    void fifo_delivery_trigger(subgroup_id_t subgroup_num, const SubgroupSettings& curr_subgroup_settings,
+                               uint32_t num_shard_senders, DerechoSST& sst);
+
+    /** Hands the locally received messages up to seq_num to local_receipt_callback,
+     * in order. The caller must hold the subgroup's state lock. */
+    void deliver_optimistically(subgroup_id_t subgroup_num, message_id_t seq_num);
+    /** Calls local_receipt_rollback_callback for the messages given to
+     * local_receipt_callback that are still undelivered. The caller must
+     * hold the subgroup's state lock. */
+    void roll_back_optimistic_deliveries(subgroup_id_t subgroup_num);
+
+    /** Queues a completion handle for this node's message with this index.
+     * The caller must hold the subgroup's state lock. */
+    void track_completion(subgroup_id_t subgroup_num, message_id_t index, std::shared_ptr<CompletionState> completion);
+    /** Advances the completion handles of messages up to each frontier to the
+     * corresponding milestone. The caller must hold the subgroup's state lock. */
+    void complete_stable(subgroup_id_t subgroup_num, message_id_t min_stable_num);
+    void complete_delivered(subgroup_id_t subgroup_num, message_id_t delivered_num);
+    void complete_persisted(subgroup_id_t subgroup_num, persistent::version_t min_persisted_num);
+    /** Takes over the completion handles of a previous view's group, following
+     * its messages to the indices they are re-sent with here and abandoning the
+     * handles of messages that will not be. Handles of messages the old
+     * group's shard had already persisted are completed there. The caller
+     * must hold old_group's state locks. */
+    void adopt_completions(MulticastGroup& old_group,
+                           const std::map<std::pair<subgroup_id_t, message_id_t>, message_id_t>& new_indices);
+
+    /** Delivers and discards the locally stable message with this sequence number, if there is one.
+     * The caller must hold the subgroup's state lock. */
+    void deliver_unversioned_message(subgroup_id_t subgroup_num, message_id_t seq_num);
+
     void sst_receive_handler(subgroup_id_t subgroup_num, const SubgroupSettings& curr_subgroup_settings,
                              const std::map<uint32_t, uint32_t>& shard_ranks_by_sender_rank,
                              uint32_t num_shard_senders, uint32_t sender_rank,
@@ -338,6 +672,14 @@ private:
                             const std::map<uint32_t, uint32_t>& shard_ranks_by_sender_rank,
                             uint32_t num_shard_senders, const DerechoSST& sst);
 
+    /** @return how far the member in the row has got with the messages of a
+     * sender: the index of the last one it delivered, in FIFO_STABLE mode, or
+     * received, otherwise. */
+    static int32_t sender_progress(const DerechoSST& sst, Mode mode, uint32_t row, uint32_t num_received_entry);
+
+    /** @return true if acknowledgements are held for the subgroup and the oldest has been held for ack_hold_us. */
+    bool ack_flush_due(subgroup_id_t subgroup_num);
+
     void receiver_function(subgroup_id_t subgroup_num, const SubgroupSettings& curr_subgroup_settings,
                            const std::map<uint32_t, uint32_t>& shard_ranks_by_sender_rank,
                            uint32_t num_shard_senders, DerechoSST& sst, unsigned int batch_size,
@@ -379,13 +721,24 @@ public:
                              bool cooked_send = false, bool null_send = false);
     /** Note that get_sendbuffer_ptr and send are called one after the another - regexp for using the two is (get_sendbuffer_ptr.send)*
      * This still allows making multiple send calls without acknowledgement; at a single point in time, however,
-     * there is only one message per sender in the RDMC pipeline */
-    bool send(subgroup_id_t subgroup_num);
+     * there is only one message per sender in the RDMC pipeline.
+     * If a completion is given, it follows the message through its milestones; outside ordered mode
+     * the message is sent but the completion is abandoned at once. */
+    bool send(subgroup_id_t subgroup_num, std::shared_ptr<CompletionState> completion = nullptr);
     bool check_pending_sst_sends(subgroup_id_t subgroup_num);
 
     const uint64_t compute_global_stability_frontier(subgroup_id_t subgroup_num);
 
-    /** Stops all sending and receiving in this group, in preparation for shutting it down. */
+    /** @return the number of acknowledgement puts per message received through SST in the subgroup. */
+    double get_acks_per_message(subgroup_id_t subgroup_num);
+
+    /**
+     * Stops all sending and receiving in this group, in preparation for
+     * shutting it down. It waits for the subgroups' triggers that are running
+     * to finish, but not for the predicate threads, so it can be called from
+     * any trigger and with the view lock held. It must not be called with a
+     * subgroup's state lock held, as from a delivery callback.
+     */
     void wedge();
     /** Debugging function; prints the current state of the SST to stdout. */
     void debug_print();
@@ -9,11 +9,13 @@
 #include <atomic>
 #include <chrono>
 #include <errno.h>
+#include <mutex>
 #include <queue>
 #include <semaphore.h>
 #include <thread>
 
 #include "derecho_internal.h"
+#include "placement.h"
 #include "replicated.h"
 
 #include "mutils-containers/KindMap.hpp"
@@ -43,6 +45,8 @@ private:
     sem_t persistence_request_sem;
     /** a queue for the requests */
     std::queue<persistence_request_t> persistence_request_queue;
+    /** Guards persistence_request_queue; subgroups post requests from their own predicate threads. */
+    std::mutex persistence_request_queue_mutex;
 
     /** persistence callback */
     persistence_callback_t persistence_callback;
@@ -51,6 +55,12 @@ private:
     /** View Manager pointer. Need to access the SST for the purpose of updating persisted_num*/
     ViewManager *view_manager;
 
+    /** @return true if there are persistence requests still queued */
+    bool has_persistence_requests() {
+        std::lock_guard<std::mutex> lock(persistence_request_queue_mutex);
+        return !persistence_request_queue.empty();
+    }
+
 public:
     /** Constructor
      * @param pro pointer to the replicated_objects.
@@ -106,10 +116,13 @@ public:
         // if(replicated_objects == nullptr) return;
 
         this->persist_thread = std::thread{[this]() {
+            pthread_setname_np(pthread_self(), "persist_thread");
+            pin_thread(ThreadRole::PERSIST);
             std::cout << "The persist thread started" << std::endl;
             do {
                 // wait for semaphore
                 sem_wait(&persistence_request_sem);
+                std::unique_lock<std::mutex> queue_lock(persistence_request_queue_mutex);
                 if(this->persistence_request_queue.empty()) {
                     continue;
                 }
@@ -117,6 +130,7 @@ public:
                 subgroup_id_t subgroup_id = std::get<0>(persistence_request_queue.front());
                 persistent::version_t version = std::get<1>(persistence_request_queue.front());
                 persistence_request_queue.pop();
+                queue_lock.unlock();
 
                 // persist
 
@@ -146,7 +160,7 @@ public:
                     this->persistence_callback(subgroup_id, version);
                 }
 
-            } while(!this->thread_shutdown || !this->persistence_request_queue.empty());
+            } while(!this->thread_shutdown || has_persistence_requests());
             std::cout << "The persist thread is exiting" << std::endl;
         }};
     }
@@ -154,7 +168,10 @@ public:
     /** post a persistence request */
     void post_persist_request(const subgroup_id_t &subgroup_id, const persistent::version_t &version) {
         // request enqueue
-        persistence_request_queue.push(std::make_tuple(subgroup_id, version));
+        {
+            std::lock_guard<std::mutex> lock(persistence_request_queue_mutex);
+            persistence_request_queue.push(std::make_tuple(subgroup_id, version));
+        }
         // post semaphore
         sem_post(&persistence_request_sem);
     }
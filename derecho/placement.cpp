@@ -0,0 +1,363 @@
+#include "placement.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace derecho {
+
+// Memory policy constants from <numaif.h>, which would add a libnuma dependency
+constexpr int mpol_preferred = 1;
+
+/** How many pages get_placement_report asks the kernel about at a time. */
+constexpr std::size_t pages_per_query = 1024;
+
+static const char* const role_names[num_thread_roles]
+        = {"sst_detect", "sst_poll", "rdmc_poll", "sender", "timeout", "rpc", "persist"};
+
+/** A mapping made by allocate_registered_memory. */
+struct RegisteredMemory {
+    std::size_t length;
+    /** The size of the pages backing it, huge or not. */
+    std::size_t page_size;
+};
+
+static std::mutex placement_mutex;
+static bool policy_set = false;
+static PlacementPolicy current_policy;
+static std::array<std::map<int, uint32_t>, num_thread_roles> threads_per_node;
+static std::map<char*, RegisteredMemory> registered_memory;
+
+/** Removes a pinned thread from threads_per_node when it exits. */
+struct PinnedThread {
+    int role = -1;
+    int node = -1;
+    ~PinnedThread() {
+        if(role < 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(placement_mutex);
+        if(--threads_per_node[role][node] == 0) {
+            threads_per_node[role].erase(node);
+        }
+    }
+};
+static thread_local PinnedThread pinned_thread;
+
+/** Parses a list of cores such as "0-3,8,10-11". */
+static std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    std::size_t start = 0;
+    while(start < list.size()) {
+        std::size_t end = list.find(',', start);
+        if(end == std::string::npos) {
+            end = list.size();
+        }
+        const std::string range = list.substr(start, end - start);
+        const std::size_t dash = range.find('-');
+        if(!range.empty()) {
+            const int first = std::atoi(range.c_str());
+            const int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+            for(int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        start = end + 1;
+    }
+    return cpus;
+}
+
+/** @return the NUMA node of the core, or -1 if the system does not report it. */
+static int node_of_cpu(int cpu) {
+    static std::once_flag nodes_read;
+    static std::vector<int> cpu_nodes;
+    std::call_once(nodes_read, []() {
+        DIR* dir = opendir("/sys/devices/system/node");
+        if(!dir) {
+            return;
+        }
+        while(dirent* entry = readdir(dir)) {
+            const std::string name = entry->d_name;
+            if(name.compare(0, 4, "node") != 0 || name.size() == 4
+               || name.find_first_not_of("0123456789", 4) != std::string::npos) {
+                continue;
+            }
+            const int node = std::atoi(name.c_str() + 4);
+            std::ifstream cpulist("/sys/devices/system/node/" + name + "/cpulist");
+            std::string list;
+            std::getline(cpulist, list);
+            for(int node_cpu : parse_cpu_list(list)) {
+                if(node_cpu >= (int)cpu_nodes.size()) {
+                    cpu_nodes.resize(node_cpu + 1, -1);
+                }
+                cpu_nodes[node_cpu] = node;
+            }
+        }
+        closedir(dir);
+    });
+    return cpu >= 0 && cpu < (int)cpu_nodes.size() ? cpu_nodes[cpu] : -1;
+}
+
+/**
+ * @return the NUMA node of the RDMA device named by RDMC_DEVICE_NAME, or of
+ * the first device if it is not set; -1 if it is unknown.
+ */
+static int read_nic_numa_node() {
+    std::string device;
+    if(const char* name = std::getenv("RDMC_DEVICE_NAME")) {
+        device = name;
+    } else if(DIR* dir = opendir("/sys/class/infiniband")) {
+        while(dirent* entry = readdir(dir)) {
+            const std::string name = entry->d_name;
+            if(name[0] != '.' && (device.empty() || name < device)) {
+                device = name;
+            }
+        }
+        closedir(dir);
+    }
+    int node = -1;
+    if(!device.empty()) {
+        std::ifstream numa_node("/sys/class/infiniband/" + device + "/device/numa_node");
+        numa_node >> node;
+    }
+    return node;
+}
+
+static int get_nic_numa_node() {
+    static const int node = read_nic_numa_node();
+    return node;
+}
+
+/**
+ * @return the size of the huge pages MAP_HUGETLB maps by default, from the
+ * Hugepagesize line of /proc/meminfo, or 0 if it is not reported.
+ */
+static std::size_t read_huge_page_size() {
+    std::ifstream meminfo("/proc/meminfo");
+    std::string line;
+    while(std::getline(meminfo, line)) {
+        if(line.compare(0, 13, "Hugepagesize:") == 0) {
+            // The size is given in kB
+            return std::strtoull(line.c_str() + 13, nullptr, 10) * 1024;
+        }
+    }
+    return 0;
+}
+
+static std::size_t get_huge_page_size() {
+    static const std::size_t size = read_huge_page_size();
+    return size;
+}
+
+/**
+ * Adds the bytes of each page of a mapping to the node it is on, or to -1 if
+ * it has not been touched yet or its node could not be determined.
+ */
+static void add_bytes_per_node(char* memory, const RegisteredMemory& mapping,
+                               std::map<int, std::size_t>& registered_bytes) {
+    const std::size_t num_pages = mapping.length / mapping.page_size;
+    std::vector<void*> pages;
+    std::vector<int> status;
+    for(std::size_t first = 0; first < num_pages; first += pages_per_query) {
+        const std::size_t count = std::min(pages_per_query, num_pages - first);
+        pages.resize(count);
+        status.assign(count, -1);
+        for(std::size_t page = 0; page < count; ++page) {
+            pages[page] = memory + (first + page) * mapping.page_size;
+        }
+        // Without a target node list, move_pages only reports where each page is
+        if(syscall(SYS_move_pages, 0, count, pages.data(), nullptr, status.data(), 0) != 0) {
+            status.assign(count, -1);
+        }
+        for(int node : status) {
+            registered_bytes[node >= 0 ? node : -1] += mapping.page_size;
+        }
+    }
+}
+
+static PlacementPolicy get_policy_locked() {
+    if(!policy_set) {
+        current_policy = PlacementPolicy::from_environment();
+        policy_set = true;
+    }
+    return current_policy;
+}
+
+PlacementPolicy PlacementPolicy::from_environment() {
+    PlacementPolicy policy;
+    for(int role = 0; role < num_thread_roles; ++role) {
+        std::string variable = std::string("DERECHO_CORES_") + role_names[role];
+        std::transform(variable.begin(), variable.end(), variable.begin(), ::toupper);
+        if(const char* cores = std::getenv(variable.c_str())) {
+            policy.cores[role] = parse_cpu_list(cores);
+        }
+    }
+    if(const char* node = std::getenv("DERECHO_NUMA_NODE")) {
+        policy.numa_node = std::string(node) == "nic" ? nic_numa_node : std::atoi(node);
+    }
+    if(const char* huge_pages = std::getenv("DERECHO_HUGE_PAGES")) {
+        policy.huge_pages = std::atoi(huge_pages) != 0;
+    }
+    return policy;
+}
+
+void set_placement_policy(const PlacementPolicy& policy) {
+    std::lock_guard<std::mutex> lock(placement_mutex);
+    current_policy = policy;
+    policy_set = true;
+}
+
+PlacementPolicy get_placement_policy() {
+    std::lock_guard<std::mutex> lock(placement_mutex);
+    return get_policy_locked();
+}
+
+void pin_thread(ThreadRole role) {
+    const int role_index = static_cast<int>(role);
+    const std::vector<int> cores = get_placement_policy().cores[role_index];
+    if(!cores.empty()) {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        for(int core : cores) {
+            CPU_SET(core, &cpu_set);
+        }
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+        if(rc) {
+            std::cerr << "Could not pin the " << role_names[role_index] << " thread, error code is " << rc << std::endl;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(placement_mutex);
+    if(pinned_thread.role >= 0 && --threads_per_node[pinned_thread.role][pinned_thread.node] == 0) {
+        threads_per_node[pinned_thread.role].erase(pinned_thread.node);
+    }
+    pinned_thread.role = role_index;
+    pinned_thread.node = node_of_cpu(sched_getcpu());
+    ++threads_per_node[role_index][pinned_thread.node];
+}
+
+char* allocate_registered_memory(std::size_t size) {
+    const PlacementPolicy policy = get_placement_policy();
+    const std::size_t page_size = sysconf(_SC_PAGESIZE);
+    size = std::max<std::size_t>(size, 1);
+
+    std::size_t length = 0;
+    std::size_t mapped_page_size = page_size;
+    void* memory = MAP_FAILED;
+    const std::size_t huge_page_size = get_huge_page_size();
+    if(policy.huge_pages && huge_page_size) {
+        // MAP_HUGETLB uses the default huge page size, which munmap needs the length to be a multiple of
+        length = (size + huge_page_size - 1) / huge_page_size * huge_page_size;
+        mapped_page_size = huge_page_size;
+        memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    if(memory == MAP_FAILED) {
+        length = (size + page_size - 1) / page_size * page_size;
+        mapped_page_size = page_size;
+        memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if(memory == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+
+    const int node = policy.numa_node == nic_numa_node ? get_nic_numa_node() : policy.numa_node;
+    if(node >= 0) {
+        // Preferred rather than bound, so a full node falls back to another
+        // instead of failing the allocation; the report shows where it went
+        const std::size_t bits = 8 * sizeof(unsigned long);
+        std::vector<unsigned long> node_mask(node / bits + 1, 0);
+        node_mask[node / bits] |= 1UL << (node % bits);
+        if(syscall(SYS_mbind, memory, length, mpol_preferred, node_mask.data(), node_mask.size() * bits + 1, 0) != 0) {
+            std::cerr << "Could not bind registered memory to NUMA node " << node << ", error code is " << errno << std::endl;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(placement_mutex);
+    registered_memory[static_cast<char*>(memory)] = RegisteredMemory{length, mapped_page_size};
+    return static_cast<char*>(memory);
+}
+
+void free_registered_memory(char* memory) {
+    std::size_t length;
+    {
+        std::lock_guard<std::mutex> lock(placement_mutex);
+        auto it = registered_memory.find(memory);
+        if(it == registered_memory.end()) {
+            return;
+        }
+        length = it->second.length;
+        registered_memory.erase(it);
+    }
+    munmap(memory, length);
+}
+
+PlacementReport get_placement_report() {
+    PlacementReport report;
+    report.nic_numa_node = get_nic_numa_node();
+    report.remote_threads = 0;
+    report.remote_bytes = 0;
+
+    std::lock_guard<std::mutex> lock(placement_mutex);
+    report.threads_per_node = threads_per_node;
+    // Pages are placed when they are first touched, and may be migrated, so
+    // each one is looked up now
+    for(const auto& address_memory : registered_memory) {
+        add_bytes_per_node(address_memory.first, address_memory.second, report.registered_bytes);
+    }
+    if(report.nic_numa_node >= 0) {
+        for(const auto& role_threads : report.threads_per_node) {
+            for(const auto& node_count : role_threads) {
+                if(node_count.first >= 0 && node_count.first != report.nic_numa_node) {
+                    report.remote_threads += node_count.second;
+                }
+            }
+        }
+        for(const auto& node_bytes : report.registered_bytes) {
+            if(node_bytes.first >= 0 && node_bytes.first != report.nic_numa_node) {
+                report.remote_bytes += node_bytes.second;
+            }
+        }
+    }
+    return report;
+}
+
+std::ostream& operator<<(std::ostream& out, const PlacementReport& report) {
+    out << "RDMA device NUMA node: ";
+    if(report.nic_numa_node >= 0) {
+        out << report.nic_numa_node << std::endl;
+    } else {
+        out << "unknown" << std::endl;
+    }
+    for(int role = 0; role < num_thread_roles; ++role) {
+        if(report.threads_per_node[role].empty()) {
+            continue;
+        }
+        out << role_names[role] << " threads per node:";
+        for(const auto& node_count : report.threads_per_node[role]) {
+            out << " " << node_count.first << ":" << node_count.second;
+        }
+        out << std::endl;
+    }
+    out << "Registered bytes per node:";
+    for(const auto& node_bytes : report.registered_bytes) {
+        out << " " << node_bytes.first << ":" << node_bytes.second;
+    }
+    out << std::endl;
+    out << "Across sockets from the RDMA device: " << report.remote_threads << " threads, "
+        << report.remote_bytes << " registered bytes" << std::endl;
+    return out;
+}
+
+}  // namespace derecho
@@ -0,0 +1,96 @@
+/**
+ * @file placement.h
+ *
+ * Where Derecho's threads run and where the memory it registers with the RDMA
+ * device lives. By default neither is controlled; a PlacementPolicy pins each
+ * kind of thread to a set of cores and binds registered memory to a NUMA
+ * node, typically the one the RDMA device is attached to.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <vector>
+
+namespace derecho {
+
+/** The threads Derecho starts, each of which can be given its own cores. */
+enum class ThreadRole {
+    SST_DETECT = 0,
+    SST_POLL = 1,
+    RDMC_POLL = 2,
+    SENDER = 3,
+    TIMEOUT = 4,
+    RPC = 5,
+    PERSIST = 6
+};
+
+constexpr int num_thread_roles = 7;
+
+/** A PlacementPolicy::numa_node meaning the node the RDMA device is attached to. */
+constexpr int nic_numa_node = -2;
+
+struct PlacementPolicy {
+    /** The cores each role's threads may run on, indexed by ThreadRole. An
+     * empty set leaves that role's threads wherever the scheduler puts them. */
+    std::array<std::vector<int>, num_thread_roles> cores;
+    /** The NUMA node registered memory is bound to: a node number,
+     * nic_numa_node, or -1 to leave it on whichever node first touches it. */
+    int numa_node = -1;
+    /** Whether registered memory is backed by huge pages of the system's
+     * default size (Hugepagesize in /proc/meminfo), when it has any to spare;
+     * otherwise it falls back to normal pages. */
+    bool huge_pages = false;
+
+    /**
+     * Reads a policy from the environment: DERECHO_CORES_<ROLE> for each role
+     * (e.g. DERECHO_CORES_SST_POLL=2 or DERECHO_CORES_SST_DETECT=4-7,12),
+     * DERECHO_NUMA_NODE (a node number, or "nic"), and DERECHO_HUGE_PAGES=1.
+     */
+    static PlacementPolicy from_environment();
+};
+
+/**
+ * Sets the policy for threads started and memory allocated from now on. Until
+ * it is called, the policy is PlacementPolicy::from_environment().
+ */
+void set_placement_policy(const PlacementPolicy& policy);
+PlacementPolicy get_placement_policy();
+
+/** Pins the calling thread to its role's cores, and records where it runs. */
+void pin_thread(ThreadRole role);
+
+/**
+ * Allocates page-aligned memory that will be registered with the RDMA device,
+ * on the policy's NUMA node and, if it asks for them, on huge pages.
+ * @throws std::bad_alloc if no memory could be mapped
+ */
+char* allocate_registered_memory(std::size_t size);
+/** Frees memory from allocate_registered_memory. */
+void free_registered_memory(char* memory);
+
+/** How much of Derecho's work happens on a socket other than the RDMA device's. */
+struct PlacementReport {
+    /** The RDMA device's NUMA node, or -1 if it is unknown. */
+    int nic_numa_node;
+    /** For each role, how many of its running threads started on each NUMA
+     * node; -1 counts threads whose node could not be determined. */
+    std::array<std::map<int, uint32_t>, num_thread_roles> threads_per_node;
+    /** Bytes of registered memory currently allocated on each NUMA node,
+     * page by page; -1 collects pages that have not been touched yet or whose
+     * node could not be determined. */
+    std::map<int, std::size_t> registered_bytes;
+    /** Threads that started on, and bytes allocated on, a node other than the
+     * RDMA device's: each of their completions, polls and transfers crosses
+     * the socket interconnect. */
+    uint32_t remote_threads;
+    std::size_t remote_bytes;
+};
+
+PlacementReport get_placement_report();
+std::ostream& operator<<(std::ostream& out, const PlacementReport& report);
+
+}  // namespace derecho
@@ -24,6 +24,16 @@ void RawSubgroup::send() {
     }
 }
 
+MessageCompletion RawSubgroup::send_tracked(MessageMilestone until) {
+    if(is_valid()) {
+        auto completion = std::make_shared<CompletionState>(until);
+        group_view_manager.send(subgroup_id, completion);
+        return MessageCompletion(completion);
+    } else {
+        throw derecho::empty_reference_exception{"Attempted to use an empty RawSubgroup"};
+    }
+}
+
 uint64_t RawSubgroup::compute_global_stability_frontier() {
     if(is_valid()) {
         return group_view_manager.compute_global_stability_frontier(subgroup_id);
@@ -31,4 +41,12 @@ uint64_t RawSubgroup::compute_global_stability_frontier() {
         throw derecho::empty_reference_exception{"Attempted to use an empty RawSubgroup"};
     }
 }
+
+double RawSubgroup::get_acks_per_message() {
+    if(is_valid()) {
+        return group_view_manager.get_acks_per_message(subgroup_id);
+    } else {
+        throw derecho::empty_reference_exception{"Attempted to use an empty RawSubgroup"};
+    }
+}
 }
@@ -8,6 +8,7 @@
 
 #include "derecho_exception.h"
 #include "derecho_internal.h"
+#include "message_completion.h"
 #include "view_manager.h"
 
 namespace derecho {
@@ -49,11 +50,21 @@ public:
      */
     char* get_sendbuffer_ptr(unsigned long long int payload_size, int pause_sending_turns = 0, bool null_send = false);
     uint64_t compute_global_stability_frontier();
+    /** @return the number of acknowledgement puts per message received in this subgroup. */
+    double get_acks_per_message();
 
     /**
      * Submits the contents of the send buffer to be sent on the next ordered
      * multicast to the subgroup.
      */
     void send();
+
+    /**
+     * Like send(), but returns a handle that the caller can wait on for the
+     * message to reach each milestone up to until. Only messages in
+     * ordered-mode subgroups can be tracked; in other modes the handle is
+     * abandoned at once.
+     */
+    MessageCompletion send_tracked(MessageMilestone until = MessageMilestone::PERSISTED);
 };
 }
@@ -74,6 +74,28 @@ struct RemoteInvoker<Tag, std::function<Ret(Args...)>> {
         return serialize_one(v, args...);
     }
 
+    /**
+     * Writes the invocation ID and the arguments of a call into a buffer
+     * allocated by out_alloc.
+     * @param size Set to the number of bytes written
+     * @return The buffer
+     */
+    char* serialize_invocation(const std::function<char*(int)>& out_alloc, long int invocation_id,
+                               std::size_t& size, const std::decay_t<Args>&... remote_args) {
+        size = mutils::bytes_size(invocation_id);
+        {
+            auto t = {std::size_t{0}, std::size_t{0}, mutils::bytes_size(remote_args)...};
+            size += std::accumulate(t.begin(), t.end(), 0);
+        }
+        char* serialized_args = out_alloc(size);
+        {
+            auto v = serialized_args + mutils::to_bytes(invocation_id, serialized_args);
+            auto check_size = mutils::bytes_size(invocation_id) + serialize_all(v, remote_args...);
+            assert(check_size == size);
+        }
+        return serialized_args;
+    }
+
     /**
      * Return type for the send function. Contains the RPC-invoking message
      * (in a buffer of size "size"), a set of futures for the results, and
@@ -96,17 +118,8 @@ struct RemoteInvoker<Tag, std::function<Ret(Args...)>> {
     send_return send(const std::function<char*(int)>& out_alloc,
                      const std::decay_t<Args>&... remote_args) {
         auto invocation_id = mutils::long_rand();
-        std::size_t size = mutils::bytes_size(invocation_id);
-        {
-            auto t = {std::size_t{0}, std::size_t{0}, mutils::bytes_size(remote_args)...};
-            size += std::accumulate(t.begin(), t.end(), 0);
-        }
-        char* serialized_args = out_alloc(size);
-        {
-            auto v = serialized_args + mutils::to_bytes(invocation_id, serialized_args);
-            auto check_size = mutils::bytes_size(invocation_id) + serialize_all(v, remote_args...);
-            assert(check_size == size);
-        }
+        std::size_t size;
+        char* serialized_args = serialize_invocation(out_alloc, invocation_id, size, remote_args...);
 
         lock_t l{map_lock};
         // default-initialize the maps
@@ -116,6 +129,21 @@ struct RemoteInvoker<Tag, std::function<Ret(Args...)>> {
                            pending_results};
     }
 
+    /**
+     * Constructs an RPC message like send(), but without setting up anywhere
+     * for replies to go. Only meant for functions that return void, which
+     * are never replied to.
+     * @param out_alloc A function that can allocate buffers, which will be
+     * used to store the constructed message
+     * @return The size of the message
+     */
+    std::size_t serialize(const std::function<char*(int)>& out_alloc,
+                          const std::decay_t<Args>&... remote_args) {
+        std::size_t size;
+        serialize_invocation(out_alloc, mutils::long_rand(), size, remote_args...);
+        return size;
+    }
+
     /**
      * Specialization of receive_response for non-void functions. Stores the
      * response in the results map, or stores the exception if there was an
@@ -561,6 +589,35 @@ public:
                            sent_return.pending};
     }
 
+    /**
+     * Constructs a message that will remotely invoke a method of this class,
+     * like send(), but for a method that returns void and without keeping
+     * any state for the call. Used to put many calls into one multicast.
+     * @param out_alloc A function that can allocate a buffer for the message
+     * @param args The arguments that should be given to the method when
+     * invoking it
+     * @return The size of the message, including its header
+     */
+    template <FunctionTag Tag, typename... Args>
+    std::size_t serialize(const std::function<char*(int)>& out_alloc, Args&&... args) {
+        using namespace remote_invocation_utilities;
+
+        constexpr std::integral_constant<FunctionTag, Tag>* choice{nullptr};
+        auto& invoker = this->get_invoker(choice, args...);
+        static_assert(std::is_same<typename std::decay_t<decltype(invoker)>::remote_function_type::result_type, void>::value,
+                      "Only RPC functions that return void can be batched");
+        const auto header_size = header_space();
+        char* buf = nullptr;
+        std::size_t payload_size = invoker.serialize(
+                [&out_alloc, &header_size, &buf](std::size_t size) {
+                    buf = out_alloc(size + header_size);
+                    return buf + header_size;
+                },
+                std::forward<Args>(args)...);
+        populate_header(buf, payload_size, invoker.invoke_opcode, nid);
+        return payload_size + header_size;
+    }
+
     using specialized_to = IdentifyingClass;
     RemoteInvocableClass& for_class(IdentifyingClass*) {
         return *this;
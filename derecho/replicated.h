@@ -6,11 +6,17 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "mutils-serialization/SerializationSupport.hpp"
 #include "persistent/Persistent.hpp"
@@ -18,6 +24,7 @@
 
 #include "derecho_exception.h"
 #include "derecho_internal.h"
+#include "message_completion.h"
 #include "remote_invocable.h"
 #include "rpc_manager.h"
 #include "rpc_utils.h"
@@ -47,9 +54,27 @@ public:
     virtual void persist(const persistent::version_t version) noexcept(false) = 0;
 };
 
+/**
+ * State shared between a Replicated<T> and the handler for the batch messages
+ * of its subgroup, which tells make_version() whether the message being
+ * delivered is a batch whose version should be skipped.
+ */
+struct DeferredVersioning {
+    /** Set by the batch handler for a deferred batch; cleared by the make_version() after it. */
+    bool defer_next_version = false;
+    /** True while the object has updates from deferred batches that no version includes yet. */
+    std::atomic<bool> has_unversioned_updates{false};
+    /** The results of every batch message, which is never replied to. */
+    rpc::PendingResults<void> batch_pending;
+};
+
+template <typename T>
+class BulkIngestSession;
+
 template <typename T>
 class Replicated : public ReplicatedObject, public ITemporalQueryFrontierProvider {
 private:
+    friend class BulkIngestSession<T>;
     /** persistent registry for persistent<t>
      */
     std::unique_ptr<PersistentRegistry> persistent_registry_ptr;
@@ -78,9 +103,100 @@ private:
     /** Buffer for replying to P2P messages, cached here so it doesn't need to be
      * created in every p2p_send call. */
     std::unique_ptr<char[]> p2pSendBuffer;
+    /** The latest version in the logs of this object's Persistent fields,
+     * i.e. of the last message delivered at this node, or loaded from disk or
+     * received with the object's state; -1 if none. Set by the delivery
+     * thread once the version's log entries exist, read by snapshot readers. */
+    std::atomic<persistent::version_t> latest_local_version;
+    /** Shared with this subgroup's batch handler, which outlives a moved-from Replicated. */
+    std::shared_ptr<DeferredVersioning> deferred_versioning;
+
+    /**
+     * Sets latest_local_version to the latest version in the logs of this
+     * object's Persistent fields, for when they got versions other than
+     * through make_version: loaded from disk, or received in a state transfer.
+     */
+    void reset_latest_local_version() {
+        latest_local_version.store(persistent_registry_ptr->getMinimumLatestPersistedVersion(),
+                                   std::memory_order_release);
+    }
+
+    /**
+     * Registers the handler for the batch messages of this subgroup, which runs
+     * each RPC call in the batch in order, as if it had been its own message.
+     * Replaces the handler of any previous Replicated for the same subgroup.
+     */
+    void register_batch_handler() {
+        rpc::RPCManager* rpc_manager = &group_rpc_manager;
+        std::shared_ptr<DeferredVersioning> deferred = deferred_versioning;
+        (*group_rpc_manager.receivers)[rpc::Opcode{std::type_index(typeid(T)), subgroup_id, rpc::batch_function_tag, false}]
+                = [rpc_manager, deferred](mutils::RemoteDeserialization_v*, const node_id_t&,
+                                          const char* recv_buf, const std::function<char*(int)>&) {
+                      using namespace rpc::remote_invocation_utilities;
+                      const std::size_t num_calls = ((const std::size_t*)recv_buf)[0];
+                      recv_buf += sizeof(std::size_t);
+                      deferred->defer_next_version = ((const bool*)recv_buf)[0];
+                      recv_buf += sizeof(bool);
+                      for(std::size_t i = 0; i < num_calls; ++i) {
+                          const std::size_t call_size = ((const std::size_t*)recv_buf)[0] + header_space();
+                          //Batched functions all return void, so there is never a reply to allocate
+                          rpc_manager->parse_and_receive(const_cast<char*>(recv_buf), call_size,
+                                                         [](std::size_t) -> char* {
+                                                             assert(false);
+                                                             return nullptr;
+                                                         });
+                          recv_buf += call_size;
+                      }
+                      return rpc::recv_ret{rpc::Opcode(), 0, nullptr, nullptr};
+                  };
+    }
+
+    /**
+     * @return The number of bytes of RPC calls, including their headers, that
+     * fit in one batch message.
+     */
+    std::size_t get_max_batch_size() const {
+        //The batch is sent to the whole shard, so its node list is just a size
+        return group_rpc_manager.view_manager.derecho_params.max_payload_size - sizeof(std::size_t)
+               - rpc::remote_invocation_utilities::header_space() - sizeof(std::size_t) - sizeof(bool);
+    }
+
+    /**
+     * Multicasts a batch of RPC calls, already serialized with their headers,
+     * as one ordered message to the entire shard.
+     * @param calls The serialized calls
+     * @param num_calls The number of calls in the batch
+     * @param defer True if the batch should be delivered without making a version
+     * @param completion The completion state to advance for the message, or nullptr
+     */
+    void send_batch(const std::vector<char>& calls, std::size_t num_calls, bool defer,
+                    std::shared_ptr<CompletionState> completion) {
+        using namespace rpc::remote_invocation_utilities;
+        const std::size_t batch_size = sizeof(std::size_t) + sizeof(bool) + calls.size();
+        char* buffer;
+        while(!(buffer = group_rpc_manager.view_manager.get_sendbuffer_ptr(subgroup_id, sizeof(std::size_t) + header_space() + batch_size, 0, true))) {
+        };
+        std::shared_lock<std::shared_timed_mutex> view_read_lock(group_rpc_manager.view_manager.view_mutex);
+
+        std::size_t max_payload_size;
+        buffer += group_rpc_manager.populate_nodelist_header({}, buffer, max_payload_size);
+        assert(header_space() + batch_size <= max_payload_size);
+        populate_header(buffer, batch_size, rpc::Opcode{std::type_index(typeid(T)), subgroup_id, rpc::batch_function_tag, false}, node_id);
+        buffer += header_space();
+        ((std::size_t*)buffer)[0] = num_calls;
+        buffer += sizeof(std::size_t);
+        ((bool*)buffer)[0] = defer;
+        buffer += sizeof(bool);
+        memcpy(buffer, calls.data(), calls.size());
+
+        group_rpc_manager.view_manager.view_change_cv.wait(view_read_lock, [&]() {
+            return group_rpc_manager.finish_rpc_send(subgroup_id, {}, deferred_versioning->batch_pending, completion);
+        });
+    }
 
     template <rpc::FunctionTag tag, typename... Args>
-    auto ordered_send_or_query(const std::vector<node_id_t>& destination_nodes,
+    auto ordered_send_or_query(std::shared_ptr<CompletionState> completion,
+                               const std::vector<node_id_t>& destination_nodes,
                                Args&&... args) {
         if(is_valid()) {
             // std::cout << "In ordered_send_or_query: T=" << typeid(T).name() << std::endl;
@@ -107,7 +223,7 @@ private:
 
             // std::cout << "Done with serialization" << std::endl;
             group_rpc_manager.view_manager.view_change_cv.wait(view_read_lock, [&]() {
-                return group_rpc_manager.finish_rpc_send(subgroup_id, destination_nodes, send_return_struct.pending);
+                return group_rpc_manager.finish_rpc_send(subgroup_id, destination_nodes, send_return_struct.pending, completion);
             });
             // std::cout << "Done with send" << std::endl;
             return std::move(send_return_struct.results);
@@ -162,7 +278,12 @@ public:
               shard_num(shard_num),
               group_rpc_manager(group_rpc_manager),
               wrapped_this(group_rpc_manager.make_remote_invocable_class(user_object_ptr.get(), subgroup_id, T::register_functions())),
-              p2pSendBuffer(new char[group_rpc_manager.view_manager.derecho_params.max_payload_size]) {
+              p2pSendBuffer(new char[group_rpc_manager.view_manager.derecho_params.max_payload_size]),
+              latest_local_version(-1),
+              deferred_versioning(std::make_shared<DeferredVersioning>()) {
+        // The Persistent fields loaded whatever logs they had from disk
+        reset_latest_local_version();
+        register_batch_handler();
 #ifdef _DEBUG
         std::cout << "address of Replicated<T>=" << (void*)this << std::endl;
 #endif  //_DEBUG
@@ -188,7 +309,11 @@ public:
               shard_num(shard_num),
               group_rpc_manager(group_rpc_manager),
               wrapped_this(group_rpc_manager.make_remote_invocable_class(user_object_ptr.get(), subgroup_id, T::register_functions())),
-              p2pSendBuffer(new char[group_rpc_manager.view_manager.derecho_params.max_payload_size]) {}
+              p2pSendBuffer(new char[group_rpc_manager.view_manager.derecho_params.max_payload_size]),
+              latest_local_version(-1),
+              deferred_versioning(std::make_shared<DeferredVersioning>()) {
+        register_batch_handler();
+    }
 
     // Replicated(Replicated&&) = default;
     Replicated(Replicated&& rhs) : persistent_registry_ptr(std::move(rhs.persistent_registry_ptr)),
@@ -198,7 +323,9 @@ public:
                                    shard_num(rhs.shard_num),
                                    group_rpc_manager(rhs.group_rpc_manager),
                                    wrapped_this(std::move(rhs.wrapped_this)),
-                                   p2pSendBuffer(std::move(rhs.p2pSendBuffer)) {
+                                   p2pSendBuffer(std::move(rhs.p2pSendBuffer)),
+                                   latest_local_version(rhs.latest_local_version.load()),
+                                   deferred_versioning(std::move(rhs.deferred_versioning)) {
         persistent_registry_ptr->updateTemporalFrontierProvider(this);
     }
     Replicated(const Replicated&) = delete;
@@ -227,7 +354,7 @@ public:
     template <rpc::FunctionTag tag, typename... Args>
     void ordered_send(const std::vector<node_id_t>& destination_nodes,
                       Args&&... args) {
-        ordered_send_or_query<tag>(destination_nodes, std::forward<Args>(args)...);
+        ordered_send_or_query<tag>(nullptr, destination_nodes, std::forward<Args>(args)...);
     }
 
     /**
@@ -243,6 +370,39 @@ public:
         ordered_send<tag>({}, std::forward<Args>(args)...);
     }
 
+    /**
+     * Like ordered_send, but returns a handle that can be waited on for the
+     * message to be stable, delivered at this node, or persisted, up to the
+     * milestone given. Lets a client keep a bounded number of sends in flight
+     * without correlating global_persistence_callback versions itself.
+     * @param until The last milestone the handle will be waited on for
+     * @param destination_nodes The IDs of the nodes that should be sent the
+     * RPC message
+     * @param args The arguments to the RPC function being invoked
+     * @return A MessageCompletion for the message
+     */
+    template <rpc::FunctionTag tag, typename... Args>
+    MessageCompletion ordered_send_tracked(MessageMilestone until,
+                                           const std::vector<node_id_t>& destination_nodes,
+                                           Args&&... args) {
+        auto completion = std::make_shared<CompletionState>(until);
+        ordered_send_or_query<tag>(completion, destination_nodes, std::forward<Args>(args)...);
+        return MessageCompletion(completion);
+    }
+
+    /**
+     * Like ordered_send to the entire subgroup, but returns a handle that can
+     * be waited on for the message to reach each milestone up to until.
+     * @param until The last milestone the handle will be waited on for
+     * @param args The arguments to the RPC function being invoked
+     * @return A MessageCompletion for the message
+     */
+    template <rpc::FunctionTag tag, typename... Args>
+    MessageCompletion ordered_send_tracked(MessageMilestone until, Args&&... args) {
+        // empty nodes means that the destination is the entire group
+        return ordered_send_tracked<tag>(until, {}, std::forward<Args>(args)...);
+    }
+
     /**
      * Sends a multicast to only some members of the subgroup that replicates
      * this Replicated<T>, invoking the RPC function identified by the
@@ -256,7 +416,7 @@ public:
     template <rpc::FunctionTag tag, typename... Args>
     auto ordered_query(const std::vector<node_id_t>& destination_nodes,
                        Args&&... args) {
-        return ordered_send_or_query<tag>(destination_nodes, std::forward<Args>(args)...);
+        return ordered_send_or_query<tag>(nullptr, destination_nodes, std::forward<Args>(args)...);
     }
 
     /**
@@ -304,6 +464,52 @@ public:
         return p2p_send_or_query<tag>(dest_node, std::forward<Args>(args)...);
     }
 
+    /**
+     * Runs a read-only function against a consistent snapshot of this replica,
+     * the state as of the last message delivered at this node. The function
+     * is called as reader(object, version) and must read the object's
+     * Persistent and Volatile fields at that version, e.g. with
+     * field.get(version, fun): entries in their logs never change once
+     * written, so any number of threads can read them while the delivery
+     * thread appends newer ones. Readers do take each log's reader-writer
+     * lock for reading, which waits only while the log is appending or
+     * trimming an entry.
+     * Members of T that are not versioned are not part of the snapshot and
+     * must not be read. The version is -1 if nothing has been delivered yet.
+     * @param reader The function to run
+     * @return Whatever reader returns
+     */
+    template <typename ReadFunc>
+    auto read_snapshot(ReadFunc&& reader) {
+        if(!is_valid()) {
+            throw derecho::empty_reference_exception{"Attempted to use an empty Replicated<T>"};
+        }
+        const persistent::version_t version = latest_local_version.load(std::memory_order_acquire);
+        return reader(**user_object_ptr, version);
+    }
+
+    /**
+     * Starts a bulk-ingest session, which sends many updates to this object as
+     * a few large multicasts and versions and persists them all at once when
+     * the session ends. See BulkIngestSession.
+     * @return The session
+     */
+    BulkIngestSession<T> begin_bulk_ingest() {
+        if(!is_valid()) {
+            throw derecho::empty_reference_exception{"Attempted to use an empty Replicated<T>"};
+        }
+        return BulkIngestSession<T>(this);
+    }
+
+    /**
+     * @return the version a snapshot read would see now: that of the last
+     * message delivered at this node (or of the logs loaded or received,
+     * before any is), or -1 if none.
+     */
+    persistent::version_t get_latest_local_version() const {
+        return latest_local_version.load(std::memory_order_acquire);
+    }
+
     /**
      * Gets a pointer into the send buffer for this subgroup, for the purpose of
      * doing a "raw send" (not an RPC send).
@@ -360,6 +566,11 @@ public:
      * @param receiver_socket
      */
     void send_object(tcp::socket& receiver_socket) const {
+        if(deferred_versioning->has_unversioned_updates) {
+            //The log is missing the updates of deferred bulk-ingest batches,
+            //so the receiver could not rebuild the object from it
+            PersistentRegistry::resetEarliestVersionToSerialize();
+        }
         auto bind_socket_write = [&receiver_socket](const char* bytes, std::size_t size) { receiver_socket.write(bytes, size); };
         mutils::post_object(bind_socket_write, object_size());
         send_object_raw(receiver_socket);
@@ -383,7 +594,9 @@ public:
     /**
      * Updates the state of the "wrapped" object by replacing it with the object
      * serialized in a buffer. Returns the number of bytes read from the buffer,
-     * in case the caller needs to know.
+     * in case the caller needs to know. Persistent fields that were sent as a
+     * log tail only, without their state, are rebuilt from this node's own log
+     * once the tail is merged into it.
      * @param dsm A DeserializationManager to use for deserializing the object
      * in the buffer
      * @param buffer A buffer containing a serialized T, which will replace this
@@ -396,6 +609,8 @@ public:
         rdv.insert(rdv.begin(), persistent_registry_ptr.get());
         mutils::DeserializationManager dsm{rdv};
         *user_object_ptr = std::move(mutils::from_bytes<T>(&dsm, buffer));
+        // The received logs may be ahead of, or behind, the ones that were here
+        reset_latest_local_version();
         return mutils::bytes_size(**user_object_ptr);
     }
 
@@ -404,7 +619,16 @@ public:
      * @param ver - the version number to be made
      */
     virtual void make_version(const persistent::version_t& ver, const HLC& hlc) noexcept(false) {
+        if(deferred_versioning->defer_next_version) {
+            // A deferred bulk-ingest batch: its updates go into the next version made
+            deferred_versioning->defer_next_version = false;
+            deferred_versioning->has_unversioned_updates = true;
+            return;
+        }
         persistent_registry_ptr->makeVersion(ver, hlc);
+        // Only now do the version's log entries exist for snapshot readers
+        latest_local_version.store(ver, std::memory_order_release);
+        deferred_versioning->has_unversioned_updates = false;
     };
 
     /**
@@ -412,6 +636,9 @@ public:
      */
     virtual void persist(const persistent::version_t version) noexcept(false) {
         persistent::version_t persisted_ver;
+        // A deferred bulk-ingest batch has no version of its own, so only
+        // wait for the latest version made up to it
+        const persistent::version_t target = std::min(version, latest_local_version.load());
 
         // persist variables
         do {
@@ -419,9 +646,9 @@ public:
             if(persisted_ver == -1) {
                 // for replicated<T> without Persistent fields,
                 // tell the persistent thread that we are done.
-                persisted_ver = version;
+                persisted_ver = target;
             }
-        } while(persisted_ver < version);
+        } while(persisted_ver < target);
     };
 
     /**
@@ -444,6 +671,114 @@ public:
     }
 };
 
+/**
+ * A session of many updates to a Replicated<T>, for loading data into it.
+ * The RPC calls added to the session are packed into batches that fill a
+ * whole multicast message, and each batch is sent when the next call would
+ * not fit in it. Every batch but the last is delivered without making a
+ * version; the last one, sent by end(), versions and persists the updates of
+ * the whole session at once. Until then the session's updates are not
+ * durable, and a snapshot read sees the object as it was before them, or as
+ * of the last message another member sent during the session. Only RPC
+ * functions that return void can be added, since nothing keeps the results
+ * of the individual calls. A session must only be used by one thread.
+ */
+template <typename T>
+class BulkIngestSession {
+    Replicated<T>* replicated;
+    /** The calls, with their RPC headers, in the batch that has not been sent yet. */
+    std::vector<char> calls;
+    /** The number of calls in that batch. */
+    std::size_t num_calls;
+    const std::size_t max_batch_size;
+    bool open;
+
+    friend class Replicated<T>;
+    BulkIngestSession(Replicated<T>* replicated)
+            : replicated(replicated),
+              num_calls(0),
+              max_batch_size(replicated->get_max_batch_size()),
+              open(true) {
+        calls.reserve(max_batch_size);
+    }
+
+public:
+    BulkIngestSession(BulkIngestSession&& other)
+            : replicated(other.replicated),
+              calls(std::move(other.calls)),
+              num_calls(other.num_calls),
+              max_batch_size(other.max_batch_size),
+              open(other.open) {
+        other.open = false;
+    }
+    BulkIngestSession(const BulkIngestSession&) = delete;
+
+    /** Ends the session if end() has not been called. */
+    ~BulkIngestSession() {
+        if(open) {
+            try {
+                end();
+            } catch(...) {
+                //There is no one to report a failed send to from a destructor
+            }
+        }
+    }
+
+    /**
+     * Adds a call to the RPC function identified by the FunctionTag template
+     * parameter to the session, sending the current batch first if the call
+     * does not fit in it.
+     * @param args The arguments to the RPC function
+     * @throws derecho_exception if the call is larger than a message, or the
+     * session has ended
+     */
+    template <rpc::FunctionTag tag, typename... Args>
+    void add(Args&&... args) {
+        if(!open) {
+            throw derecho_exception("Attempted to add to a bulk-ingest session that has ended");
+        }
+        const std::size_t call_size = rpc::remote_invocation_utilities::header_space()
+                                      + replicated->wrapped_this->template get_size<tag>(args...);
+        if(call_size > max_batch_size) {
+            throw derecho_exception("RPC call is too large for a bulk-ingest batch");
+        }
+        if(calls.size() + call_size > max_batch_size) {
+            replicated->send_batch(calls, num_calls, true, nullptr);
+            calls.clear();
+            num_calls = 0;
+        }
+        const std::size_t offset = calls.size();
+        calls.resize(offset + call_size);
+        std::size_t serialized_size = replicated->wrapped_this->template serialize<tag>(
+                [this, offset](std::size_t) { return calls.data() + offset; },
+                std::forward<Args>(args)...);
+        assert(serialized_size == call_size);
+        (void)serialized_size;
+        ++num_calls;
+    }
+
+    /**
+     * Sends the last batch of the session, which versions all of its updates.
+     * @return A MessageCompletion for the last batch, which reaches PERSISTED
+     * once the session's updates are persisted at every shard member; an
+     * empty one if nothing was added to the session
+     */
+    MessageCompletion end() {
+        if(!open) {
+            throw derecho_exception("Attempted to end a bulk-ingest session that has already ended");
+        }
+        open = false;
+        if(num_calls == 0) {
+            return MessageCompletion();
+        }
+        auto completion = std::make_shared<CompletionState>(MessageMilestone::PERSISTED);
+        replicated->send_batch(calls, num_calls, false, completion);
+        calls.clear();
+        num_calls = 0;
+        return MessageCompletion(completion);
+    }
+};
+
 template <typename T>
 class ExternalCaller {
 private:
@@ -560,4 +895,156 @@ public:
         return query_result_vec;
     }
 };
+
+/**
+ * Routes P2P messages to the shard of a sharded subgroup that is responsible
+ * for a key, for callers that are not members of the subgroup. Keys are
+ * mapped to shards by rendezvous hashing of a user-supplied key hash, so a
+ * change in the number of shards only moves the keys of the shards added or
+ * removed; within a shard, keys are spread over its members. The shard
+ * membership is re-read whenever the view changes. Like ExternalCaller, a
+ * ShardRouter should only be used by one thread at a time.
+ */
+template <typename T, typename Key>
+class ShardRouter {
+public:
+    using key_hash_t = std::function<uint64_t(const Key&)>;
+
+private:
+    ExternalCaller<T>& EC;
+    ViewManager& view_manager;
+    const subgroup_id_t subgroup_id;
+    const key_hash_t key_hash;
+    /** The vid of the view shard_members was read from; -1 before the first read. */
+    int32_t routing_vid;
+    /** The members of each shard, by shard number, as of routing_vid. */
+    std::vector<std::vector<node_id_t>> shard_members;
+
+    /** splitmix64's finalizer, to spread the bits of a combined hash. */
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+        return x;
+    }
+
+    void refresh_routing() {
+        SharedLockedReference<View> view_ref = view_manager.get_current_view();
+        const View& curr_view = view_ref.get();
+        if(curr_view.vid == routing_vid) {
+            return;
+        }
+        const auto& shard_subviews = curr_view.subgroup_shard_views.at(subgroup_id);
+        shard_members.resize(shard_subviews.size());
+        for(uint i = 0; i < shard_subviews.size(); ++i) {
+            shard_members[i] = shard_subviews[i].members;
+        }
+        routing_vid = curr_view.vid;
+    }
+
+    uint32_t shard_of_hash(uint64_t hash) const {
+        uint32_t best_shard = 0;
+        uint64_t best_score = 0;
+        for(uint32_t shard = 0; shard < shard_members.size(); ++shard) {
+            if(shard_members[shard].empty()) {
+                continue;
+            }
+            const uint64_t score = mix(hash ^ mix(shard + 1));
+            if(score >= best_score) {
+                best_score = score;
+                best_shard = shard;
+            }
+        }
+        return best_shard;
+    }
+
+    node_id_t node_of_hash(uint32_t shard, uint64_t hash) const {
+        const std::vector<node_id_t>& members = shard_members.at(shard);
+        if(members.empty()) {
+            throw derecho_exception("Shard " + std::to_string(shard) + " has no members to route to");
+        }
+        // Rotate the hash so the choice of member is independent of the choice of shard
+        return members[mix((hash << 32) | (hash >> 32)) % members.size()];
+    }
+
+public:
+    ShardRouter(ExternalCaller<T>& EC, ViewManager& view_manager, subgroup_id_t subgroup_id, key_hash_t key_hash)
+            : EC(EC),
+              view_manager(view_manager),
+              subgroup_id(subgroup_id),
+              key_hash(std::move(key_hash)),
+              routing_vid(-1) {}
+
+    /** @return the number of the shard responsible for the key in the current view. */
+    uint32_t shard_of(const Key& key) {
+        refresh_routing();
+        return shard_of_hash(key_hash(key));
+    }
+
+    /** @return the ID of the node that messages about the key are sent to in the current view. */
+    node_id_t node_of(const Key& key) {
+        refresh_routing();
+        const uint64_t hash = key_hash(key);
+        return node_of_hash(shard_of_hash(hash), hash);
+    }
+
+    /**
+     * Sends a P2P message about a key to a member of the shard responsible
+     * for it, invoking the RPC function identified by the FunctionTag template
+     * parameter, but does not wait for a response.
+     * @param key The key that determines the destination
+     * @param args The arguments to the RPC function being invoked
+     */
+    template <rpc::FunctionTag tag, typename... Args>
+    void p2p_send_by_key(const Key& key, Args&&... args) {
+        EC.template p2p_send<tag>(node_of(key), std::forward<Args>(args)...);
+    }
+
+    /**
+     * Sends a P2P query about a key to a member of the shard responsible for
+     * it, invoking the RPC function identified by the FunctionTag template
+     * parameter. Unlike ShardIterator::p2p_query, only one shard is contacted.
+     * @param key The key that determines the destination
+     * @param args The arguments to the RPC function being invoked
+     * @return An instance of rpc::QueryResults<Ret>, where Ret is the return type
+     * of the RPC function being invoked
+     */
+    template <rpc::FunctionTag tag, typename... Args>
+    auto p2p_query_by_key(const Key& key, Args&&... args) {
+        return EC.template p2p_query<tag>(node_of(key), std::forward<Args>(args)...);
+    }
+
+    /**
+     * Looks up several keys with one P2P query per shard that is responsible
+     * for any of them, rather than one per key. The RPC function identified
+     * by the FunctionTag template parameter must take a std::vector<Key> as
+     * its only argument, and is invoked with the keys that belong to the
+     * shard it is sent to, in the order they appear in keys.
+     * @param keys The keys to look up
+     * @return A vector with one entry per shard contacted, holding the keys
+     * sent to that shard and the rpc::QueryResults for the query
+     */
+    template <rpc::FunctionTag tag>
+    auto p2p_query_keys(const std::vector<Key>& keys) {
+        refresh_routing();
+        // Group the keys by destination node, so each shard gets one query
+        std::map<node_id_t, std::vector<Key>> keys_by_node;
+        for(const Key& key : keys) {
+            const uint64_t hash = key_hash(key);
+            const uint32_t shard = shard_of_hash(hash);
+            // Every key of a batch goes to the same member of its shard
+            keys_by_node[node_of_hash(shard, mix(shard + 1))].push_back(key);
+        }
+        using query_results_t = decltype(EC.template p2p_query<tag>(node_id_t(), std::declval<const std::vector<Key>&>()));
+        std::vector<std::pair<std::vector<Key>, query_results_t>> results;
+        results.reserve(keys_by_node.size());
+        for(auto& node_keys : keys_by_node) {
+            auto query_results = EC.template p2p_query<tag>(node_keys.first, node_keys.second);
+            results.emplace_back(std::move(node_keys.second), std::move(query_results));
+        }
+        return results;
+    }
+};
 }
@@ -85,13 +85,19 @@ void RPCManager::rpc_message_handler(subgroup_id_t subgroup_id, node_id_t sender
         }
     }
     if(in_dest || dest_size == 0) {
+        //Messages of different subgroups are delivered on different threads at once,
+        //so each thread builds its replies in its own buffer
+        thread_local std::vector<char> reply_buffer;
         auto max_payload_size = view_manager.curr_view->multicast_group->max_msg_size - sizeof(header);
         //Use the reply-buffer allocation lambda to detect whether handle_receive generated a reply
         size_t reply_size = 0;
-        parse_and_receive(msg_buf, payload_size, [this, &reply_size, &max_payload_size](size_t size) -> char* {
+        parse_and_receive(msg_buf, payload_size, [&reply_size, &max_payload_size](size_t size) -> char* {
             reply_size = size;
             if(reply_size <= max_payload_size) {
-                return replySendBuffer.get();
+                if(reply_buffer.size() < reply_size) {
+                    reply_buffer.resize(reply_size);
+                }
+                return reply_buffer.data();
             } else {
                 return nullptr;
             }
@@ -113,10 +119,10 @@ void RPCManager::rpc_message_handler(subgroup_id_t subgroup_id, node_id_t sender
                 }
                 //Immediately handle the reply to myself
                 parse_and_receive(
-                        replySendBuffer.get(), reply_size,
+                        reply_buffer.data(), reply_size,
                         [](size_t size) -> char* { assert(false); });
             } else {
-                connections.write(sender_id, replySendBuffer.get(), reply_size);
+                connections.write(sender_id, reply_buffer.data(), reply_size);
             }
         } else {
             logger->trace("RPC message handled, no reply necessary.");
@@ -202,8 +208,9 @@ int RPCManager::populate_nodelist_header(const std::vector<node_id_t>& dest_node
     return header_size;
 }
 
-bool RPCManager::finish_rpc_send(uint32_t subgroup_id, const std::vector<node_id_t>& dest_nodes, PendingBase& pending_results_handle) {
-    if(!view_manager.curr_view->multicast_group->send(subgroup_id)) {
+bool RPCManager::finish_rpc_send(uint32_t subgroup_id, const std::vector<node_id_t>& dest_nodes, PendingBase& pending_results_handle,
+                                 std::shared_ptr<CompletionState> completion) {
+    if(!view_manager.curr_view->multicast_group->send(subgroup_id, completion)) {
         return false;
     }
     std::lock_guard<std::mutex> lock(pending_results_mutex);
@@ -226,6 +233,7 @@ void RPCManager::finish_p2p_send(node_id_t dest_node, char* msg_buf, std::size_t
 
 void RPCManager::p2p_receive_loop() {
     pthread_setname_np(pthread_self(), "rpc_thread");
+    pin_thread(ThreadRole::RPC);
     auto max_payload_size = view_manager.curr_view->multicast_group->max_msg_size - sizeof(header);
     std::unique_ptr<char[]> rpcBuffer = std::unique_ptr<char[]>(new char[max_payload_size]);
     while(!thread_start) {
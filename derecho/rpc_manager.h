@@ -59,10 +59,6 @@ class RPCManager {
     std::queue<std::reference_wrapper<PendingBase>> toFulfillQueue;
     std::list<std::reference_wrapper<PendingBase>> fulfilledList;
 
-    /** This is not accessed outside invocations of rpc_message_handler,
-     * it's just a member so it won't be newly allocated every time. */
-    std::unique_ptr<char[]> replySendBuffer;
-
     bool thread_start = false;
     /** Mutex for thread_start_cv. */
     std::mutex thread_start_mutex;
@@ -122,8 +118,7 @@ public:
               view_manager(group_view_manager),
               //Connections is initially empty, all connections are added in the new view callback
               connections(node_id, std::map<node_id_t, ip_addr>(),
-                          group_view_manager.derecho_params.rpc_port),
-              replySendBuffer(new char[group_view_manager.derecho_params.max_payload_size]) {
+                          group_view_manager.derecho_params.rpc_port) {
         rpc_thread = std::thread(&RPCManager::p2p_receive_loop, this);
     }
 
@@ -244,9 +239,11 @@ public:
      * @param dest_nodes The list of node IDs the message is being sent to
      * @param pending_results_handle A reference to the "promise object" in the
      * send_return for this send.
+     * @param completion If not null, follows the message through its milestones
      * @return True if the send was successful, false if the current view is wedged
      */
-    bool finish_rpc_send(uint32_t subgroup_id, const std::vector<node_id_t>& dest_nodes, PendingBase& pending_results_handle);
+    bool finish_rpc_send(uint32_t subgroup_id, const std::vector<node_id_t>& dest_nodes, PendingBase& pending_results_handle,
+                         std::shared_ptr<CompletionState> completion = nullptr);
 
     /**
      * Sends the message in msg_buf to the node identified by dest_node over a
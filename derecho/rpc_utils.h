@@ -10,6 +10,7 @@
 #include <exception>
 #include <functional>
 #include <future>
+#include <limits>
 #include <map>
 #include <memory>
 #include <set>
@@ -50,6 +51,12 @@ struct String {
 
 using FunctionTag = unsigned long long;
 
+/**
+ * The function ID reserved for messages that carry a batch of RPC calls to the
+ * same subgroup (see BulkIngestSession). No hashed function name maps to it.
+ */
+constexpr FunctionTag batch_function_tag = std::numeric_limits<FunctionTag>::max();
+
 /**
  * An RPC function call can be uniquely identified by the tuple
  * (class, subgroup ID, function ID, is-reply), which is what this struct
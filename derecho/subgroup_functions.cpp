@@ -34,6 +34,10 @@ ShardAllocationPolicy raw_even_sharding_policy(int num_shards, int nodes_per_sha
     return ShardAllocationPolicy{num_shards, true, nodes_per_shard, Mode::UNORDERED, {}, {}};
 }
 
+ShardAllocationPolicy fifo_even_sharding_policy(int num_shards, int nodes_per_shard) {
+    return ShardAllocationPolicy{num_shards, true, nodes_per_shard, Mode::FIFO_STABLE, {}, {}};
+}
+
 ShardAllocationPolicy custom_shards_policy(const std::vector<int>& num_nodes_by_shard,
                                            const std::vector<Mode>& delivery_modes_by_shard) {
     return ShardAllocationPolicy{static_cast<int>(num_nodes_by_shard.size()), false, -1, Mode::ORDERED,
@@ -84,14 +84,23 @@ ShardAllocationPolicy even_sharding_policy(int num_shards, int nodes_per_shard);
  * @return A ShardAllocationPolicy value with these parameters.
  */
 ShardAllocationPolicy raw_even_sharding_policy(int num_shards, int nodes_per_shard);
+/**
+ * Returns a ShardAllocationPolicy that specifies num_shards shards with
+ * the same number of nodes in each shard, and every shard running in
+ * FIFO_STABLE delivery mode (per-sender order, no total order).
+ * @param num_shards The number of shards to request in this policy.
+ * @param nodes_per_shard The number of nodes per shard to request.
+ * @return A ShardAllocationPolicy value with these parameters.
+ */
+ShardAllocationPolicy fifo_even_sharding_policy(int num_shards, int nodes_per_shard);
 /**
  * Returns a ShardAllocationPolicy for a subgroup that has a different number of
  * members in each shard, and possibly has each shard in a different delivery mode.
  * Note that the two parameter vectors must be the same length.
  * @param num_nodes_by_shard A vector specifying how many nodes should be in each
  * shard; the ith shard will have num_nodes_by_shard[i] members.
- * @param delivery_modes_by_shard A vector specifying the delivery mode (Raw or
- * Ordered) for each shard, in the same order as the other vector.
+ * @param delivery_modes_by_shard A vector specifying the delivery mode (Raw,
+ * Ordered or FIFO_STABLE) for each shard, in the same order as the other vector.
  * @return A ShardAllocationPolicy that specifies these shard sizes and modes.
  */
 ShardAllocationPolicy custom_shards_policy(const std::vector<int>& num_nodes_by_shard,
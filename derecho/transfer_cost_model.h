@@ -0,0 +1,108 @@
+/**
+ * @file transfer_cost_model.h
+ *
+ * A simple analytic model of how long a multicast takes over the SST slot
+ * path and over RDMC, used to decide per subgroup which path a message of a
+ * given size should take.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "rdmc/rdmc.h"
+
+namespace derecho {
+
+struct TransferCostModel {
+    /** Latency of a single one-sided RDMA write, in nanoseconds. */
+    double write_latency_ns = 2000;
+    /** Bytes the sender's NIC can put on the wire per nanosecond. */
+    double bytes_per_ns = 10;
+    /** Fixed cost of each step of an RDMC schedule (completion handling
+     * and the ready-for-block handshake), in nanoseconds. */
+    double rdmc_step_overhead_ns = 3000;
+    /** Fixed cost of starting an RDMC send (waking the sender thread and
+     * posting the first block), in nanoseconds. */
+    double rdmc_send_overhead_ns = 5000;
+
+    /**
+     * Estimates the time to multicast a message through SST slots: the
+     * sender writes the used part of its slot to every row it puts to.
+     * @param msg_size The size of the message, including the header
+     * @param num_rows The number of remote rows the slot is written to
+     */
+    double sst_cost_ns(uint64_t msg_size, uint32_t num_rows) const {
+        return write_latency_ns + num_rows * (msg_size / bytes_per_ns);
+    }
+
+    /**
+     * Estimates the time to multicast a message with RDMC, by counting the
+     * steps of the send schedule; each step moves one block.
+     * @param msg_size The size of the message, including the header
+     * @param num_members The number of members in the RDMC group
+     * @param block_size The RDMC block size of the group
+     * @param algorithm The RDMC send algorithm of the group
+     */
+    double rdmc_cost_ns(uint64_t msg_size, uint32_t num_members,
+                        uint64_t block_size, rdmc::send_algorithm algorithm) const {
+        if(num_members <= 1) {
+            return 0;
+        }
+        const double num_blocks = std::max<uint64_t>(1, (msg_size + block_size - 1) / block_size);
+        const double log_members = std::ceil(std::log2(num_members));
+        double num_steps;
+        switch(algorithm) {
+            case rdmc::CHAIN_SEND:
+                num_steps = num_blocks + num_members - 2;
+                break;
+            case rdmc::SEQUENTIAL_SEND:
+                num_steps = num_blocks * (num_members - 1);
+                break;
+            case rdmc::TREE_SEND:
+                num_steps = num_blocks * log_members;
+                break;
+            case rdmc::BINOMIAL_SEND:
+            default:
+                num_steps = num_blocks + log_members - 1;
+                break;
+        }
+        const double block_bytes = std::min<uint64_t>(msg_size, block_size);
+        return rdmc_send_overhead_ns
+               + num_steps * (write_latency_ns + rdmc_step_overhead_ns + block_bytes / bytes_per_ns);
+    }
+
+    /**
+     * Computes the largest message size for which the SST path is expected
+     * to be no slower than RDMC, scanning in steps of step_size bytes.
+     * @param num_rows The number of remote rows an SST multicast writes to
+     * @param num_members The number of members in the shard
+     * @param block_size The RDMC block size
+     * @param algorithm The RDMC send algorithm
+     * @param capacity The largest message an SST slot can hold
+     * @param step_size The granularity of the threshold
+     * @return The threshold, at most capacity; 0 if RDMC is always cheaper
+     */
+    uint64_t sst_threshold(uint32_t num_rows, uint32_t num_members,
+                           uint64_t block_size, rdmc::send_algorithm algorithm,
+                           uint64_t capacity, uint64_t step_size = 64) const {
+        // With a single member there is nothing to send, so never start RDMC
+        if(num_members <= 1) {
+            return capacity;
+        }
+        uint64_t threshold = 0;
+        for(uint64_t size = step_size; size <= capacity; size += step_size) {
+            if(sst_cost_ns(size, num_rows) > rdmc_cost_ns(size, num_members, block_size, algorithm)) {
+                break;
+            }
+            threshold = size;
+        }
+        if(threshold + step_size > capacity
+           && sst_cost_ns(capacity, num_rows) <= rdmc_cost_ns(capacity, num_members, block_size, algorithm)) {
+            threshold = capacity;
+        }
+        return threshold;
+    }
+};
+}  // namespace derecho
@@ -223,6 +223,12 @@ void View::merge_changes() {
 void View::wedge() {
     multicast_group->wedge();  // RDMC finishes sending, stops new sends or receives in Vc
     gmssst::set(gmsSST->wedged[my_rank], true);
+    // A relayed wedged can overtake the direct write of num_received, so make
+    // sure the final num_received has arrived everywhere first
+    if(gmsSST->is_relaying()) {
+        gmsSST->put_with_completion(gmsSST->receive_counters.get_base() - gmsSST->getBaseAddress(),
+                                    gmsSST->receive_counters.field_len);
+    }
     gmsSST->put(gmsSST->wedged.get_base() - gmsSST->getBaseAddress(), sizeof(gmsSST->wedged[0]));
 }
 
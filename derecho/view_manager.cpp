@@ -267,11 +267,11 @@ void ViewManager::await_first_view(const node_id_t my_id,
 void ViewManager::initialize_rdmc_sst() {
     // construct member_ips
     auto member_ips_map = make_member_ips_map(*curr_view);
-    if(!rdmc::initialize(member_ips_map, curr_view->members[curr_view->my_rank])) {
+    if(!rdmc::initialize(member_ips_map, curr_view->members[curr_view->my_rank], derecho_params.rdmc_port)
+       || !sst::verbs_initialize(member_ips_map, curr_view->members[curr_view->my_rank], derecho_params.sst_port)) {
         std::cout << "Global setup failed" << std::endl;
         exit(0);
     }
-    sst::verbs_initialize(member_ips_map, curr_view->members[curr_view->my_rank]);
 }
 
 std::map<node_id_t, ip_addr> ViewManager::make_member_ips_map(const View& view) {
@@ -455,7 +455,7 @@ void ViewManager::acknowledge_proposed_change(DerechoSST& gmsSST) {
     // Notice a new request, acknowledge it
     gmssst::set(gmsSST.num_acked[myRank], gmsSST.num_changes[myRank]);
     gmsSST.put(gmsSST.changes.get_base() - gmsSST.getBaseAddress(),
-               gmsSST.num_received.get_base() - gmsSST.changes.get_base());
+               gmsSST.wedged.get_base() - gmsSST.changes.get_base());
     logger->debug("Wedging current view.");
     curr_view->wedge();
     logger->debug("Done wedging current view.");
@@ -537,7 +537,16 @@ void ViewManager::terminate_epoch(std::shared_ptr<std::map<subgroup_id_t, Subgro
     }
     //If execution reached here, we have a valid next view
 
-    // go through all subgroups first and acknowledge all messages received through SST
+    // wait for the pending sst sends of every subgroup to finish, then flush them
+    // all with a single completion-tracked put and a single barrier
+    for(const auto& shard_settings_pair : curr_view->multicast_group->get_subgroup_settings()) {
+        while(curr_view->multicast_group->check_pending_sst_sends(shard_settings_pair.first)) {
+        }
+    }
+    curr_view->gmsSST->put_with_completion();
+    curr_view->gmsSST->sync_with_members();
+
+    // now acknowledge all messages received through SST, in every subgroup
     for(const auto& shard_settings_pair : curr_view->multicast_group->get_subgroup_settings()) {
         const subgroup_id_t subgroup_id = shard_settings_pair.first;
         const auto& curr_subgroup_settings = shard_settings_pair.second;
@@ -551,11 +560,6 @@ void ViewManager::terminate_epoch(std::shared_ptr<std::map<subgroup_id_t, Subgro
                 l++;
             }
         }
-        // wait for all pending sst sends to finish
-        while(curr_view->multicast_group->check_pending_sst_sends(subgroup_id)) {
-        }
-        curr_view->gmsSST->put_with_completion();
-        curr_view->gmsSST->sync_with_members();
         while(curr_view->multicast_group->receiver_predicate(subgroup_id, curr_subgroup_settings, shard_ranks_by_sender_rank, num_shard_senders, *curr_view->gmsSST)) {
             auto sst_receive_handler_lambda = [this, subgroup_id, curr_subgroup_settings,
                                                shard_ranks_by_sender_rank,
@@ -576,6 +580,7 @@ void ViewManager::terminate_epoch(std::shared_ptr<std::map<subgroup_id_t, Subgro
 
     //First, for subgroups in which I'm the shard leader, do RaggedEdgeCleanup for the leader
     auto follower_subgroups_and_shards = std::make_shared<std::map<subgroup_id_t, uint32_t>>();
+    std::vector<subgroup_id_t> leader_subgroups;
     for(const auto& shard_settings_pair : curr_view->multicast_group->get_subgroup_settings()) {
         const subgroup_id_t subgroup_id = shard_settings_pair.first;
         const uint32_t shard_num = shard_settings_pair.second.shard_num;
@@ -589,12 +594,21 @@ void ViewManager::terminate_epoch(std::shared_ptr<std::map<subgroup_id_t, Subgro
                 leader_ragged_edge_cleanup(*curr_view, subgroup_id,
                                            shard_settings_pair.second.num_received_offset,
                                            shard_view.members, num_shard_senders, logger, next_view->members);
+                leader_subgroups.push_back(subgroup_id);
             } else {
                 //Keep track of which subgroups I'm a non-leader in, and what my corresponding shard ID is
                 follower_subgroups_and_shards->emplace(subgroup_id, shard_num);
             }
         }
     }
+    //Send the global_mins of all the subgroups I lead in one exchange, then deliver up to them
+    push_ragged_edge_results(*curr_view, leader_subgroups);
+    for(const subgroup_id_t subgroup_id : leader_subgroups) {
+        const SubgroupSettings& settings = curr_view->multicast_group->get_subgroup_settings().at(subgroup_id);
+        deliver_in_order(*curr_view, curr_view->my_rank, subgroup_id, settings.num_received_offset,
+                         settings.members, curr_view->multicast_group->get_num_senders(settings.senders), logger);
+        logger->debug("Done with RaggedEdgeCleanup for subgroup {}", subgroup_id);
+    }
 
     //Wait for the shard leaders of subgroups I'm not a leader in to post global_min_ready before continuing
     auto leader_global_mins_are_ready = [this, follower_subgroups_and_shards](const DerechoSST& gmsSST) {
@@ -614,6 +628,7 @@ void ViewManager::terminate_epoch(std::shared_ptr<std::map<subgroup_id_t, Subgro
 
         logger->debug("GlobalMins are ready for all {} subgroup leaders this node is waiting on", follower_subgroups_and_shards->size());
         //Finish RaggedEdgeCleanup for subgroups in which I'm not the leader
+        std::vector<subgroup_id_t> follower_subgroups;
         for(const auto& subgroup_shard_pair : *follower_subgroups_and_shards) {
             SubView& shard_view = curr_view->subgroup_shard_views.at(subgroup_shard_pair.first)
                                           .at(subgroup_shard_pair.second);
@@ -631,6 +646,20 @@ void ViewManager::terminate_epoch(std::shared_ptr<std::map<subgroup_id_t, Subgro
                                          shard_view.members,
                                          num_shard_senders,
                                          logger);
+            follower_subgroups.push_back(subgroup_shard_pair.first);
+        }
+        //Echo all the leaders' global_mins in one exchange before acting upon them
+        push_ragged_edge_results(*curr_view, follower_subgroups);
+        for(const auto& subgroup_shard_pair : *follower_subgroups_and_shards) {
+            SubView& shard_view = curr_view->subgroup_shard_views.at(subgroup_shard_pair.first)
+                                          .at(subgroup_shard_pair.second);
+            node_id_t shard_leader = shard_view.members[curr_view->subview_rank_of_shard_leader(
+                    subgroup_shard_pair.first, subgroup_shard_pair.second)];
+            const SubgroupSettings& settings = curr_view->multicast_group->get_subgroup_settings().at(subgroup_shard_pair.first);
+            deliver_in_order(*curr_view, curr_view->rank_of(shard_leader), subgroup_shard_pair.first,
+                             settings.num_received_offset, settings.members,
+                             curr_view->multicast_group->get_num_senders(settings.senders), logger);
+            logger->debug("Done with RaggedEdgeCleanup for subgroup {}", subgroup_shard_pair.first);
         }
 
         //Wait for persistence to finish for messages delivered in RaggedEdgeCleanup
@@ -638,7 +667,7 @@ void ViewManager::terminate_epoch(std::shared_ptr<std::map<subgroup_id_t, Subgro
             //For each subgroup/shard that this node is a member of...
             for(auto subgroup_settings_pair : curr_view->multicast_group->get_subgroup_settings()) {
                 subgroup_id_t subgroup_id = subgroup_settings_pair.first;
-                if(subgroup_settings_pair.second.mode == Mode::UNORDERED) {
+                if(subgroup_settings_pair.second.mode != Mode::ORDERED) {
                     //Skip non-ordered subgroups, they never do persistence
                     continue;
                 }
@@ -707,12 +736,13 @@ void ViewManager::finish_view_change(std::shared_ptr<std::map<subgroup_id_t, uin
     for(std::size_t i = 0; i < next_view->joined.size(); ++i) {
         //The new members will be the last joined.size() elements of the members lists
         int joiner_rank = next_view->num_members - next_view->joined.size() + i;
-        rdma::impl::verbs_add_connection(next_view->members[joiner_rank], next_view->member_ips[joiner_rank],
-                                         my_id);
+        rdma::transport_context::get(my_id)->add_connection(next_view->members[joiner_rank], next_view->member_ips[joiner_rank],
+                                                            derecho_params.rdmc_port);
     }
     for(std::size_t i = 0; i < next_view->joined.size(); ++i) {
         int joiner_rank = next_view->num_members - next_view->joined.size() + i;
-        sst::add_node(next_view->members[joiner_rank], next_view->member_ips[joiner_rank]);
+        sst::TransportContext::get(my_id)->add_node(next_view->members[joiner_rank], next_view->member_ips[joiner_rank],
+                                                    derecho_params.sst_port);
     }
     // This will block until everyone responds to SST/RDMC initial handshakes
     transition_multicast_group(*next_subgroup_settings, next_num_received_size);
@@ -797,7 +827,8 @@ void ViewManager::construct_multicast_group(CallbackSet callbacks,
     const auto num_subgroups = curr_view->subgroup_shard_views.size();
     curr_view->gmsSST = std::make_shared<DerechoSST>(
             sst::SSTParams(curr_view->members, curr_view->members[curr_view->my_rank],
-                           [this](const uint32_t node_id) { report_failure(node_id); }, curr_view->failed, false),
+                           [this](const uint32_t node_id) { report_failure(node_id); }, curr_view->failed, false,
+                           derecho_params.sst_relay_fanout, derecho_params.sst_detect_threads, derecho_params.sst_port),
             num_subgroups, num_received_size, derecho_params.window_size);
 
     curr_view->multicast_group = std::make_unique<MulticastGroup>(
@@ -814,7 +845,8 @@ void ViewManager::transition_multicast_group(const std::map<subgroup_id_t, Subgr
     const auto num_subgroups = next_view->subgroup_shard_views.size();
     next_view->gmsSST = std::make_shared<DerechoSST>(
             sst::SSTParams(next_view->members, next_view->members[next_view->my_rank],
-                           [this](const uint32_t node_id) { report_failure(node_id); }, next_view->failed, false),
+                           [this](const uint32_t node_id) { report_failure(node_id); }, next_view->failed, false,
+                           derecho_params.sst_relay_fanout, derecho_params.sst_detect_threads, derecho_params.sst_port),
             num_subgroups, new_num_received_size, derecho_params.window_size);
 
     next_view->multicast_group = std::make_unique<MulticastGroup>(
@@ -940,7 +972,8 @@ uint32_t ViewManager::make_subgroup_maps(const std::unique_ptr<View>& prev_view,
              * and save it under its subgroup ID (which was shard_views_by_subgroup.size()) */
             curr_view.subgroup_shard_views.emplace_back(
                     std::move(subgroup_shard_views[subgroup_index]));
-            num_received_offset += max_shard_senders;
+            // Every subgroup gets at least one entry, which holds its seq_num
+            num_received_offset += std::max(max_shard_senders, 1u);
         }
     }
     return num_received_offset;
@@ -1158,12 +1191,12 @@ void ViewManager::leader_ragged_edge_cleanup(View& Vc, const subgroup_id_t subgr
 
     if(!found) {
         for(uint n = 0; n < num_shard_senders; n++) {
-            int min = Vc.gmsSST->num_received[myRank][num_received_offset + n];
+            int min = Vc.gmsSST->receive_counters[myRank][num_received_offset + n].num_received;
             for(uint r = 0; r < shard_members.size(); r++) {
                 const auto node_id = shard_members[r];
                 const auto node_rank = Vc.rank_of(node_id);
-                if(!Vc.failed[node_rank] && min > Vc.gmsSST->num_received[node_rank][num_received_offset + n]) {
-                    min = Vc.gmsSST->num_received[node_rank][num_received_offset + n];
+                if(!Vc.failed[node_rank] && min > Vc.gmsSST->receive_counters[node_rank][num_received_offset + n].num_received) {
+                    min = Vc.gmsSST->receive_counters[node_rank][num_received_offset + n].num_received;
                 }
             }
 
@@ -1173,15 +1206,6 @@ void ViewManager::leader_ragged_edge_cleanup(View& Vc, const subgroup_id_t subgr
 
     logger->debug("Shard leader for subgroup {} finished computing global_min", subgroup_num);
     gmssst::set(Vc.gmsSST->global_min_ready[myRank][subgroup_num], true);
-    Vc.gmsSST->put(Vc.multicast_group->get_shard_sst_indices(subgroup_num),
-                   (char*)std::addressof(Vc.gmsSST->global_min[0][num_received_offset]) - Vc.gmsSST->getBaseAddress(),
-                   sizeof(Vc.gmsSST->global_min[0][num_received_offset]) * num_shard_senders);
-    Vc.gmsSST->put(Vc.multicast_group->get_shard_sst_indices(subgroup_num),
-                   (char*)std::addressof(Vc.gmsSST->global_min_ready[0][subgroup_num]) - Vc.gmsSST->getBaseAddress(),
-                   sizeof(Vc.gmsSST->global_min_ready[0][subgroup_num]));
-
-    deliver_in_order(Vc, myRank, subgroup_num, num_received_offset, shard_members, num_shard_senders, logger);
-    logger->debug("Done with RaggedEdgeCleanup for subgroup {}", subgroup_num);
 }
 
 void ViewManager::follower_ragged_edge_cleanup(View& Vc, const subgroup_id_t subgroup_num,
@@ -1195,14 +1219,26 @@ void ViewManager::follower_ragged_edge_cleanup(View& Vc, const subgroup_id_t sub
     gmssst::set(Vc.gmsSST->global_min[myRank] + num_received_offset, Vc.gmsSST->global_min[shard_leader_rank] + num_received_offset,
                 num_shard_senders);
     gmssst::set(Vc.gmsSST->global_min_ready[myRank][subgroup_num], true);
-    Vc.gmsSST->put(Vc.multicast_group->get_shard_sst_indices(subgroup_num),
-                   (char*)std::addressof(Vc.gmsSST->global_min[0][num_received_offset]) - Vc.gmsSST->getBaseAddress(),
-                   sizeof(Vc.gmsSST->global_min[0][num_received_offset]) * num_shard_senders);
-    Vc.gmsSST->put(Vc.multicast_group->get_shard_sst_indices(subgroup_num),
-                   (char*)std::addressof(Vc.gmsSST->global_min_ready[0][subgroup_num]) - Vc.gmsSST->getBaseAddress(),
-                   sizeof(Vc.gmsSST->global_min_ready[0][subgroup_num]));
-    deliver_in_order(Vc, shard_leader_rank, subgroup_num, num_received_offset, shard_members, num_shard_senders, logger);
-    logger->debug("Done with RaggedEdgeCleanup for subgroup {}", subgroup_num);
+}
+
+void ViewManager::push_ragged_edge_results(View& Vc, const std::vector<subgroup_id_t>& subgroups) {
+    if(subgroups.empty()) {
+        return;
+    }
+    std::set<uint32_t> receiver_set;
+    for(const subgroup_id_t subgroup_num : subgroups) {
+        const auto shard_sst_indices = Vc.multicast_group->get_shard_sst_indices(subgroup_num);
+        receiver_set.insert(shard_sst_indices.begin(), shard_sst_indices.end());
+    }
+    const std::vector<uint32_t> receivers(receiver_set.begin(), receiver_set.end());
+    // Two puts rather than one, so that every global_min has landed before
+    // the global_min_ready flags that make it visible
+    Vc.gmsSST->put(receivers,
+                   (char*)std::addressof(Vc.gmsSST->global_min[0][0]) - Vc.gmsSST->getBaseAddress(),
+                   sizeof(Vc.gmsSST->global_min[0][0]) * Vc.gmsSST->global_min.size());
+    Vc.gmsSST->put(receivers,
+                   (char*)std::addressof(Vc.gmsSST->global_min_ready[0][0]) - Vc.gmsSST->getBaseAddress(),
+                   sizeof(Vc.gmsSST->global_min_ready[0][0]) * Vc.gmsSST->global_min_ready.size());
 }
 
 /* ------------- 4. Public-Interface methods of ViewManager ------------- */
@@ -1241,10 +1277,10 @@ char* ViewManager::get_sendbuffer_ptr(subgroup_id_t subgroup_num, unsigned long
     return curr_view->multicast_group->get_sendbuffer_ptr(subgroup_num, payload_size, pause_sending_turns, cooked_send, null_send);
 }
 
-void ViewManager::send(subgroup_id_t subgroup_num) {
+void ViewManager::send(subgroup_id_t subgroup_num, std::shared_ptr<CompletionState> completion) {
     shared_lock_t lock(view_mutex);
     view_change_cv.wait(lock, [&]() {
-        return curr_view->multicast_group->send(subgroup_num);
+        return curr_view->multicast_group->send(subgroup_num, completion);
     });
 }
 
@@ -1253,6 +1289,11 @@ const uint64_t ViewManager::compute_global_stability_frontier(subgroup_id_t subg
     return curr_view->multicast_group->compute_global_stability_frontier(subgroup_num);
 }
 
+double ViewManager::get_acks_per_message(subgroup_id_t subgroup_num) {
+    shared_lock_t lock(view_mutex);
+    return curr_view->multicast_group->get_acks_per_message(subgroup_num);
+}
+
 void ViewManager::add_view_upcall(const view_upcall_t& upcall) {
     view_upcalls.emplace_back(upcall);
 }
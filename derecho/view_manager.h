@@ -7,6 +7,7 @@
 
 #include <map>
 #include <mutex>
+#include <set>
 #include <shared_mutex>
 #include <string>
 #include <thread>
@@ -190,18 +191,34 @@ private:
                                  const subgroup_id_t subgroup_num, const uint32_t nReceived_offset,
                                  const std::vector<node_id_t>& shard_members, uint num_shard_senders,
                                  std::shared_ptr<spdlog::logger> logger);
+    /**
+     * Computes global_min for a subgroup this node leads and sets
+     * global_min_ready in the local row. The caller sends the results with
+     * push_ragged_edge_results and then delivers up to them.
+     */
     static void leader_ragged_edge_cleanup(View& Vc, const subgroup_id_t subgroup_num,
                                            const uint32_t num_received_offset,
                                            const std::vector<node_id_t>& shard_members,
                                            uint num_shard_senders,
                                            std::shared_ptr<spdlog::logger> logger,
                                            const std::vector<node_id_t>& next_view_members);
+    /**
+     * Copies the shard leader's global_min for a subgroup into the local row
+     * and sets global_min_ready. As with the leader, the caller pushes the
+     * echoed values before delivering up to them.
+     */
     static void follower_ragged_edge_cleanup(View& Vc, const subgroup_id_t subgroup_num,
                                              uint shard_leader_rank,
                                              const uint32_t num_received_offset,
                                              const std::vector<node_id_t>& shard_members,
                                              uint num_shard_senders,
                                              std::shared_ptr<spdlog::logger> logger);
+    /**
+     * Sends the local global_min and global_min_ready fields to every member
+     * of the shards of the given subgroups, in one exchange for all of them
+     * rather than one per subgroup.
+     */
+    static void push_ragged_edge_results(View& Vc, const std::vector<subgroup_id_t>& subgroups);
 
     static bool suspected_not_equal(const DerechoSST& gmsSST, const std::vector<bool>& old);
     static void copy_suspected(const DerechoSST& gmsSST, std::vector<bool>& old);
@@ -374,11 +391,16 @@ public:
                              int pause_sending_turns = 0, bool cooked_send = false,
                              bool null_send = false);
     /** Instructs the managed DerechoGroup's to send the next message. This
-     * returns immediately; the send is scheduled to happen some time in the future. */
-    void send(subgroup_id_t subgroup_num);
+     * returns immediately; the send is scheduled to happen some time in the future.
+     * If a completion is given, it follows the message through its milestones. */
+    void send(subgroup_id_t subgroup_num, std::shared_ptr<CompletionState> completion = nullptr);
 
     const uint64_t compute_global_stability_frontier(subgroup_id_t subgroup_num);
 
+    /** @return the number of acknowledgement puts per SST message this node
+     * has received in the subgroup, in the current view. */
+    double get_acks_per_message(subgroup_id_t subgroup_num);
+
     /**
      * @return a reference to the current View, wrapped in a container that
      * holds a read-lock on it. This is mostly here to make it easier for
@@ -4,6 +4,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include "util.hpp"
@@ -621,6 +622,45 @@ namespace persistent{
     dbg_trace("{0} trim at time: {1}.{2}...done",this->m_sName,hlc.m_rtc_us,hlc.m_logic);
   }
 
+  void FilePersistLog::truncate(const int64_t &ver) noexcept(false) {
+    dbg_trace("{0} truncate at version: {1}",this->m_sName,ver);
+    FPL_WRLOCK;
+    // keep the entries up to and including the latest one no later than ver
+    int64_t new_tail = META_HEADER->fields.head;
+    if (ver != INVALID_VERSION) {
+      int64_t idx = binarySearch<int64_t>(
+        [&](const LogEntry * ple){return ple->fields.ver;},
+        ver,META_HEADER->fields.head,META_HEADER->fields.tail);
+      if (idx != -1) {
+        new_tail = idx + 1;
+      }
+    }
+    if (new_tail == META_HEADER->fields.tail && META_HEADER->fields.ver <= ver) {
+      FPL_UNLOCK;
+      return;
+    }
+    for (auto itr = this->hidx.begin(); itr != this->hidx.end();) {
+      if (itr->log_idx >= new_tail) {
+        itr = this->hidx.erase(itr);
+      } else {
+        itr ++;
+      }
+    }
+    META_HEADER->fields.tail = new_tail;
+    META_HEADER->fields.ver = ver;
+    FPL_PERS_LOCK;
+    try {
+      persist(true);
+    } catch (uint64_t e) {
+      FPL_UNLOCK;
+      FPL_PERS_UNLOCK;
+      throw e;
+    }
+    FPL_PERS_UNLOCK;
+    FPL_UNLOCK;
+    dbg_trace("{0} truncate at version: {1}...done",this->m_sName,ver);
+  }
+
   void FilePersistLog::persistMetaHeaderAtomically(MetaHeader *pShadowHeader) noexcept(false) {
     // STEP 1: get file name
     const string swpFile = this->m_sMetaFile + "." + SWAP_FILE_SUFFIX;
@@ -691,15 +731,18 @@ namespace persistent{
   }
 
   // format for the logs:
-  // [latest_version(int64_t)][nr_log_entry(int64_t)][log_enty1][log_entry2]...
-  // the log entry is from the earliest to the latest.
+  // [truncate_version(int64_t)][latest_version(int64_t)][nr_log_entry(int64_t)][log_enty1][log_entry2]...
+  // the log entry is from the earliest to the latest. truncate_version is the
+  // requested version, or our latest version if the requester claims a later
+  // one. The receiver drops its own entries after truncate_version before
+  // merging: they are either repeated in the tail or were never in our log.
   // two functions for serialization/deserialization for log entries:
   // 1) size_t byteSizeOfLogEntry(const LogEntry * ple);
   // 2) size_t writeLogEntryToByteArray(const LogEntry * ple, char * ba);
   // 3) size_t postLogEntry(const std::function<void (char const *const, std::size_t)> f, const LogEntry *ple);
   // 4) size_t mergeLogEntryFromByteArray(const char * ba);
   size_t FilePersistLog::bytes_size(const int64_t &ver) noexcept(false) {
-    size_t bsize = (sizeof(int64_t) + sizeof(int64_t));
+    size_t bsize = (sizeof(int64_t) + sizeof(int64_t) + sizeof(int64_t));
     int64_t idx = this->getMinimumIndexBeyondVersion(ver);
     if(idx != INVALID_INDEX) {
       while(idx < META_HEADER->fields.tail) {
@@ -713,8 +756,11 @@ namespace persistent{
   size_t FilePersistLog::to_bytes(char *buf, const int64_t &ver) noexcept(false) {
     int64_t idx = this->getMinimumIndexBeyondVersion(ver);
     size_t ofst = 0;
-    // latest_version
     int64_t latest_version = this->getLatestVersion();
+    // truncate_version
+    *(int64_t*)(buf+ofst) = std::min(ver,latest_version);
+    ofst += sizeof(int64_t);
+    // latest_version
     *(int64_t*)(buf+ofst) = latest_version;
     ofst += sizeof(int64_t);
     // nr_log_entry
@@ -733,8 +779,11 @@ namespace persistent{
   void FilePersistLog::post_object(const std::function<void (char const *const, std::size_t)> &f,
     const int64_t &ver) noexcept(false) {
     int64_t idx = this->getMinimumIndexBeyondVersion(ver);
-    // latest_version
     int64_t latest_version = this->getLatestVersion();
+    // truncate_version
+    int64_t truncate_version = std::min(ver,latest_version);
+    f((char *)&truncate_version,sizeof(int64_t));
+    // latest_version
     f((char *)&latest_version,sizeof(int64_t));
     // nr_log_entry
     int64_t nr_log_entry = (idx == INVALID_INDEX)?0:(META_HEADER->fields.tail - idx);
@@ -750,6 +799,10 @@ namespace persistent{
 
   void FilePersistLog::applyLogTail(char const *v) noexcept(false) {
     size_t ofst = 0;
+    // truncate_version
+    int64_t truncate_version = *(const int64_t*)(v+ofst);
+    ofst += sizeof(int64_t);
+    this->truncate(truncate_version);
     // latest_version
     int64_t latest_version = *(const int64_t*)(v+ofst);
     ofst += sizeof(int64_t);
@@ -1,16 +1,12 @@
 #include <time.h>
 #include <errno.h>
 #include "HLC.hpp"
+#include "time/time.h"
 
 // return microsecond
 uint64_t read_rtc_us () 
   noexcept(false) {
-  struct timespec tp;
-  if ( clock_gettime(CLOCK_REALTIME,&tp) != 0 ) {
-    throw HLC_EXP_READ_RTC(errno);
-  } else {
-    return (uint64_t)tp.tv_sec*1000000 + tp.tv_nsec/1000;
-  }
+  return get_walltime()/1000;
 }
 
 HLC::HLC () 
@@ -152,6 +152,14 @@ namespace persistent {
      */
     virtual void trim(const HLC & hlc) noexcept(false) = 0;
 
+    /**
+     * Truncate the log after a version: drop all log entries later than ver.
+     * This is the opposite end of the log from trim().
+     * @param ver - the latest version to keep. INVALID_VERSION drops all
+     *   entries.
+     */
+    virtual void truncate(const int64_t & ver) noexcept(false) = 0;
+
     /**
      * Calculate the byte size required for serialization
      * @PARAM ver - from which version the detal begins(tail log) 
@@ -177,7 +185,9 @@ namespace persistent {
                              const int64_t &ver) = 0;
 
     /**
-     * Check/Merge the LogTail to the existing log.
+     * Check/Merge the LogTail to the existing log. Local entries after the
+     * version the tail was serialized from are truncated first, since the
+     * tail either repeats them or replaces them.
      * @PARAM dsm - deserialization manager
      * @PARAM v - serialized log bytes to be apllied
      */
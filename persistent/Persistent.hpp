@@ -721,32 +721,52 @@ using version_t = int64_t;
       // Serialization and Deserialization of Persistent<T>
       // Serialization of the persistent<T> is packed in the following order
       // 1) the log name
-      // 2) current state of the object
-      // 3) number of log entries
-      // 4) the log entries from the earliest to the latest
+      // 2) whether the current state of the object follows
+      // 3) current state of the object, if it follows
+      // 4) number of log entries
+      // 5) the log entries from the earliest to the latest
       // TODO.
       //Note: this rely on PersistentRegistry::earliest_version_to_serialize
+      // The current state is left out when the receiver asked for the log
+      // after some version: the receiver has the log up to that version, so
+      // once the tail is merged its latest log entry is our current state.
+      // Each log entry holds the whole object, so this only needs our log to
+      // be non-empty.
+      bool isStateSerialized() const {
+          return PersistentRegistry::getEarliestVersionToSerialize() == INVALID_VERSION ||
+              this->m_pLog->getLength() == 0;
+      }
       std::size_t to_bytes(char* ret) const {
           std::size_t sz = 0; 
+          const bool with_state = isStateSerialized();
           // object name
           dbg_trace("{0}[{1}] object_name starts at {2}",this->m_pLog->m_sName,__func__,sz);
           sz += mutils::to_bytes(this->m_pLog->m_sName,ret+sz);
           // wrapped object
           dbg_trace("{0}[{1}] wrapped_object starts at {2}",this->m_pLog->m_sName,__func__,sz);
-          sz += mutils::to_bytes(*this->m_pWrappedObject,ret+sz);
+          sz += mutils::to_bytes(with_state,ret+sz);
+          if (with_state) {
+            sz += mutils::to_bytes(*this->m_pWrappedObject,ret+sz);
+          }
           // and the log
           dbg_trace("{0}[{1}] log starts at {2}",this->m_pLog->m_sName,__func__,sz);
           sz += this->m_pLog->to_bytes(ret+sz,PersistentRegistry::getEarliestVersionToSerialize());
           return sz;
       }
       std::size_t bytes_size() const {
-          return mutils::bytes_size(this->m_pLog->m_sName) + mutils::bytes_size(*this->m_pWrappedObject) + 
+          const bool with_state = isStateSerialized();
+          return mutils::bytes_size(this->m_pLog->m_sName) + mutils::bytes_size(with_state) +
+              (with_state ? mutils::bytes_size(*this->m_pWrappedObject) : 0) +
               this->m_pLog->bytes_size(PersistentRegistry::getEarliestVersionToSerialize());
       }
       void post_object(const std::function<void (char const * const, std::size_t)> &f)
       const {
+          const bool with_state = isStateSerialized();
           mutils::post_object(f, this->m_pLog->m_sName);
-          mutils::post_object(f,*this->m_pWrappedObject);
+          mutils::post_object(f, with_state);
+          if (with_state) {
+            mutils::post_object(f,*this->m_pWrappedObject);
+          }
           this->m_pLog->post_object(f,PersistentRegistry::getEarliestVersionToSerialize());
       }
       // NOTE: we do not set up the registry here. This will only happen in the
@@ -758,8 +778,14 @@ using version_t = int64_t;
           ofst += mutils::bytes_size(*obj_name);
 
           dbg_trace("{0} wrapped_obj is loaded at {1}", __func__, ofst);
-          auto wrapped_obj = mutils::from_bytes<ObjectType>(dsm, v+ofst);
-          ofst += mutils::bytes_size(*wrapped_obj);
+          bool with_state = *mutils::from_bytes<bool>(dsm, v+ofst);
+          ofst += mutils::bytes_size(with_state);
+          // without it, the constructor rebuilds the state from the local log
+          std::unique_ptr<ObjectType> wrapped_obj;
+          if (with_state) {
+            wrapped_obj = mutils::from_bytes<ObjectType>(dsm, v+ofst);
+            ofst += mutils::bytes_size(*wrapped_obj);
+          }
 
           dbg_trace("{0} log is loaded at {1}", __func__, ofst);
           PersistentRegistry * pr = nullptr;
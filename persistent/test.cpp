@@ -258,7 +258,8 @@ int main(int argc,char ** argv){
       }
       PersistentRegistry::setEarliestVersionToSerialize(ver);
       ssize_t ds1 = npx_logtail.bytes_size();
-      ssize_t prefix = mutils::bytes_size(npx_logtail.getObjectName()) + mutils::bytes_size(*npx_logtail);
+      ssize_t prefix = mutils::bytes_size(npx_logtail.getObjectName()) + mutils::bytes_size(true) +
+        (npx_logtail.isStateSerialized() ? mutils::bytes_size(*npx_logtail) : 0);
       char * buf = (char *)malloc(ds1);
       if (buf == NULL) {
         cerr<<"faile to allocate "<<ds1<<" bytes for serialized data. prefix="<<prefix << " bytes"<<endl;
@@ -480,8 +480,9 @@ void test_cross_channel() {
     static volatile atomic<bool> done_flag;
     done_flag = false;
 
-    auto nop_handler = [](auto, auto, auto) {};
-    auto done_handler = [](uint64_t tag, uint32_t immediate, size_t length) {
+    auto nop_handler = [](auto&, auto, auto, auto) {};
+    auto done_handler = [](rdma::transport_context&, uint64_t tag,
+                           uint32_t immediate, size_t length) {
         if(tag == 0x6000000) done_flag = true;
     };
 
@@ -4,17 +4,13 @@
 #include "util.h"
 
 #include <cassert>
+#include <condition_variable>
 #include <cstring>
 
 using namespace std;
 using namespace rdma;
 using namespace rdmc;
 
-namespace rdmc {
-extern map<uint16_t, shared_ptr<group>> groups;
-extern mutex groups_lock;
-};
-
 decltype(polling_group::message_types) polling_group::message_types;
 
 group::group(uint16_t _group_number, size_t _block_size,
@@ -33,28 +29,31 @@ group::group(uint16_t _group_number, size_t _block_size,
 group::~group() { unique_lock<mutex> lock(monitor); }
 
 void polling_group::initialize_message_types() {
-    auto find_group = [](uint16_t group_number) {
-        unique_lock<mutex> lock(groups_lock);
-        auto it = groups.find(group_number);
-        return it != groups.end() ? it->second : nullptr;
+    auto find_group = [](transport_context& context, uint16_t group_number) {
+        unique_lock<mutex> lock(context.groups_lock);
+        context.groups_connected.wait(lock, [&context, group_number]() {
+            return context.groups_connecting.count(group_number) == 0;
+        });
+        auto it = context.groups.find(group_number);
+        return it != context.groups.end() ? it->second : nullptr;
     };
-    auto send_data_block = [find_group](uint64_t tag, uint32_t immediate,
-                                        size_t length) {
+    auto send_data_block = [find_group](transport_context& context, uint64_t tag,
+                                        uint32_t immediate, size_t length) {
         ParsedTag parsed_tag = parse_tag(tag);
-        shared_ptr<group> g = find_group(parsed_tag.group_number);
+        shared_ptr<group> g = find_group(context, parsed_tag.group_number);
         if(g) g->complete_block_send();
     };
-    auto receive_data_block = [find_group](uint64_t tag, uint32_t immediate,
-                                           size_t length) {
+    auto receive_data_block = [find_group](transport_context& context, uint64_t tag,
+                                           uint32_t immediate, size_t length) {
         ParsedTag parsed_tag = parse_tag(tag);
-        shared_ptr<group> g = find_group(parsed_tag.group_number);
+        shared_ptr<group> g = find_group(context, parsed_tag.group_number);
         if(g) g->receive_block(immediate, length);
     };
-    auto send_ready_for_block = [](uint64_t, uint32_t, size_t) {};
+    auto send_ready_for_block = [](transport_context&, uint64_t, uint32_t, size_t) {};
     auto receive_ready_for_block = [find_group](
-            uint64_t tag, uint32_t immediate, size_t length) {
+            transport_context& context, uint64_t tag, uint32_t immediate, size_t length) {
         ParsedTag parsed_tag = parse_tag(tag);
-        shared_ptr<group> g = find_group(parsed_tag.group_number);
+        shared_ptr<group> g = find_group(context, parsed_tag.group_number);
         if(g) g->receive_ready_for_block(immediate, parsed_tag.target);
     };
 
@@ -62,19 +61,24 @@ void polling_group::initialize_message_types() {
     message_types.ready_for_block = message_type(
             "rdmc.ready_for_block", send_ready_for_block, receive_ready_for_block);
 }
-polling_group::polling_group(uint16_t _group_number, size_t _block_size,
+polling_group::polling_group(std::shared_ptr<transport_context> _context,
+                             uint16_t _group_number, size_t _block_size,
                              vector<uint32_t> _members, uint32_t _member_index,
                              incoming_message_callback_t upcall,
                              completion_callback_t callback,
-                             unique_ptr<schedule> _schedule)
+                             unique_ptr<schedule> _schedule,
+                             uint32_t _tcp_port)
         : group(_group_number, _block_size, _members, _member_index, upcall,
                 callback, std::move(_schedule)),
-          first_block_buffer(nullptr) {
+          first_block_buffer(nullptr),
+          context(std::move(_context)),
+          tcp_port(_tcp_port) {
     if(member_index != 0) {
         first_block_buffer = unique_ptr<char[]>(new char[block_size]);
         memset(first_block_buffer.get(), 0, block_size);
 
-        first_block_mr = make_unique<memory_region>(first_block_buffer.get(), block_size);
+        first_block_mr = make_unique<memory_region>(*context, first_block_buffer.get(),
+                                                    block_size);
     }
 
     auto connections = transfer_schedule->get_connections();
@@ -419,14 +423,16 @@ void polling_group::post_recv(schedule::block_transfer transfer) {
               "posted_receive_buffer");
 }
 void polling_group::connect(uint32_t neighbor) {
-    queue_pairs.emplace(neighbor, queue_pair(members[neighbor]));
+    queue_pairs.emplace(neighbor, queue_pair(*context, members[neighbor],
+                                             [](rdma::queue_pair*) {}, tcp_port));
 
     auto post_recv = [this, neighbor](rdma::queue_pair* qp) {
         qp->post_empty_recv(form_tag(group_number, neighbor),
                             message_types.ready_for_block);
     };
 
-    rfb_queue_pairs.emplace(neighbor, queue_pair(members[neighbor], post_recv));
+    rfb_queue_pairs.emplace(neighbor, queue_pair(*context, members[neighbor], post_recv,
+                                                 tcp_port));
 }
 void polling_group::send_ready_for_block(uint32_t neighbor) {
     auto it = rfb_queue_pairs.find(neighbor);
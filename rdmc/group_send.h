@@ -82,6 +82,10 @@ private:
     // maps from member_indices to the queue pairs
     map<size_t, rdma::queue_pair> queue_pairs;
     map<size_t, rdma::queue_pair> rfb_queue_pairs;
+    // the context whose connections and completion queue the queue pairs use
+    std::shared_ptr<rdma::transport_context> context;
+    // the port of the TCP connections used to set up the queue pairs
+    uint32_t tcp_port;
 
     static struct {
         rdma::message_type data_block;
@@ -91,11 +95,13 @@ private:
 public:
     static void initialize_message_types();
 
-    polling_group(uint16_t group_number, size_t block_size,
+    polling_group(std::shared_ptr<rdma::transport_context> context,
+                  uint16_t group_number, size_t block_size,
                   vector<uint32_t> members, uint32_t member_index,
                   incoming_message_callback_t upcall,
                   completion_callback_t callback,
-                  unique_ptr<schedule> transfer_schedule);
+                  unique_ptr<schedule> transfer_schedule,
+                  uint32_t tcp_port);
 
     virtual void receive_block(uint32_t send_imm, size_t size);
     virtual void receive_ready_for_block(uint32_t step, uint32_t sender);
@@ -8,6 +8,7 @@
 
 #include <atomic>
 #include <cmath>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdio>
 #include <map>
@@ -22,88 +23,142 @@ using namespace std;
 using namespace rdma;
 
 namespace rdmc {
-uint32_t node_rank;
 atomic<bool> shutdown_flag;
 
-// map from group number to group
-map<uint16_t, shared_ptr<group>> groups;
-mutex groups_lock;
+static once_flag message_types_initialized;
 
-bool initialize(const map<uint32_t, string>& addresses, uint32_t _node_rank) {
+bool initialize(const map<uint32_t, string>& addresses, uint32_t node_rank,
+                uint32_t tcp_port) {
     if(shutdown_flag) return false;
 
-    node_rank = _node_rank;
-    if(!::rdma::impl::verbs_initialize(addresses, node_rank)) {
+    if(!transport_context::get(node_rank)->initialize(addresses, tcp_port)) {
         return false;
     }
 
-    polling_group::initialize_message_types();
+    call_once(message_types_initialized, polling_group::initialize_message_types);
     return true;
 }
-void add_address(uint32_t index, const string& address) {
-    ::rdma::impl::verbs_add_connection(index, address, node_rank);
+void add_address(transport_context& context, uint32_t index,
+                 const string& address, uint32_t tcp_port) {
+    context.add_connection(index, address, tcp_port);
+}
+void add_address(uint32_t index, const string& address, uint32_t tcp_port) {
+    add_address(*transport_context::get_default(), index, address, tcp_port);
 }
 
-bool create_group(uint16_t group_number, std::vector<uint32_t> members,
-                  size_t block_size, send_algorithm algorithm,
+uint16_t new_group_number(transport_context& context) {
+    unique_lock<mutex> lock(context.groups_lock);
+    while(context.groups.count(context.next_group_number)
+          || context.groups_connecting.count(context.next_group_number)) {
+        ++context.next_group_number;
+    }
+    return context.next_group_number++;
+}
+uint16_t new_group_number() {
+    return new_group_number(*transport_context::get_default());
+}
+
+bool create_group(shared_ptr<transport_context> context, uint16_t group_number,
+                  std::vector<uint32_t> members, size_t block_size,
+                  send_algorithm algorithm,
                   incoming_message_callback_t incoming_upcall,
                   completion_callback_t callback,
-                  failure_callback_t failure_callback) {
+                  failure_callback_t failure_callback,
+                  uint32_t tcp_port) {
     if(shutdown_flag) return false;
 
-    schedule* send_schedule;
-    uint32_t member_index = index_of(members, node_rank);
+    unique_ptr<schedule> send_schedule;
+    uint32_t member_index = index_of(members, context->node_rank);
     if(algorithm == BINOMIAL_SEND) {
-        send_schedule = new binomial_schedule(members.size(), member_index);
+        send_schedule.reset(new binomial_schedule(members.size(), member_index));
     } else if(algorithm == SEQUENTIAL_SEND) {
-        send_schedule = new sequential_schedule(members.size(), member_index);
+        send_schedule.reset(new sequential_schedule(members.size(), member_index));
     } else if(algorithm == CHAIN_SEND) {
-        send_schedule = new chain_schedule(members.size(), member_index);
+        send_schedule.reset(new chain_schedule(members.size(), member_index));
     } else if(algorithm == TREE_SEND) {
-        send_schedule = new tree_schedule(members.size(), member_index);
+        send_schedule.reset(new tree_schedule(members.size(), member_index));
     } else {
         puts("Unsupported group type?!");
         fflush(stdout);
         return false;
     }
 
-    unique_lock<mutex> lock(groups_lock);
-    auto g = make_shared<polling_group>(group_number, block_size, members,
-                                        member_index, incoming_upcall, callback,
-                                        unique_ptr<schedule>(send_schedule));
-    auto p = groups.emplace(group_number, std::move(g));
-    return p.second;
+    {
+        unique_lock<mutex> lock(context->groups_lock);
+        if(context->groups.count(group_number)
+           || !context->groups_connecting.insert(group_number).second) {
+            return false;
+        }
+    }
+    // Connect without holding groups_lock, so that groups being created at
+    // the same time by other threads do not wait for this one's members.
+    shared_ptr<group> g;
+    try {
+        g = make_shared<polling_group>(context, group_number, block_size,
+                                       members, member_index, incoming_upcall,
+                                       callback, std::move(send_schedule),
+                                       tcp_port);
+    } catch(...) {
+        unique_lock<mutex> lock(context->groups_lock);
+        context->groups_connecting.erase(group_number);
+        context->groups_connected.notify_all();
+        throw;
+    }
+    unique_lock<mutex> lock(context->groups_lock);
+    context->groups_connecting.erase(group_number);
+    context->groups.emplace(group_number, std::move(g));
+    context->groups_connected.notify_all();
+    return true;
+}
+bool create_group(uint16_t group_number, std::vector<uint32_t> members,
+                  size_t block_size, send_algorithm algorithm,
+                  incoming_message_callback_t incoming_upcall,
+                  completion_callback_t callback,
+                  failure_callback_t failure_callback,
+                  uint32_t tcp_port) {
+    return create_group(transport_context::get_default(), group_number,
+                        std::move(members), block_size, algorithm,
+                        incoming_upcall, callback, failure_callback, tcp_port);
 }
 
-void destroy_group(uint16_t group_number) {
+void destroy_group(transport_context& context, uint16_t group_number) {
     if(shutdown_flag) return;
 
-    unique_lock<mutex> lock(groups_lock);
+    unique_lock<mutex> lock(context.groups_lock);
     LOG_EVENT(group_number, -1, -1, "destroy_group");
-    groups.erase(group_number);
+    context.groups.erase(group_number);
+}
+void destroy_group(uint16_t group_number) {
+    destroy_group(*transport_context::get_default(), group_number);
 }
 void shutdown() { shutdown_flag = true; }
-bool send(uint16_t group_number, shared_ptr<memory_region> mr, size_t offset,
-          size_t length) {
+bool send(transport_context& context, uint16_t group_number,
+          shared_ptr<memory_region> mr, size_t offset, size_t length) {
     if(shutdown_flag) return false;
 
     shared_ptr<group> g;
     {
-        unique_lock<mutex> lock(groups_lock);
-        auto it = groups.find(group_number);
-        if(it == groups.end()) return false;
+        unique_lock<mutex> lock(context.groups_lock);
+        auto it = context.groups.find(group_number);
+        if(it == context.groups.end()) return false;
         g = it->second;
     }
     LOG_EVENT(group_number, -1, -1, "preparing_to_send_message");
     g->send_message(mr, offset, length);
     return true;
 }
+bool send(uint16_t group_number, shared_ptr<memory_region> mr, size_t offset,
+          size_t length) {
+    return send(*transport_context::get_default(), group_number, mr, offset,
+                length);
+}
 void query_addresses(std::map<uint32_t, std::string>& addresses,
                      uint32_t& node_rank) {
     query_peer_addresses(addresses, node_rank);
 }
 
-barrier_group::barrier_group(vector<uint32_t> members) {
+barrier_group::barrier_group(vector<uint32_t> members)
+        : node_rank(transport_context::get_default()->node_rank) {
     member_index = index_of(members, node_rank);
     group_size = members.size();
 
@@ -39,13 +39,39 @@ typedef std::function<void(char* buffer, size_t size)> completion_callback_t;
 typedef std::function<void(std::experimental::optional<uint32_t> suspected_victim)>
         failure_callback_t;
 
+/**
+ * Connects to the given nodes over TCP on tcp_port and sets up RDMA in the
+ * transport context of node_rank. It may be called again, for instance by
+ * another Derecho group in the same process, to connect to more nodes on
+ * another port. Calls with the same node_rank share one RDMA device, polling
+ * thread and set of groups; calls with different node ranks get separate
+ * contexts, so one process can run several nodes.
+ *
+ * The functions below that do not take a context use the default one, which
+ * is the first context created in this process.
+ */
 bool initialize(const std::map<uint32_t, std::string>& addresses,
-                uint32_t node_rank) __attribute__((warn_unused_result));
-void add_address(uint32_t index, const std::string& address);
+                uint32_t node_rank, uint32_t tcp_port = derecho::rdmc_tcp_port)
+        __attribute__((warn_unused_result));
+void add_address(rdma::transport_context& context, uint32_t index,
+                 const std::string& address,
+                 uint32_t tcp_port = derecho::rdmc_tcp_port);
+void add_address(uint32_t index, const std::string& address,
+                 uint32_t tcp_port = derecho::rdmc_tcp_port);
 void shutdown();
 
+/**
+ * @return a group number that no existing group in the context uses and
+ * that no earlier call has returned recently, so callers creating groups at
+ * the same time do not collide.
+ */
+uint16_t new_group_number(rdma::transport_context& context);
+uint16_t new_group_number();
+
 /**
  * Creates a new RDMC group.
+ * @param context The context of the node creating the group, whose
+ * connections the group uses and whose groups it joins.
  * @param group_number The group's unique identifier.
  * @param members A vector of node IDs representing the members of this group.
  * The order of this vector will be used as the rank order of the members.
@@ -59,16 +85,31 @@ void shutdown();
  * message in this group
  * @param failure_callback The function to call when RDMC detects a failure in
  * this group. It will be called with the suspected failed node's ID.
+ * @param tcp_port The port of the connections, made by initialize or
+ * add_address, used to connect to the members.
  * @return True if group creation succeeds, false if it fails.
  */
+bool create_group(std::shared_ptr<rdma::transport_context> context,
+                  uint16_t group_number, std::vector<uint32_t> members,
+                  size_t block_size, send_algorithm algorithm,
+                  incoming_message_callback_t incoming_receive,
+                  completion_callback_t send_callback,
+                  failure_callback_t failure_callback,
+                  uint32_t tcp_port = derecho::rdmc_tcp_port)
+        __attribute__((warn_unused_result));
 bool create_group(uint16_t group_number, std::vector<uint32_t> members,
                   size_t block_size, send_algorithm algorithm,
                   incoming_message_callback_t incoming_receive,
                   completion_callback_t send_callback,
-                  failure_callback_t failure_callback)
+                  failure_callback_t failure_callback,
+                  uint32_t tcp_port = derecho::rdmc_tcp_port)
         __attribute__((warn_unused_result));
+void destroy_group(rdma::transport_context& context, uint16_t group_number);
 void destroy_group(uint16_t group_number);
 
+bool send(rdma::transport_context& context, uint16_t group_number,
+          std::shared_ptr<rdma::memory_region> mr, size_t offset,
+          size_t length) __attribute__((warn_unused_result));
 bool send(uint16_t group_number, std::shared_ptr<rdma::memory_region> mr,
           size_t offset, size_t length) __attribute__((warn_unused_result));
 
@@ -101,7 +142,9 @@ class barrier_group {
     // Lock to ensure that only one barrier is in flight at a time.
     std::mutex lock;
 
-    // Index of this node in the list of members
+    // ID of this node, in the default context, and its index in the list of
+    // members
+    const uint32_t node_rank;
     uint32_t member_index;
     uint32_t group_size;
 
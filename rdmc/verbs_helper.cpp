@@ -9,6 +9,7 @@
 #include <vector>
 
 #include "derecho/derecho_ports.h"
+#include "derecho/placement.h"
 #include "tcp/tcp.h"
 #include "util.h"
 #include "verbs_helper.h"
@@ -38,12 +39,6 @@ struct cm_con_data_t {
     uint8_t gid[16];  // gid
 } __attribute__((packed));
 
-// sockets for each connection
-static map<uint32_t, tcp::socket> sockets;
-
-// listener to detect new incoming connections
-static unique_ptr<tcp::connection_listener> connection_listener;
-
 static config_t local_config;
 
 // structure of system resources
@@ -54,7 +49,7 @@ struct ibv_resources {
     ibv_pd *pd;                   // PD handle
     ibv_cq *cq;                   // CQ handle
     ibv_comp_channel *cc;         // Completion channel
-} verbs_resources;
+};
 
 struct completion_handler_set {
     completion_handler send;
@@ -65,14 +60,21 @@ struct completion_handler_set {
 static vector<completion_handler_set> completion_handlers;
 static std::mutex completion_handlers_mutex;
 
+// guards contexts and default_context
+static std::mutex contexts_mutex;
+// the context of each node in this process, keyed by node id
+static map<uint32_t, shared_ptr<transport_context>> contexts;
+// the first context created, used by the functions that do not take one
+static shared_ptr<transport_context> default_context;
+
 static atomic<bool> interrupt_mode;
 static atomic<bool> contiguous_memory_mode;
 
 static feature_set supported_features;
 
-static atomic<bool> polling_loop_shutdown_flag;
-static void polling_loop() {
+void transport_context::polling_loop() {
     pthread_setname_np(pthread_self(), "rdmc_poll");
+    derecho::pin_thread(derecho::ThreadRole::RDMC_POLL);
     TRACE("Spawned main loop");
 
     const int max_work_completions = 1024;
@@ -85,20 +87,20 @@ static void polling_loop() {
             uint64_t poll_end = get_time() + (interrupt_mode ? 0L : 50000000L);
             do {
                 if(polling_loop_shutdown_flag) return;
-                num_completions = ibv_poll_cq(verbs_resources.cq, max_work_completions,
+                num_completions = ibv_poll_cq(verbs_resources->cq, max_work_completions,
                                               work_completions.get());
             } while(num_completions == 0 && get_time() < poll_end);
 
             if(num_completions == 0) {
-                if(ibv_req_notify_cq(verbs_resources.cq, 0))
+                if(ibv_req_notify_cq(verbs_resources->cq, 0))
                     throw rdma::exception();
 
-                num_completions = ibv_poll_cq(verbs_resources.cq, max_work_completions,
+                num_completions = ibv_poll_cq(verbs_resources->cq, max_work_completions,
                                               work_completions.get());
 
                 if(num_completions == 0) {
                     pollfd file_descriptor;
-                    file_descriptor.fd = verbs_resources.cc->fd;
+                    file_descriptor.fd = verbs_resources->cc->fd;
                     file_descriptor.events = POLLIN;
                     file_descriptor.revents = 0;
                     int rc = 0;
@@ -110,7 +112,7 @@ static void polling_loop() {
                     if(rc > 0) {
                         ibv_cq *ev_cq;
                         void *ev_ctx;
-                        ibv_get_cq_event(verbs_resources.cc, &ev_cq, &ev_ctx);
+                        ibv_get_cq_event(verbs_resources->cc, &ev_cq, &ev_ctx);
                         ibv_ack_cq_events(ev_cq, 1);
                     }
                 }
@@ -151,13 +153,13 @@ static void polling_loop() {
             } else if(wc.status != 0) {
                 // Failed operation
             } else if(wc.opcode == IBV_WC_SEND) {
-                completion_handlers[type].send(masked_wr_id, wc.imm_data,
+                completion_handlers[type].send(*this, masked_wr_id, wc.imm_data,
                                                wc.byte_len);
             } else if(wc.opcode == IBV_WC_RECV) {
-                completion_handlers[type].recv(masked_wr_id, wc.imm_data,
+                completion_handlers[type].recv(*this, masked_wr_id, wc.imm_data,
                                                wc.byte_len);
             } else if(wc.opcode == IBV_WC_RDMA_WRITE) {
-                completion_handlers[type].write(masked_wr_id, wc.imm_data,
+                completion_handlers[type].write(*this, masked_wr_id, wc.imm_data,
                                                 wc.byte_len);
             } else {
                 puts("Sent unrecognized completion type?!");
@@ -183,13 +185,13 @@ static int modify_qp_to_init(struct ibv_qp *qp, int ib_port) {
 
 static int modify_qp_to_rtr(struct ibv_qp *qp, uint32_t remote_qpn,
                             uint16_t dlid, uint8_t *dgid, int ib_port,
-                            int gid_idx) {
+                            int gid_idx, ibv_mtu path_mtu) {
     struct ibv_qp_attr attr;
     int flags;
     int rc;
     memset(&attr, 0, sizeof(attr));
     attr.qp_state = IBV_QPS_RTR;
-    attr.path_mtu = verbs_resources.port_attr.active_mtu;
+    attr.path_mtu = path_mtu;
     attr.dest_qp_num = remote_qpn;
     attr.rq_psn = 0;
     attr.max_dest_rd_atomic = 1;
@@ -231,43 +233,137 @@ static int modify_qp_to_rts(struct ibv_qp *qp) {
     return rc;
 }
 
-namespace impl {
-void verbs_destroy() {
-    if(verbs_resources.cq && ibv_destroy_cq(verbs_resources.cq)) {
+transport_context::transport_context(uint32_t node_rank) : node_rank(node_rank) {}
+
+transport_context::~transport_context() {
+    polling_loop_shutdown_flag = true;
+    if(polling_thread.joinable()) {
+        polling_thread.join();
+    }
+}
+
+shared_ptr<transport_context> transport_context::get(uint32_t node_rank) {
+    std::lock_guard<std::mutex> lock(contexts_mutex);
+    shared_ptr<transport_context> &context = contexts[node_rank];
+    if(!context) {
+        context = make_shared<transport_context>(node_rank);
+        if(!default_context) default_context = context;
+    }
+    return context;
+}
+
+shared_ptr<transport_context> transport_context::get_default() {
+    std::lock_guard<std::mutex> lock(contexts_mutex);
+    return default_context;
+}
+
+transport_context::port_connections *transport_context::find_connections(
+        std::unique_lock<std::mutex> &lock, uint32_t tcp_port) {
+    connections_made.wait(lock, [this, tcp_port]() {
+        auto it = connections.find(tcp_port);
+        return it == connections.end() || !it->second.connecting;
+    });
+    auto it = connections.find(tcp_port);
+    return it != connections.end() ? &it->second : nullptr;
+}
+
+tcp::socket *transport_context::find_socket(uint32_t index, uint32_t tcp_port) {
+    std::unique_lock<std::mutex> lock(resources_mutex);
+    port_connections *port = find_connections(lock, tcp_port);
+    if(!port) return nullptr;
+    auto it = port->sockets.find(index);
+    return it != port->sockets.end() ? &it->second : nullptr;
+}
+
+void transport_context::destroy() {
+    std::lock_guard<std::mutex> lock(resources_mutex);
+    if(num_users == 0 || --num_users > 0) return;
+    // The polling thread sees this within one of its 50 ms sleeps, and must
+    // stop using the completion queue before it is destroyed
+    polling_loop_shutdown_flag = true;
+    if(polling_thread.joinable()) {
+        polling_thread.join();
+    }
+    if(verbs_resources->cq && ibv_destroy_cq(verbs_resources->cq)) {
         fprintf(stderr, "failed to destroy CQ\n");
     }
-    if(verbs_resources.cc && ibv_destroy_comp_channel(verbs_resources.cc)) {
+    if(verbs_resources->cc && ibv_destroy_comp_channel(verbs_resources->cc)) {
         fprintf(stderr, "failed to destroy Completion Channel\n");
     }
-    if(verbs_resources.pd && ibv_dealloc_pd(verbs_resources.pd)) {
+    if(verbs_resources->pd && ibv_dealloc_pd(verbs_resources->pd)) {
         fprintf(stderr, "failed to deallocate PD\n");
     }
-    if(verbs_resources.ib_ctx && ibv_close_device(verbs_resources.ib_ctx)) {
+    if(verbs_resources->ib_ctx && ibv_close_device(verbs_resources->ib_ctx)) {
         fprintf(stderr, "failed to close device context\n");
     }
 }
 
-bool verbs_initialize(const map<uint32_t, string> &node_addresses,
-                      uint32_t node_rank) {
-    memset(&verbs_resources, 0, sizeof(verbs_resources));
-
-    connection_listener = make_unique<tcp::connection_listener>(derecho::rdmc_tcp_port);
+bool transport_context::initialize(const map<uint32_t, string> &node_addresses,
+                                   uint32_t tcp_port) {
+    std::unique_lock<std::mutex> lock(resources_mutex);
+    // The device, protection domain, completion queue and polling thread are
+    // created by the first caller and shared by the rest.
+    if(num_users == 0 && !create_resources()) {
+        return false;
+    }
+    ++num_users;
 
     TRACE("Starting connection phase");
 
-    // Connect to other nodes in group. Since map traversal is ordered, we don't
-    // have to worry about circular waits, so deadlock can't occur.
-    for(auto it = node_addresses.begin(); it != node_addresses.end(); it++) {
-        if(it->first != node_rank) {
-            if(!verbs_add_connection(it->first, it->second, node_rank)) {
-                fprintf(stderr, "WARNING: failed to connect to node %d at %s\n",
-                        (int)it->first, it->second.c_str());
+    // The first call on a port leaves a placeholder while it connects, so
+    // later calls on that port wait for its connections and then connect
+    // only to the nodes it was not connected to.
+    auto inserted = connections.emplace(tcp_port, port_connections{});
+    if(!inserted.second) {
+        if(!find_connections(lock, tcp_port)) {
+            --num_users;
+            return false;
+        }
+        lock.unlock();
+        for(auto it = node_addresses.begin(); it != node_addresses.end(); it++) {
+            if(it->first != node_rank && !find_socket(it->first, tcp_port)) {
+                add_connection(it->first, it->second, tcp_port);
             }
         }
+    } else {
+        lock.unlock();
+        unique_ptr<tcp::connection_listener> listener;
+        map<uint32_t, tcp::socket> new_sockets;
+        try {
+            listener = make_unique<tcp::connection_listener>(tcp_port);
+            // Connect to all the other nodes in the group at once
+            new_sockets = tcp::establish_connections(node_rank, node_addresses,
+                                                     tcp_port, *listener);
+        } catch(...) {
+            lock.lock();
+            connections.erase(tcp_port);
+            --num_users;
+            connections_made.notify_all();
+            throw;
+        }
+        lock.lock();
+        port_connections &entry = connections.at(tcp_port);
+        entry.listener = std::move(listener);
+        entry.sockets = std::move(new_sockets);
+        entry.connecting = false;
+        connections_made.notify_all();
+        lock.unlock();
+    }
+    for(auto it = node_addresses.begin(); it != node_addresses.end(); it++) {
+        if(it->first != node_rank && !find_socket(it->first, tcp_port)) {
+            fprintf(stderr, "WARNING: failed to connect to node %d at %s\n",
+                    (int)it->first, it->second.c_str());
+        }
     }
     TRACE("Done connecting");
+    return true;
+}
 
-    auto res = &verbs_resources;
+bool transport_context::create_resources() {
+    verbs_resources = make_unique<ibv_resources>();
+    memset(verbs_resources.get(), 0, sizeof(ibv_resources));
+
+    auto res = verbs_resources.get();
 
     ibv_device **dev_list = NULL;
     ibv_device *ib_dev = NULL;
@@ -349,8 +445,8 @@ bool verbs_initialize(const map<uint32_t, string> &node_addresses,
         goto resources_create_exit;
     }
 
-    set_interrupt_mode(false);
-    set_contiguous_memory_mode(true);
+    impl::set_interrupt_mode(false);
+    impl::set_contiguous_memory_mode(true);
 
     // Initialize the ignored message type.
     (void)message_type::ignored();
@@ -369,10 +465,9 @@ bool verbs_initialize(const map<uint32_t, string> &node_addresses,
     }
 #endif
 
-    {
-        thread t(polling_loop);
-        t.detach();
-    }
+    // A later initialize, after the last destroy, starts a new polling thread
+    polling_loop_shutdown_flag = false;
+    polling_thread = thread(&transport_context::polling_loop, this);
 
     TRACE("verbs_initialize() - SUCCESS");
     return true;
@@ -400,55 +495,67 @@ resources_create_exit:
     }
     return false;
 }
-bool verbs_add_connection(uint32_t index, const string &address,
-                          uint32_t node_rank) {
+bool transport_context::add_connection(uint32_t index, const string &address,
+                                       uint32_t tcp_port) {
+    tcp::connection_listener *listener;
+    {
+        std::unique_lock<std::mutex> lock(resources_mutex);
+        port_connections *port = find_connections(lock, tcp_port);
+        if(!port) {
+            fprintf(stderr, "WARNING: no connections were set up on port %u\n",
+                    (unsigned int)tcp_port);
+            return false;
+        }
+        listener = port->listener.get();
+    }
     if(index < node_rank) {
-        if(sockets.count(index) > 0) {
+        if(find_socket(index, tcp_port)) {
             fprintf(stderr,
                     "WARNING: attempted to connect to node %u at %s:%d but we "
                     "already have a connection to a node with that index.",
-                    (unsigned int)index, address.c_str(), derecho::rdmc_tcp_port);
+                    (unsigned int)index, address.c_str(), tcp_port);
             return false;
         }
 
+        tcp::socket s;
         try {
-            sockets[index] = tcp::socket(address, derecho::rdmc_tcp_port);
+            s = tcp::socket(address, tcp_port);
         } catch(tcp::exception) {
             fprintf(stderr, "WARNING: failed to node %u at %s:%d",
-                    (unsigned int)index, address.c_str(), derecho::rdmc_tcp_port);
+                    (unsigned int)index, address.c_str(), tcp_port);
             return false;
         }
 
         // Make sure that the connection works, and that we've connected to the
         // right node.
         uint32_t remote_rank = 0;
-        if(!sockets[index].exchange(node_rank, remote_rank)) {
+        if(!s.exchange(node_rank, remote_rank)) {
             fprintf(stderr,
                     "WARNING: failed to exchange rank with node %u at %s:%d",
-                    (unsigned int)index, address.c_str(), derecho::rdmc_tcp_port);
-            sockets.erase(index);
+                    (unsigned int)index, address.c_str(), tcp_port);
             return false;
         } else if(remote_rank != index) {
             fprintf(stderr,
                     "WARNING: node at %s:%d replied with wrong rank (expected"
                     "%d but got %d)",
-                    address.c_str(), derecho::rdmc_tcp_port, (unsigned int)index,
+                    address.c_str(), tcp_port, (unsigned int)index,
                     (unsigned int)remote_rank);
-
-            sockets.erase(index);
             return false;
         }
+        std::lock_guard<std::mutex> lock(resources_mutex);
+        connections.at(tcp_port).sockets[index] = std::move(s);
         return true;
     } else if(index > node_rank) {
         try {
-            tcp::socket s = connection_listener->accept();
+            tcp::socket s = listener->accept();
 
             uint32_t remote_rank = 0;
             if(!s.exchange(node_rank, remote_rank)) {
                 fprintf(stderr, "WARNING: failed to exchange rank with node");
                 return false;
             } else {
-                sockets[remote_rank] = std::move(s);
+                std::lock_guard<std::mutex> lock(resources_mutex);
+                connections.at(tcp_port).sockets[remote_rank] = std::move(s);
                 return true;
             }
         } catch(tcp::exception) {
@@ -459,6 +566,20 @@ bool verbs_add_connection(uint32_t index, const string &address,
 
     return false;  // we can't connect to ourselves...
 }
+
+namespace impl {
+bool verbs_initialize(const map<uint32_t, string> &node_addresses,
+                      uint32_t node_rank, uint32_t tcp_port) {
+    return transport_context::get(node_rank)->initialize(node_addresses, tcp_port);
+}
+bool verbs_add_connection(uint32_t index, const string &address,
+                          uint32_t node_rank, uint32_t tcp_port) {
+    return transport_context::get(node_rank)->add_connection(index, address, tcp_port);
+}
+void verbs_destroy() {
+    auto context = transport_context::get_default();
+    if(context) context->destroy();
+}
 bool set_interrupt_mode(bool enabled) {
     interrupt_mode = enabled;
     return true;
@@ -474,13 +595,13 @@ bool set_contiguous_memory_mode(bool enabled) {
 }
 
 using ibv_mr_unique_ptr = unique_ptr<ibv_mr, std::function<void(ibv_mr *)>>;
-static ibv_mr_unique_ptr create_mr(char *buffer, size_t size) {
+static ibv_mr_unique_ptr create_mr(ibv_pd *pd, char *buffer, size_t size) {
     if(!buffer || size == 0) throw rdma::invalid_args();
 
     int mr_flags = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
 
     ibv_mr_unique_ptr mr = ibv_mr_unique_ptr(
-            ibv_reg_mr(verbs_resources.pd, (void *)buffer, size, mr_flags),
+            ibv_reg_mr(pd, (void *)buffer, size, mr_flags),
             [](ibv_mr *m) { ibv_dereg_mr(m); });
 
     if(!mr) {
@@ -489,11 +610,11 @@ static ibv_mr_unique_ptr create_mr(char *buffer, size_t size) {
     return mr;
 }
 #ifdef MELLANOX_EXPERIMENTAL_VERBS
-static ibv_mr_unique_ptr create_contiguous_mr(size_t size) {
+static ibv_mr_unique_ptr create_contiguous_mr(ibv_pd *pd, size_t size) {
     if(size == 0) throw rdma::invalid_args();
 
     ibv_exp_reg_mr_in in;
-    in.pd = verbs_resources.pd;
+    in.pd = pd;
     in.addr = 0;
     in.length = size;
     in.exp_access = IBV_EXP_ACCESS_LOCAL_WRITE | IBV_EXP_ACCESS_REMOTE_READ | IBV_EXP_ACCESS_REMOTE_WRITE | IBV_EXP_ACCESS_ALLOCATE_MR;
@@ -506,8 +627,9 @@ static ibv_mr_unique_ptr create_contiguous_mr(size_t size) {
     }
     return mr;
 }
-memory_region::memory_region(size_t s, bool contiguous)
-        : mr(contiguous ? create_contiguous_mr(s) : create_mr(new char[s], s)),
+memory_region::memory_region(transport_context &context, size_t s, bool contiguous)
+        : mr(contiguous ? create_contiguous_mr(context.verbs_resources->pd, s)
+                        : create_mr(context.verbs_resources->pd, new char[s], s)),
           buffer((char *)mr->addr),
           size(s) {
     if(contiguous) {
@@ -517,17 +639,25 @@ memory_region::memory_region(size_t s, bool contiguous)
     }
 }
 #else
-memory_region::memory_region(size_t s, bool contiguous) : memory_region(new char[s], s) {
+memory_region::memory_region(transport_context &context, size_t s, bool contiguous)
+        : memory_region(context, new char[s], s) {
     allocated_buffer.reset(buffer);
 }
 #endif
 
-memory_region::memory_region(size_t s) : memory_region(s, contiguous_memory_mode) {}
-memory_region::memory_region(char *buf, size_t s) : mr(create_mr(buf, s)), buffer(buf), size(s) {}
+memory_region::memory_region(size_t s)
+        : memory_region(*transport_context::get_default(), s) {}
+memory_region::memory_region(char *buf, size_t s)
+        : memory_region(*transport_context::get_default(), buf, s) {}
+memory_region::memory_region(transport_context &context, size_t s)
+        : memory_region(context, s, contiguous_memory_mode) {}
+memory_region::memory_region(transport_context &context, char *buf, size_t s)
+        : mr(create_mr(context.verbs_resources->pd, buf, s)), buffer(buf), size(s) {}
 
 uint32_t memory_region::get_rkey() const { return mr->rkey; }
 
 completion_queue::completion_queue(bool cross_channel) {
+    ibv_resources &verbs_resources = *transport_context::get_default()->verbs_resources;
     ibv_cq *cq_ptr = nullptr;
     if(!cross_channel) {
         cq_ptr = ibv_create_cq(verbs_resources.ib_ctx, 1024, nullptr, nullptr, 0);
@@ -557,18 +687,25 @@ completion_queue::completion_queue(bool cross_channel) {
 queue_pair::~queue_pair() {
     //    if(qp) cout << "Destroying Queue Pair..." << endl;
 }
-queue_pair::queue_pair(size_t remote_index)
-        : queue_pair(remote_index, [](queue_pair *) {}) {}
+queue_pair::queue_pair(size_t remote_index, uint32_t tcp_port)
+        : queue_pair(remote_index, [](queue_pair *) {}, tcp_port) {}
 
 // The post_recvs lambda will be called before queue_pair creation completes on
 // either end of the connection. This enables the user to avoid race conditions
 // between post_send() and post_recv().
 queue_pair::queue_pair(size_t remote_index,
-                       std::function<void(queue_pair *)> post_recvs) {
-    auto it = sockets.find(remote_index);
-    if(it == sockets.end()) throw rdma::invalid_args();
-
-    auto &sock = it->second;
+                       std::function<void(queue_pair *)> post_recvs,
+                       uint32_t tcp_port)
+        : queue_pair(*transport_context::get_default(), remote_index,
+                     std::move(post_recvs), tcp_port) {}
+queue_pair::queue_pair(transport_context &context, size_t remote_index,
+                       std::function<void(queue_pair *)> post_recvs,
+                       uint32_t tcp_port) {
+    tcp::socket *sock_ptr = context.find_socket(remote_index, tcp_port);
+    if(!sock_ptr) throw rdma::invalid_args();
+    ibv_resources &verbs_resources = *context.verbs_resources;
+
+    auto &sock = *sock_ptr;
 
     ibv_qp_init_attr qp_init_attr;
     memset(&qp_init_attr, 0, sizeof(qp_init_attr));
@@ -619,7 +756,7 @@ queue_pair::queue_pair(size_t remote_index,
     if(!sock.exchange(local_con_data, remote_con_data))
         throw rdma::qp_creation_failure();
 
-    bool success = !modify_qp_to_init(qp.get(), local_config.ib_port) && !modify_qp_to_rtr(qp.get(), remote_con_data.qp_num, remote_con_data.lid, remote_con_data.gid, local_config.ib_port, local_config.gid_idx) && !modify_qp_to_rts(qp.get());
+    bool success = !modify_qp_to_init(qp.get(), local_config.ib_port) && !modify_qp_to_rtr(qp.get(), remote_con_data.qp_num, remote_con_data.lid, remote_con_data.gid, local_config.ib_port, local_config.gid_idx, verbs_resources.port_attr.active_mtu) && !modify_qp_to_rts(qp.get());
 
     if(!success) printf("Failed to initialize QP\n");
 
@@ -780,12 +917,15 @@ bool queue_pair::post_write(const memory_region &mr, size_t offset,
 
 #ifdef MELLANOX_EXPERIMENTAL_VERBS
 managed_queue_pair::managed_queue_pair(
-        size_t remote_index, std::function<void(managed_queue_pair *)> post_recvs)
+        size_t remote_index, std::function<void(managed_queue_pair *)> post_recvs,
+        uint32_t tcp_port)
         : queue_pair(), scq(true), rcq(true) {
-    auto it = sockets.find(remote_index);
-    if(it == sockets.end()) throw rdma::invalid_args();
+    transport_context &context = *transport_context::get_default();
+    tcp::socket *sock_ptr = context.find_socket(remote_index, tcp_port);
+    if(!sock_ptr) throw rdma::invalid_args();
+    ibv_resources &verbs_resources = *context.verbs_resources;
 
-    auto &sock = it->second;
+    auto &sock = *sock_ptr;
 
     ibv_exp_qp_init_attr attr;
     memset(&attr, 0, sizeof(attr));
@@ -843,7 +983,7 @@ managed_queue_pair::managed_queue_pair(
     if(!sock.exchange(local_con_data, remote_con_data))
         throw rdma::qp_creation_failure();
 
-    bool success = !modify_qp_to_init(qp.get(), local_config.ib_port) && !modify_qp_to_rtr(qp.get(), remote_con_data.qp_num, remote_con_data.lid, remote_con_data.gid, local_config.ib_port, local_config.gid_idx) && !modify_qp_to_rts(qp.get());
+    bool success = !modify_qp_to_init(qp.get(), local_config.ib_port) && !modify_qp_to_rtr(qp.get(), remote_con_data.qp_num, remote_con_data.lid, remote_con_data.gid, local_config.ib_port, local_config.gid_idx, verbs_resources.port_attr.active_mtu) && !modify_qp_to_rts(qp.get());
 
     if(!success) throw rdma::qp_creation_failure();
 
@@ -855,6 +995,7 @@ managed_queue_pair::managed_queue_pair(
     if(!sock.exchange(0, tmp) || tmp != 0) throw rdma::qp_creation_failure();
 }
 manager_queue_pair::manager_queue_pair() : queue_pair() {
+    ibv_resources &verbs_resources = *transport_context::get_default()->verbs_resources;
     ibv_exp_qp_init_attr attr;
     memset(&attr, 0, sizeof(attr));
     attr.qp_context = nullptr;
@@ -882,7 +1023,7 @@ manager_queue_pair::manager_queue_pair() : queue_pair() {
         throw rdma::qp_creation_failure();
     }
 
-    bool success = !modify_qp_to_init(qp.get(), local_config.ib_port) && !modify_qp_to_rtr(qp.get(), qp->qp_num, 0, nullptr, local_config.ib_port, -1) && !modify_qp_to_rts(qp.get());
+    bool success = !modify_qp_to_init(qp.get(), local_config.ib_port) && !modify_qp_to_rtr(qp.get(), qp->qp_num, 0, nullptr, local_config.ib_port, -1, verbs_resources.port_attr.active_mtu) && !modify_qp_to_rts(qp.get());
 
     if(!success) throw rdma::qp_creation_failure();
 }
@@ -1017,12 +1158,14 @@ bool task::post() {
     tasks[index].comp_mask = 0;
 
     ibv_exp_task *bad = nullptr;
-    return !ibv_exp_post_task(verbs_resources.ib_ctx, &tasks[0], &bad);
+    return !ibv_exp_post_task(transport_context::get_default()->verbs_resources->ib_ctx,
+                              &tasks[0], &bad);
 }
 
 #else
 managed_queue_pair::managed_queue_pair(size_t remote_index,
-                                       std::function<void(managed_queue_pair *)> post_recvs)
+                                       std::function<void(managed_queue_pair *)> post_recvs,
+                                       uint32_t tcp_port)
         : queue_pair(), scq(true), rcq(true) {
     throw rdma::qp_creation_failure();
 }
@@ -1112,18 +1255,16 @@ feature_set get_supported_features() {
 //     //     }
 //     // }
 // }
-namespace impl {
-map<uint32_t, remote_memory_region> verbs_exchange_memory_regions(
-        const vector<uint32_t> &members, uint32_t node_rank,
-        const memory_region &mr) {
+map<uint32_t, remote_memory_region> transport_context::exchange_memory_regions(
+        const vector<uint32_t> &members, const memory_region &mr, uint32_t tcp_port) {
     map<uint32_t, remote_memory_region> remote_mrs;
     for(uint32_t m : members) {
         if(m == node_rank) {
             continue;
         }
 
-        auto it = sockets.find(m);
-        if(it == sockets.end()) {
+        tcp::socket *sock = find_socket(m, tcp_port);
+        if(!sock) {
             throw rdma::connection_broken();
         }
 
@@ -1131,19 +1272,27 @@ map<uint32_t, remote_memory_region> verbs_exchange_memory_regions(
         size_t size;
         uint32_t rkey;
 
-        bool still_connected = it->second.exchange((uintptr_t)mr.buffer, buffer) && it->second.exchange((size_t)mr.size, size) && it->second.exchange((uint32_t)mr.get_rkey(), rkey);
+        bool still_connected = sock->exchange((uintptr_t)mr.buffer, buffer) && sock->exchange((size_t)mr.size, size) && sock->exchange((uint32_t)mr.get_rkey(), rkey);
 
         if(!still_connected) {
             fprintf(stderr, "WARNING: lost connection to node %u\n",
-                    (unsigned int)it->first);
+                    (unsigned int)m);
             throw rdma::connection_broken();
         }
 
-        remote_mrs.emplace(it->first, remote_memory_region(buffer, size, rkey));
+        remote_mrs.emplace(m, remote_memory_region(buffer, size, rkey));
     }
     return remote_mrs;
 }
-ibv_cq *verbs_get_cq() { return verbs_resources.cq; }
-ibv_comp_channel *verbs_get_completion_channel() { return verbs_resources.cc; }
+namespace impl {
+map<uint32_t, remote_memory_region> verbs_exchange_memory_regions(
+        const vector<uint32_t> &members, uint32_t node_rank,
+        const memory_region &mr, uint32_t tcp_port) {
+    return transport_context::get(node_rank)->exchange_memory_regions(members, mr, tcp_port);
+}
+ibv_cq *verbs_get_cq() { return transport_context::get_default()->verbs_resources->cq; }
+ibv_comp_channel *verbs_get_completion_channel() {
+    return transport_context::get_default()->verbs_resources->cc;
+}
 }
 }
@@ -2,17 +2,28 @@
 #ifndef VERBS_HELPER_H
 #define VERBS_HELPER_H
 
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <experimental/optional>
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "derecho/derecho_ports.h"
+#include "tcp/tcp.h"
+
 struct ibv_mr;
 struct ibv_qp;
 struct ibv_cq;
+struct ibv_comp_channel;
+
+class group;
 
 /**
  * Contains functions and classes for low-level RDMA operations, such as setting
@@ -32,23 +43,135 @@ class qp_creation_failure : public creation_failure {};
 class message_types_exhausted : public exception {};
 class unsupported_feature : public exception {};
 
+class memory_region;
+class remote_memory_region;
+struct ibv_resources;
+
+namespace impl {
+ibv_cq* verbs_get_cq();
+ibv_comp_channel* verbs_get_completion_channel();
+}
+
+/**
+ * The RDMA resources of one node in this process: its device, protection
+ * domain, completion queue and polling thread, its TCP connections to other
+ * nodes, and its RDMC groups. Each node a process runs has its own context,
+ * so several nodes can share a process without sharing node ids, connections
+ * or group numbers. Contexts are never destroyed once created.
+ */
+class transport_context {
+    /** The device, protection domain and completion queue, once created. */
+    std::unique_ptr<ibv_resources> verbs_resources;
+    std::atomic<bool> polling_loop_shutdown_flag{false};
+
+    /** The TCP connections made on one port. */
+    struct port_connections {
+        /** Listens for new incoming connections. */
+        std::unique_ptr<tcp::connection_listener> listener;
+        /** The socket for each connection, keyed by the remote node. */
+        std::map<uint32_t, tcp::socket> sockets;
+        /** Set while the first connections are being made, without holding resources_mutex. */
+        bool connecting = true;
+    };
+    /** Guards verbs_resources, connections and num_users; held only to look
+     * up or insert entries, never while talking to a remote node. */
+    std::mutex resources_mutex;
+    /** The connections to other nodes, keyed by the port they were made on. */
+    std::map<uint32_t, port_connections> connections;
+    /** Notified when the first connections on a port have been made, or have failed. */
+    std::condition_variable connections_made;
+    /** The number of initialize calls sharing verbs_resources. */
+    uint32_t num_users = 0;
+    /** Joined once it has been shut down, before the resources it polls are
+     * destroyed. */
+    std::thread polling_thread;
+
+    /** Opens the device and starts the polling thread. */
+    bool create_resources();
+    void polling_loop();
+    /** @return the connections on tcp_port, waiting while they are being
+     * made; the caller must hold resources_mutex. */
+    port_connections* find_connections(std::unique_lock<std::mutex>& lock, uint32_t tcp_port);
+
+    friend class memory_region;
+    friend class completion_queue;
+    friend class queue_pair;
+    friend class managed_queue_pair;
+    friend class manager_queue_pair;
+    friend class task;
+    friend ibv_cq* impl::verbs_get_cq();
+    friend ibv_comp_channel* impl::verbs_get_completion_channel();
+
+public:
+    /** The id of the node this context connects as. */
+    const uint32_t node_rank;
+
+    /** The groups of this node, by group number. */
+    std::map<uint16_t, std::shared_ptr<group>> groups;
+    /** Guards groups, groups_connecting and next_group_number. */
+    std::mutex groups_lock;
+    /** Numbers of groups still connecting to their members, which are not in
+     * groups yet; completions for them wait on groups_connected. */
+    std::set<uint16_t> groups_connecting;
+    std::condition_variable groups_connected;
+    /** The next group number rdmc::new_group_number will try. */
+    uint16_t next_group_number = 0;
+
+    explicit transport_context(uint32_t node_rank);
+    transport_context(const transport_context&) = delete;
+    ~transport_context();
+
+    /** @return the context of the node with this id, creating it on first use. */
+    static std::shared_ptr<transport_context> get(uint32_t node_rank);
+    /** @return the first context created in this process, or nullptr if there
+     * is none; used by the functions and constructors that do not take one. */
+    static std::shared_ptr<transport_context> get_default();
+
+    /**
+     * Connects to the given nodes on tcp_port and, on the first call, sets up
+     * the device, completion queue and polling thread. A call on a port
+     * already set up shares its connections, and connects only to the nodes
+     * it was not yet connected to. Calls that may run at the same time, on
+     * this node or any other, must use different ports.
+     */
+    bool initialize(const std::map<uint32_t, std::string>& node_addresses,
+                    uint32_t tcp_port);
+    bool add_connection(uint32_t index, const std::string& address,
+                        uint32_t tcp_port);
+    /** Releases one initialize call's share of the resources. */
+    void destroy();
+    /** @return the socket connected to a node on tcp_port, or nullptr. */
+    tcp::socket* find_socket(uint32_t index, uint32_t tcp_port);
+
+    // This function exchanges memory regions with all other connected nodes
+    // which enables us to do one-sided RDMA operations between them. Due to
+    // its nature, the function requires that it is called simultaneously on
+    // all nodes and that only one execution is active at any time.
+    std::map<uint32_t, remote_memory_region> exchange_memory_regions(
+            const std::vector<uint32_t>& members, const memory_region& mr,
+            uint32_t tcp_port = derecho::rdmc_tcp_port);
+};
+
 /**
  * A C++ wrapper for the IB Verbs ibv_mr struct. Registers a memory region for
  * the provided buffer on construction, and deregisters it on destruction.
- * Instances of this class can only be created after global Verbs initialization
- * has been run, since it depends on the global Verbs resources.
+ * Instances of this class can only be created after their context has been
+ * initialized, and can only be used with that context's queue pairs; the
+ * constructors without a context use the default one.
  */
 class memory_region {
     std::unique_ptr<ibv_mr, std::function<void(ibv_mr*)>> mr;
     std::unique_ptr<char[]> allocated_buffer;
 
-    memory_region(size_t size, bool contiguous);
+    memory_region(transport_context& context, size_t size, bool contiguous);
     friend class queue_pair;
     friend class task;
 
 public:
     memory_region(size_t size);
     memory_region(char* buffer, size_t size);
+    memory_region(transport_context& context, size_t size);
+    memory_region(transport_context& context, char* buffer, size_t size);
     uint32_t get_rkey() const;
 
     char* const buffer;
@@ -75,7 +198,9 @@ public:
     explicit completion_queue(bool cross_channel);
 };
 
-typedef std::function<void(uint64_t tag, uint32_t immediate, size_t length)>
+/** Handles a completion taken from a context's completion queue. */
+typedef std::function<void(transport_context& context, uint64_t tag,
+                           uint32_t immediate, size_t length)>
         completion_handler;
 
 class message_type {
@@ -101,8 +226,8 @@ public:
 
 /**
  * A C++ wrapper for the IB Verbs ibv_qp struct and its associated functions.
- * Instances of this class can only be created after global Verbs initialization
- * has been run, since it depends on global Verbs resources.
+ * Instances of this class can only be created after their context has been
+ * initialized; the constructors without a context use the default one.
  */
 class queue_pair {
 protected:
@@ -113,9 +238,18 @@ protected:
 
 public:
     ~queue_pair();
-    explicit queue_pair(size_t remote_index);
+    explicit queue_pair(size_t remote_index,
+                        uint32_t tcp_port = derecho::rdmc_tcp_port);
+    /**
+     * Connects to the remote node over the TCP connection made on tcp_port;
+     * queue pairs for different ports can be set up concurrently.
+     */
     queue_pair(size_t remote_index,
-               std::function<void(queue_pair*)> post_recvs);
+               std::function<void(queue_pair*)> post_recvs,
+               uint32_t tcp_port = derecho::rdmc_tcp_port);
+    queue_pair(transport_context& context, size_t remote_index,
+               std::function<void(queue_pair*)> post_recvs,
+               uint32_t tcp_port = derecho::rdmc_tcp_port);
     queue_pair(queue_pair&&) = default;
     bool post_send(const memory_region& mr, size_t offset, size_t length,
                    uint64_t wr_id, uint32_t immediate,
@@ -137,7 +271,8 @@ class managed_queue_pair : public queue_pair {
 public:
     completion_queue scq, rcq;
     managed_queue_pair(size_t remote_index,
-                       std::function<void(managed_queue_pair*)> post_recvs);
+                       std::function<void(managed_queue_pair*)> post_recvs,
+                       uint32_t tcp_port = derecho::rdmc_tcp_port);
 };
 
 class manager_queue_pair : public queue_pair {
@@ -172,10 +307,17 @@ struct feature_set {
 feature_set get_supported_features();
 
 namespace impl {
+/**
+ * Initializes the context of node_rank; see transport_context::initialize.
+ * Calls with different node ranks set up separate contexts.
+ */
 bool verbs_initialize(const std::map<uint32_t, std::string>& node_addresses,
-                      uint32_t node_rank);
+                      uint32_t node_rank,
+                      uint32_t tcp_port = derecho::rdmc_tcp_port);
 bool verbs_add_connection(uint32_t index, const std::string& address,
-                          uint32_t node_rank);
+                          uint32_t node_rank,
+                          uint32_t tcp_port = derecho::rdmc_tcp_port);
+/** Releases one verbs_initialize call's share of the default context. */
 void verbs_destroy();
 // int poll_for_completions(int num, ibv_wc* wcs,
 //                          std::atomic<bool>& shutdown_flag);
@@ -186,7 +328,7 @@ void verbs_destroy();
 // only one execution is active at any time.
 std::map<uint32_t, remote_memory_region> verbs_exchange_memory_regions(
         const std::vector<uint32_t>& members, uint32_t node_rank,
-        const memory_region& mr);
+        const memory_region& mr, uint32_t tcp_port = derecho::rdmc_tcp_port);
 
 bool set_interrupt_mode(bool enabled);
 bool set_contiguous_memory_mode(bool enabled);
@@ -20,9 +20,11 @@ struct exp_results {
     int num_senders_selector;
     uint max_msg_size;
     double sum_message_rate;
+    double acks_per_message;
     void print(std::ofstream& fout) {
         fout << num_nodes << " " << num_senders_selector << " "
-             << max_msg_size << " " << sum_message_rate << endl;
+             << max_msg_size << " " << sum_message_rate << " "
+             << acks_per_message << endl;
     }
 };
 
@@ -99,8 +101,9 @@ int main(int argc, char* argv[]) {
         return true;
     };
     vector<int64_t> last_max_num_received(num_senders, -1);
+    uint64_t num_acks = 0, num_received_total = 0;
     auto receiver_trig = [&completed, last_max_num_received, window_size, num_nodes, node_id, sst_receive_handler,
-                          row_offset, num_senders](multicast_sst& sst) mutable {
+                          row_offset, num_senders, &num_acks, &num_received_total](multicast_sst& sst) mutable {
         while(true) {
             for(uint j = 0; j < num_senders; ++j) {
                 auto num_received = sst.num_received_sst[node_id][j] + 1;
@@ -110,6 +113,7 @@ int main(int argc, char* argv[]) {
                                         sst.slots[row_offset + j][slot].buf,
                                         sst.slots[row_offset + j][slot].size);
                     sst.num_received_sst[node_id][j]++;
+                    num_received_total++;
                 }
             }
             bool time_to_push = true;
@@ -127,6 +131,7 @@ int main(int argc, char* argv[]) {
         }
         sst.put(sst.num_received_sst.get_base() - sst.getBaseAddress(),
                 sizeof(sst.num_received_sst[0][0]) * num_senders);
+        num_acks++;
         for(uint j = 0; j < num_senders; ++j) {
             last_max_num_received[j] = sst.num_received_sst[node_id][j];
         }
@@ -181,7 +186,8 @@ int main(int argc, char* argv[]) {
     }
 
     double sum_message_rate = aggregate_bandwidth(members, node_id, message_rate);
-    log_results(exp_results{num_nodes, num_senders_selector, max_msg_size, sum_message_rate},
+    double acks_per_message = num_received_total ? (double)num_acks / num_received_total : 0;
+    log_results(exp_results{num_nodes, num_senders_selector, max_msg_size, sum_message_rate, acks_per_message},
                 "data_multicast");
     sst->sync_with_members();
 }
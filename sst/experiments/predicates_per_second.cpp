@@ -1,14 +1,13 @@
-#include <ctime>
+#include <algorithm>
+#include <cstddef>
 #include <fstream>
 #include <iostream>
 #include <map>
 #include <string>
 #include <vector>
 
-#include "derecho/experiments//timing.h"
-#include "derecho/experiments/statistics.h"
+#include "sst/experiments/timing.h"
 #include "sst/sst.h"
-#include "sst/tcp.h"
 
 using std::vector;
 using std::map;
@@ -17,138 +16,130 @@ using std::cin;
 using std::cout;
 using std::endl;
 using std::ofstream;
-using std::ifstream;
-using std::tie;
+
+// Counts how many times per second a predicate that scans the first r rows
+// is evaluated, with the row declared field by field (SSTField) or as a
+// struct (SSTRows), so that the cost of the two row accessors can be
+// compared.
 
 struct TestRow {
     volatile int flag;
 };
 
-namespace sst {
-namespace tcp {
-extern int port;
-}
-}
-
-static int num_nodes, this_node_rank;
-
-static const int TIMING_NODE = 0;
-
-int main(int argc, char** argv) {
-    using namespace sst;
-
-    if(argc < 2) {
-        cout << "Please provide a configuration file." << endl;
-        return -1;
-    }
-    if(argc < 3) {
-        cout << "Please provide at least one value of r to test." << endl;
-        return -1;
-    }
-    cout << "Arguments were: ";
-    for(int i = 0; i < argc; ++i) {
-        cout << argv[i] << " ";
+class FieldSST : public sst::SST<FieldSST> {
+public:
+    FieldSST(const vector<uint32_t>& members, uint32_t my_id) : SST<FieldSST>(this, sst::SSTParams{members, my_id}) {
+        SSTInit(flag);
     }
-    cout << endl;
+    sst::SSTField<int> flag;
 
-    srand(time(NULL));
-
-    ifstream node_config_stream;
-    node_config_stream.open(argv[1]);
-
-    // input number of nodes and the local node id
-    node_config_stream >> num_nodes >> this_node_rank;
-
-    // input the ip addresses
-    map<uint32_t, string> ip_addrs;
-    for(int i = 0; i < num_nodes; ++i) {
-        node_config_stream >> ip_addrs[i];
-    }
-
-    node_config_stream >> tcp::port;
-
-    node_config_stream.close();
+    volatile int& flag_of(const int row) const { return flag[row]; }
+    long long int flag_offset() { return flag.get_base() - getBaseAddress(); }
+};
 
-    // Get the values of R to test from the other arguments
-    vector<int> row_counts(argc - 2);
-    for(int i = 0; i < argc - 2; ++i) {
-        row_counts[i] = std::stoi(string(argv[i + 2]));
+class RowSST : public sst::SST<RowSST> {
+public:
+    RowSST(const vector<uint32_t>& members, uint32_t my_id) : SST<RowSST>(this, sst::SSTParams{members, my_id}) {
+        SSTInit(rows);
     }
+    sst::SSTRows<TestRow> rows;
 
-    // initialize tcp connections
-    tcp::tcp_initialize(this_node_rank, ip_addrs);
+    volatile int& flag_of(const int row) const { return rows[row].flag; }
+    long long int flag_offset() { return offsetof(TestRow, flag); }
+};
 
-    // initialize the rdma resources
-    verbs_initialize();
+static const uint32_t TIMING_NODE = 0;
 
-    // make all the nodes members of a group
-    vector<uint32_t> group_members(num_nodes);
-    for(int i = 0; i < num_nodes; ++i) {
-        group_members[i] = i;
-    }
-
-    // create a new shared state table with all the members
-    SST<TestRow>* sst = new SST<TestRow>(group_members, this_node_rank);
-    const int local = sst->get_local_index();
-    if(this_node_rank == TIMING_NODE) {
-        (*sst)[local].flag = 1;
-    } else {
-        (*sst)[local].flag = 0;
-    }
-    sst->put();
+template <typename TestSST>
+void run_experiment(const vector<uint32_t>& members, uint32_t node_rank, const vector<int>& row_counts,
+                    const string& style) {
+    using namespace sst;
+    TestSST sst(members, node_rank);
+    const int local = sst.get_local_index();
+    sst.flag_of(local) = node_rank == TIMING_NODE ? 1 : 0;
+    sst.put(sst.flag_offset(), sizeof(int));
 
     //Make sure initial writes are finished
-    sst->sync_with_members();
+    sst.sync_with_members();
     //Warm up the processor
     experiments::busy_wait_for(3 * SECONDS_TO_NS);
 
     int r = 0;
     long long int count = 0;
 
-    if(this_node_rank == TIMING_NODE) {
-        auto test_pred = [&r](const SST<TestRow>& sst) {
+    if(node_rank == TIMING_NODE) {
+        auto test_pred = [&r](const TestSST& sst) {
             for(int n = 0; n <= r; ++n) {
-                if(sst[n].flag != 0) {
+                if(sst.flag_of(n) != 0) {
                     return false;
                 }
             }
             return true;
         };
-        auto count_action = [&count](SST<TestRow>& sst) {
+        auto count_action = [&count](TestSST& sst) {
             ++count;
         };
 
-        sst->predicates.insert(test_pred, count_action, PredicateType::RECURRENT);
-    }
-
-    //Run the experiment for each value of R
-    for(int rowcount : row_counts) {
-        r = rowcount;
+        sst.predicates.insert(test_pred, count_action, PredicateType::RECURRENT);
 
-        if(this_node_rank == TIMING_NODE) {
+        //Run the experiment for each value of R
+        for(int rowcount : row_counts) {
+            r = std::min(rowcount, (int)members.size() - 1);
             count = 0;
 
             //Trigger the predicate to start being true by setting my own value to 0
-            (*sst)[local].flag = 0;
+            sst.flag_of(local) = 0;
             long long int start_time = experiments::get_realtime_clock();
             experiments::busy_wait_for(100000000);
             //Stop the predicate by setting my value to 1
-            (*sst)[local].flag = 1;
+            sst.flag_of(local) = 1;
             long long int end_time = experiments::get_realtime_clock();
 
             long long int actual_run_time = end_time - start_time;
-            ofstream data_out_stream(string("predicates_per_sec_" + std::to_string(num_nodes) + ".csv").c_str(), ofstream::app);
+            ofstream data_out_stream(string("predicates_per_sec_" + style + "_" + std::to_string(members.size()) + ".csv").c_str(), ofstream::app);
             data_out_stream << r << "," << count << "," << actual_run_time << endl;
             data_out_stream.close();
         }
     }
+    //Other nodes just wait here until the end, they don't have anything to do
+    sst.sync_with_members();
+}
 
-    if(this_node_rank == TIMING_NODE) {
-        sst->sync_with_members();
-    } else {
-        //Other nodes will just block here until the end, they don't have anything to do
-        tcp::sync(TIMING_NODE);
+int main(int argc, char** argv) {
+    if(argc < 3) {
+        cout << "Usage: " << argv[0] << " <fields|rows> <r> [<r> ...]" << endl;
+        cout << "Each r is a number of rows for the predicate to scan." << endl;
+        return -1;
+    }
+    const string style(argv[1]);
+    vector<int> row_counts;
+    for(int i = 2; i < argc; ++i) {
+        row_counts.push_back(std::stoi(string(argv[i])));
     }
 
+    // input number of nodes and the local node id
+    uint32_t node_rank, num_nodes;
+    cin >> node_rank >> num_nodes;
+
+    // input the ip addresses
+    map<uint32_t, string> ip_addrs;
+    for(unsigned int i = 0; i < num_nodes; ++i) {
+        cin >> ip_addrs[i];
+    }
+
+    // initialize the rdma resources
+    sst::verbs_initialize(ip_addrs, node_rank);
+
+    // make all the nodes members of a group
+    vector<uint32_t> members(num_nodes);
+    for(unsigned int i = 0; i < num_nodes; ++i) {
+        members[i] = i;
+    }
+
+    if(style == "rows") {
+        run_experiment<RowSST>(members, node_rank, row_counts, style);
+    } else {
+        run_experiment<FieldSST>(members, node_rank, row_counts, "fields");
+    }
     return 0;
 }
@@ -0,0 +1,107 @@
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string.h>
+#include <vector>
+
+#include "sst/sst.h"
+
+using std::vector;
+using std::map;
+using std::string;
+using std::cin;
+using std::cout;
+using std::endl;
+using std::ofstream;
+
+using namespace sst;
+
+// Node 0 keeps rewriting a large value, alternating between all 'a's and all
+// 'b's, while the other nodes read it. Counts how often a read had to be
+// retried and checks that no copy reported as consistent is torn, which
+// would be the case for a plain SSTField of the same size.
+
+const int value_size = 2048;
+
+struct Value {
+    char buf[value_size];
+};
+
+class mySST : public SST<mySST> {
+public:
+    mySST(const vector<uint32_t>& _members, uint32_t my_id) : SST<mySST>(this, SSTParams{_members, my_id}) {
+        SSTInit(value, done);
+    }
+    SSTFieldVersioned<Value> value;
+    SSTField<bool> done;
+};
+
+bool is_uniform(const Value& v) {
+    for(int i = 1; i < value_size; ++i) {
+        if(v.buf[i] != v.buf[0]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    // input number of nodes and the local node id
+    uint32_t node_rank, num_nodes;
+    cin >> node_rank >> num_nodes;
+
+    // input the ip addresses
+    map<uint32_t, string> ip_addrs;
+    for(unsigned int i = 0; i < num_nodes; ++i) {
+        cin >> ip_addrs[i];
+    }
+
+    // initialize the rdma resources
+    verbs_initialize(ip_addrs, node_rank);
+
+    vector<uint32_t> members(num_nodes);
+    for(unsigned int i = 0; i < num_nodes; ++i) {
+        members[i] = i;
+    }
+
+    mySST sst(members, node_rank);
+    const int local = sst.get_local_index();
+    Value v;
+    memset(v.buf, 'a', value_size);
+    sst.value.init(local, v);
+    sst.done[local] = false;
+    sst.put();
+    sst.sync_with_members();
+
+    const int num_writes = 100000;
+    const long long int value_offset = sst.value.get_base() - sst.getBaseAddress();
+    if(node_rank == 0) {
+        for(int i = 0; i < num_writes; ++i) {
+            memset(v.buf, i % 2 ? 'b' : 'a', value_size);
+            sst.value.write(local, v);
+            sst.put(value_offset, sst.value.field_len);
+        }
+        sst.done[local] = true;
+        sst.put((char*)std::addressof(sst.done[0]) - sst.getBaseAddress(), sizeof(bool));
+    } else {
+        uint64_t num_reads = 0, num_retries = 0, num_torn = 0;
+        while(!sst.done[0]) {
+            Value copy;
+            if(sst.value.read(0, copy)) {
+                ++num_reads;
+                if(!is_uniform(copy)) {
+                    ++num_torn;
+                }
+            } else {
+                ++num_retries;
+            }
+        }
+        cout << "Consistent reads: " << num_reads << ", retries: " << num_retries
+             << ", torn reads reported as consistent: " << num_torn << endl;
+        ofstream fout("data_versioned_field_test.csv");
+        fout << num_nodes << " " << value_size << " " << num_reads << " "
+             << num_retries << " " << num_torn << endl;
+    }
+    sst.sync_with_members();
+    return 0;
+}
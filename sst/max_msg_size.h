@@ -1,5 +1,14 @@
 #pragma once
 
+#include <cstdint>
+
+/** The capacity of an SST multicast slot. Messages larger than this always go
+ * through RDMC; define SST_MAX_MSG_SIZE at build time to give the SST path
+ * more room (every slot in every row grows accordingly). */
+#ifndef SST_MAX_MSG_SIZE
+#define SST_MAX_MSG_SIZE 10240
+#endif
+
 namespace sst {
-const static uint32_t max_msg_size = 10240;
+const static uint32_t max_msg_size = SST_MAX_MSG_SIZE;
 }
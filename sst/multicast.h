@@ -1,5 +1,6 @@
 #include <cassert>
 #include <chrono>
+#include <cstddef>
 #include <cstdlib>
 #include <ctime>
 #include <functional>
@@ -54,7 +55,7 @@ class multicast_group {
     void initialize() {
         for(auto i : row_indices) {
             for(uint j = num_received_offset; j < num_received_offset + num_senders; ++j) {
-                sst->num_received_sst[i][j] = -1;
+                sst->num_received_sst_at(i, j) = -1;
             }
             for(uint j = slots_offset; j < slots_offset + window_size; ++j) {
                 sst->slots[i][j].buf[0] = 0;
@@ -123,10 +124,10 @@ public:
                 sst->slots[my_row][slots_offset + slot].size = msg_size;
                 return sst->slots[my_row][slots_offset + slot].buf;
             } else {
-                long long int min_multicast_num = sst->num_received_sst[my_row][num_received_offset + my_sender_index];
+                long long int min_multicast_num = sst->num_received_sst_at(my_row, num_received_offset + my_sender_index);
                 for(auto i : row_indices) {
-                    if(sst->num_received_sst[i][num_received_offset + my_sender_index] < min_multicast_num) {
-                        min_multicast_num = sst->num_received_sst[i][num_received_offset + my_sender_index];
+                    if(sst->num_received_sst_at(i, num_received_offset + my_sender_index) < min_multicast_num) {
+                        min_multicast_num = sst->num_received_sst_at(i, num_received_offset + my_sender_index);
                     }
                 }
                 if(finished_multicasts_num == min_multicast_num) {
@@ -145,9 +146,15 @@ public:
         // std::cout << "slots_offset = " << slots_offset << std::endl;
         num_sent++;
         sst->slots[my_row][slots_offset + slot].next_seq++;
-        sst->put(
-                (char*)std::addressof(sst->slots[0][slots_offset + slot]) - sst->getBaseAddress(),
-                sizeof(Message));
+        // Write only the used part of the buffer, then the size and sequence
+        // number; writes on a queue pair land in order, so receivers that see
+        // the new next_seq also see the whole message
+        const long long int slot_offset = (char*)std::addressof(sst->slots[0][slots_offset + slot]) - sst->getBaseAddress();
+        const uint32_t msg_size = sst->slots[my_row][slots_offset + slot].size;
+        if(msg_size > 0) {
+            sst->put(slot_offset + offsetof(Message, buf), msg_size);
+        }
+        sst->put(slot_offset + offsetof(Message, size), sizeof(Message) - offsetof(Message, size));
 	// std::cout << "Finished send()" << std::endl;
 	// debug_print();
     }
@@ -163,7 +170,7 @@ public:
             cout << endl;
             cout << "Printing num_received_sst" << endl;
             for(uint j = num_received_offset; j < num_received_offset + num_senders; ++j) {
-                cout << sst->num_received_sst[i][j] << " ";
+                cout << sst->num_received_sst_at(i, j) << " ";
             }
             cout << endl;
         }
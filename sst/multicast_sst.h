@@ -14,5 +14,10 @@ public:
               num_received_sst(num_senders) {
         SSTInit(slots, num_received_sst, heartbeat);
     }
+
+    /** The receive counter of a sender, as multicast_group reads and writes it. */
+    volatile int64_t& num_received_sst_at(const int row, const uint32_t index) const {
+        return num_received_sst[row][index];
+    }
 };
 }
@@ -1,66 +1,178 @@
+#include <climits>
 #include <iostream>
-#include <numeric>
+#include <stdexcept>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include "poll_utils.h"
 
 namespace sst {
 namespace util {
 
-std::vector<std::list<std::pair<int32_t, int32_t>>> PollingData::completion_entries;
-std::map<std::thread::id, uint32_t> PollingData::tid_to_index;
-std::vector<bool> PollingData::if_waiting;
-std::condition_variable PollingData::poll_cv;
+std::array<std::atomic<PollingData::CompletionSlot*>, PollingData::max_threads> PollingData::slots{};
+std::vector<std::unique_ptr<PollingData::CompletionSlot>> PollingData::slot_storage;
+std::vector<uint32_t> PollingData::free_indices;
+std::map<std::thread::id, uint32_t> PollingData::thread_indices;
+thread_local PollingData::ThreadSlot PollingData::thread_slot;
 std::mutex PollingData::poll_mutex;
+std::condition_variable PollingData::poll_cv;
+std::atomic<uint32_t> PollingData::num_waiting{0};
+std::atomic<uint64_t> PollingData::waiting_since_ns{0};
 
 //Single global instance, defined here
 PollingData polling_data;
 
-bool PollingData::check_waiting() {
-    return std::accumulate(if_waiting.begin(), if_waiting.end(), false, [](bool a, bool b) { return a || b; });
+static void futex_wait(std::atomic<uint32_t>* word, uint32_t expected, const struct timespec* timeout) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT_PRIVATE, expected, timeout, nullptr, 0);
 }
 
-void PollingData::insert_completion_entry(uint32_t index, std::pair<int32_t, int32_t> ce) {
-    std::lock_guard<std::mutex> lk(poll_mutex);
-    completion_entries[index].push_back(ce);
+static void futex_wake(std::atomic<uint32_t>* word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
 }
 
-std::experimental::optional<std::pair<int32_t, int32_t>> PollingData::get_completion_entry(const std::thread::id id) {
-    std::lock_guard<std::mutex> lk(poll_mutex);
-    auto index = tid_to_index[id];
-    if(completion_entries[index].empty()) {
+std::experimental::optional<std::pair<int32_t, int32_t>> PollingData::take_entry(CompletionSlot& slot) {
+    const uint32_t head = slot.head.load(std::memory_order_relaxed);
+    if(head == slot.tail.load(std::memory_order_acquire)) {
         return {};
     }
-    auto ce = completion_entries[index].front();
-    completion_entries[index].pop_front();
+    std::pair<int32_t, int32_t> ce;
+    const SequencedEntry& entry = slot.entries[head % slot_capacity];
+    if(entry.first == head) {
+        ce = entry.second;
+    } else {
+        // Entry number head arrived while the ring was full
+        std::lock_guard<std::mutex> lock(slot.spill_mutex);
+        ce = slot.spilled.front().second;
+        slot.spilled.pop_front();
+    }
+    slot.head.store(head + 1, std::memory_order_release);
     return ce;
 }
 
+void PollingData::insert_completion_entry(uint32_t index, std::pair<int32_t, int32_t> ce) {
+    CompletionSlot* slot = index < max_threads ? slots[index].load(std::memory_order_acquire) : nullptr;
+    if(!slot) {
+        std::cout << "Dropping a completion entry for unregistered wr_id " << index << std::endl;
+        return;
+    }
+    const uint32_t tail = slot->tail.load(std::memory_order_relaxed);
+    if(tail - slot->head.load(std::memory_order_acquire) < slot_capacity) {
+        slot->entries[tail % slot_capacity] = SequencedEntry(tail, ce);
+    } else {
+        // The owner is behind; keep the entry rather than let its wait time out
+        std::lock_guard<std::mutex> lock(slot->spill_mutex);
+        slot->spilled.emplace_back(tail, ce);
+    }
+    // Sequentially consistent, so that either the waiter sees the new tail
+    // before sleeping or this thread sees that it is sleeping
+    slot->tail.store(tail + 1, std::memory_order_seq_cst);
+    if(slot->sleeping.load(std::memory_order_seq_cst)) {
+        futex_wake(&slot->tail);
+    }
+}
+
+std::experimental::optional<std::pair<int32_t, int32_t>> PollingData::get_completion_entry(const std::thread::id id) {
+    return take_entry(*slots[get_index(id)].load(std::memory_order_acquire));
+}
+
+std::experimental::optional<std::pair<int32_t, int32_t>> PollingData::wait_for_completion_entry(
+        uint32_t index, std::chrono::steady_clock::time_point deadline) {
+    CompletionSlot& slot = *slots[index].load(std::memory_order_acquire);
+    for(uint32_t i = 0; i < spin_count; ++i) {
+        auto ce = take_entry(slot);
+        if(ce) {
+            return ce;
+        }
+    }
+    while(true) {
+        const uint32_t tail = slot.tail.load(std::memory_order_acquire);
+        if(slot.head.load(std::memory_order_relaxed) != tail) {
+            return take_entry(slot);
+        }
+        auto now = std::chrono::steady_clock::now();
+        if(now >= deadline) {
+            return {};
+        }
+        auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now).count();
+        struct timespec timeout;
+        timeout.tv_sec = remaining / 1000000000;
+        timeout.tv_nsec = remaining % 1000000000;
+        slot.sleeping.store(true, std::memory_order_seq_cst);
+        if(slot.tail.load(std::memory_order_seq_cst) == tail) {
+            futex_wait(&slot.tail, tail, &timeout);
+        }
+        slot.sleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
 uint32_t PollingData::get_index(const std::thread::id id) {
+    if(id == std::this_thread::get_id() && thread_slot.index >= 0) {
+        return thread_slot.index;
+    }
+    // Only reached the first time a thread asks, or for another thread
     std::lock_guard<std::mutex> lk(poll_mutex);
-    if(tid_to_index.find(id) == tid_to_index.end()) {
-        completion_entries.push_back(std::list<std::pair<int32_t, int32_t>>());
-        tid_to_index[id] = completion_entries.size() - 1;
-        if_waiting.push_back(false);
+    if(id != std::this_thread::get_id()) {
+        auto it = thread_indices.find(id);
+        if(it == thread_indices.end()) {
+            throw std::invalid_argument("The thread has no SST completion slot");
+        }
+        return it->second;
+    }
+    uint32_t index;
+    if(!free_indices.empty()) {
+        index = free_indices.back();
+        free_indices.pop_back();
+    } else {
+        if(slot_storage.size() == max_threads) {
+            throw std::runtime_error("Too many threads waiting for SST completions");
+        }
+        slot_storage.emplace_back(new CompletionSlot());
+        index = slot_storage.size() - 1;
+        slots[index].store(slot_storage.back().get(), std::memory_order_release);
+    }
+    thread_slot.index = index;
+    thread_slot.owner = id;
+    thread_indices[id] = index;
+    return index;
+}
+
+PollingData::ThreadSlot::~ThreadSlot() {
+    if(index >= 0) {
+        std::lock_guard<std::mutex> lk(poll_mutex);
+        thread_indices.erase(owner);
+        free_indices.push_back(index);
     }
-    return tid_to_index[id];
 }
 
 void PollingData::set_waiting(const std::thread::id id) {
-    std::lock_guard<std::mutex> lk(poll_mutex);
-    auto index = tid_to_index[id];
-    if_waiting[index] = true;
-    poll_cv.notify_all();
+    CompletionSlot& slot = *slots[get_index(id)].load(std::memory_order_acquire);
+    // Completions of earlier requests that timed out must not be mistaken for this request's
+    const uint32_t tail = slot.tail.load(std::memory_order_acquire);
+    {
+        std::lock_guard<std::mutex> lock(slot.spill_mutex);
+        while(!slot.spilled.empty() && static_cast<int32_t>(slot.spilled.front().first - tail) < 0) {
+            slot.spilled.pop_front();
+        }
+    }
+    slot.head.store(tail, std::memory_order_release);
+    if(num_waiting.fetch_add(1) == 0) {
+        waiting_since_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch())
+                                   .count();
+        std::lock_guard<std::mutex> lk(poll_mutex);
+        poll_cv.notify_all();
+    }
 }
 
 void PollingData::reset_waiting(const std::thread::id id) {
-    std::lock_guard<std::mutex> lk(poll_mutex);
-    auto index = tid_to_index[id];
-    if_waiting[index] = false;
+    num_waiting.fetch_sub(1);
 }
 
-void PollingData::wait_for_requests() {
+bool PollingData::wait_for_requests(std::chrono::milliseconds timeout) {
     std::unique_lock<std::mutex> lk(poll_mutex);
-    poll_cv.wait(lk, check_waiting);
+    return poll_cv.wait_for(lk, timeout, [] { return num_waiting.load() > 0; });
 }
 }
 }
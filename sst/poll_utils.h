@@ -1,36 +1,122 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <experimental/optional>
-#include <list>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <thread>
+#include <utility>
 #include <vector>
 
 namespace sst {
 namespace util {
+/**
+ * Routes completion entries from the polling thread to the threads waiting
+ * for them. Each waiting thread owns a slot, addressed directly by the wr_id
+ * of its writes (the index returned by get_index), into which the polling
+ * thread pushes entries with atomic stores; no lock is taken on the
+ * completion path unless a slot's ring is full, in which case entries spill
+ * into a list instead of being dropped. Waiters spin briefly and then sleep
+ * on a futex.
+ */
 class PollingData {
-    static std::vector<std::list<std::pair<int32_t, int32_t>>> completion_entries;
-    static std::map<std::thread::id, uint32_t> tid_to_index;
-    static std::vector<bool> if_waiting;
-    static std::condition_variable poll_cv;
+public:
+    /** The maximum number of threads that can wait for completions. */
+    static constexpr uint32_t max_threads = 256;
+    /** Completion entries a slot's ring can hold before further ones spill. */
+    static constexpr uint32_t slot_capacity = 512;
+    /** Polls of its slot a waiting thread makes before sleeping. */
+    static constexpr uint32_t spin_count = 2000;
+
+private:
+    /** A completion entry, with its position in the sequence of entries of its slot. */
+    using SequencedEntry = std::pair<uint32_t, std::pair<int32_t, int32_t>>;
+
+    /**
+     * A single-producer (the polling thread), single-consumer (the owning
+     * thread) ring. Entries are numbered in the order they arrive; head and
+     * tail count them, whether they went into the ring or into the spill
+     * list, so the owner takes them in order.
+     */
+    struct CompletionSlot {
+        /** Written by the polling thread; also the futex word the owner sleeps on. */
+        std::atomic<uint32_t> tail{0};
+        /** Between tail and head, so the two writers don't share a cache line. */
+        std::array<SequencedEntry, slot_capacity> entries;
+        /** Written by the owning thread. */
+        std::atomic<uint32_t> head{0};
+        /** Set by the owner while it sleeps, so the polling thread knows to wake it. */
+        std::atomic<bool> sleeping{false};
+        /** Entries that arrived while the ring was full, oldest first. */
+        std::deque<SequencedEntry> spilled;
+        std::mutex spill_mutex;
+    };
+
+    /** The calling thread's slot index; returned to free_indices when the thread exits. */
+    struct ThreadSlot {
+        int32_t index = -1;
+        std::thread::id owner;
+        ~ThreadSlot();
+    };
+
+    static std::array<std::atomic<CompletionSlot*>, max_threads> slots;
+    static std::vector<std::unique_ptr<CompletionSlot>> slot_storage;
+    static std::vector<uint32_t> free_indices;
+    /** The slot index of each thread that has one. */
+    static std::map<std::thread::id, uint32_t> thread_indices;
+    static thread_local ThreadSlot thread_slot;
+    /** Guards slot registration, and the sleep of the polling thread in wait_for_requests. */
     static std::mutex poll_mutex;
+    static std::condition_variable poll_cv;
+    static std::atomic<uint32_t> num_waiting;
+    /** When num_waiting last became nonzero, in steady_clock nanoseconds. */
+    static std::atomic<uint64_t> waiting_since_ns;
 
-    static bool check_waiting();
+    static std::experimental::optional<std::pair<int32_t, int32_t>> take_entry(CompletionSlot& slot);
 
 public:
     void insert_completion_entry(uint32_t index, std::pair<int32_t, int32_t> ce);
 
+    /** Takes the next completion entry for the thread, without blocking. */
     std::experimental::optional<std::pair<int32_t, int32_t>> get_completion_entry(const std::thread::id id);
 
+    /**
+     * Waits for the next completion entry in the slot with this index, until
+     * the deadline. Spins for spin_count polls, then sleeps on a futex.
+     * @return The entry, or an empty optional if the deadline passed first
+     */
+    std::experimental::optional<std::pair<int32_t, int32_t>> wait_for_completion_entry(
+            uint32_t index, std::chrono::steady_clock::time_point deadline);
+
+    /**
+     * @return the slot index of the thread. The calling thread is given a
+     * slot the first time it asks; any other thread must already have one.
+     * @throws std::invalid_argument if id is another thread without a slot
+     */
     uint32_t get_index(const std::thread::id id);
 
+    /** Marks the thread as awaiting completions, discarding any stale entries in its slot. */
     void set_waiting(const std::thread::id id);
 
     void reset_waiting(const std::thread::id id);
 
-    void wait_for_requests();
+    /** @return true if any thread is waiting for a completion. */
+    bool has_waiting() const { return num_waiting.load() > 0; }
+
+    /** @return when threads last started waiting for completions, in steady_clock nanoseconds. */
+    uint64_t get_waiting_since() const { return waiting_since_ns.load(); }
+
+    /**
+     * Blocks the polling thread until some thread waits for a completion,
+     * or the timeout passes.
+     * @return true if a thread is waiting for a completion
+     */
+    bool wait_for_requests(std::chrono::milliseconds timeout);
 };
 
 //There is one global instance of PollingData
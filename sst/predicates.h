@@ -3,8 +3,10 @@
 #include <algorithm>
 #include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <utility>
+#include <vector>
 
 #include "sst.h"
 
@@ -25,44 +27,76 @@ enum class PredicateType {
     TRANSITION
 };
 
+/**
+ * The predicates of an SST, divided among the threads that evaluate them.
+ * Each predicate has an affinity key; predicates with the same key are always
+ * evaluated by the same thread, so their triggers never run concurrently with
+ * each other. Predicates without a key (a negative one) all go to the first
+ * thread; with more than one thread, keyed predicates are spread over the
+ * others.
+ */
 template <class DerivedSST>
 class Predicates {
     using pred = std::function<bool(const DerivedSST&)>;
     using trig = std::function<void(DerivedSST&)>;
     using pred_list = std::list<std::unique_ptr<std::pair<pred, std::shared_ptr<trig>>>>;
-    /** Predicate list for one-time predicates. */
-    pred_list one_time_predicates;
-    /** Predicate list for recurrent predicates */
-    pred_list recurrent_predicates;
-    /** Predicate list for transition predicates */
-    pred_list transition_predicates;
-    /** Contains one entry for every predicate in `transition_predicates`, in parallel. */
-    std::list<bool> transition_predicate_states;
+
+    /** The predicates evaluated by one thread. */
+    struct WorkerPredicates {
+        /** Predicate list for one-time predicates. */
+        pred_list one_time_predicates;
+        /** Predicate list for recurrent predicates */
+        pred_list recurrent_predicates;
+        /** Predicate list for transition predicates */
+        pred_list transition_predicates;
+        /** Contains one entry for every predicate in `transition_predicates`, in parallel. */
+        std::list<bool> transition_predicate_states;
+
+        std::mutex predicate_mutex;
+    };
+    std::vector<std::unique_ptr<WorkerPredicates>> workers;
     // SST needs to read these predicate lists directly
     friend class SST<DerivedSST>;
 
-    std::mutex predicate_mutex;
+    uint32_t worker_for(int32_t affinity) const {
+        if(affinity < 0 || workers.size() == 1) {
+            return 0;
+        }
+        return 1 + affinity % (workers.size() - 1);
+    }
 
 public:
+    /** @param num_workers The number of threads that evaluate the predicates */
+    explicit Predicates(uint32_t num_workers = 1) {
+        for(uint32_t i = 0; i < std::max(1u, num_workers); ++i) {
+            workers.emplace_back(std::make_unique<WorkerPredicates>());
+        }
+    }
+
+    /** @return the number of threads the predicates are divided among. */
+    uint32_t num_workers() const { return workers.size(); }
+
     class pred_handle {
         bool valid;
         typename pred_list::iterator iter;
         PredicateType type;
+        uint32_t worker;
         friend class Predicates;
 
     public:
-        pred_handle() : valid(false), type(PredicateType::ONE_TIME) {}
-        pred_handle(typename pred_list::iterator iter, PredicateType type)
-                : valid{true}, iter{iter}, type{type} {}
+        pred_handle() : valid(false), type(PredicateType::ONE_TIME), worker(0) {}
+        pred_handle(typename pred_list::iterator iter, PredicateType type, uint32_t worker)
+                : valid{true}, iter{iter}, type{type}, worker{worker} {}
         pred_handle(pred_handle&) = delete;
         pred_handle(pred_handle&& other)
-                : pred_handle(std::move(other.iter), other.type) {
+                : pred_handle(std::move(other.iter), other.type, other.worker) {
             other.valid = false;
         }
         pred_handle& operator=(pred_handle&) = delete;
         pred_handle& operator=(pred_handle&& other) {
             iter = std::move(other.iter);
             type = other.type;
+            worker = other.worker;
             valid = true;
             other.valid = false;
             return *this;
@@ -72,19 +106,22 @@ public:
         }
     };
 
-    /** Inserts a single (predicate, trigger) pair to the appropriate predicate list. */
+    /** Inserts a single (predicate, trigger) pair to the appropriate predicate
+     * list of the thread that owns the affinity key. */
     pred_handle insert(pred predicate, trig trigger,
-                       PredicateType type = PredicateType::ONE_TIME);
+                       PredicateType type = PredicateType::ONE_TIME,
+                       int32_t affinity = -1);
 
     /** Inserts a predicate with a list of triggers (which will be run in
      * sequence) to the appropriate predicate list. */
     pred_handle insert(pred predicate, const std::list<trig>& triggers,
-                       PredicateType type = PredicateType::ONE_TIME) {
+                       PredicateType type = PredicateType::ONE_TIME,
+                       int32_t affinity = -1) {
         return insert(predicate, [triggers](DerivedSST& t) {
             for(const auto& trigger : triggers)
                 trigger(t);
         },
-                      type);
+                      type, affinity);
     }
 
     /** Removes a (predicate, trigger) pair previously registered with insert(). */
@@ -103,29 +140,33 @@ public:
  * @param trigger The trigger to execute when the predicate is true.
  * @param type The type of predicate being inserted; default is
  * PredicateType::ONE_TIME
+ * @param affinity The key that decides which thread evaluates the predicate,
+ * such as a subgroup number; negative for the first thread
  */
 template <class DerivedSST>
-auto Predicates<DerivedSST>::insert(pred predicate, trig trigger, PredicateType type) -> pred_handle {
-    std::lock_guard<std::mutex> lock(predicate_mutex);
+auto Predicates<DerivedSST>::insert(pred predicate, trig trigger, PredicateType type, int32_t affinity) -> pred_handle {
+    const uint32_t worker = worker_for(affinity);
+    WorkerPredicates& lists = *workers[worker];
+    std::lock_guard<std::mutex> lock(lists.predicate_mutex);
     if(type == PredicateType::ONE_TIME) {
-        one_time_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
+        lists.one_time_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
                 predicate, std::make_shared<trig>(trigger)));
-        return pred_handle(--one_time_predicates.end(), type);
+        return pred_handle(--lists.one_time_predicates.end(), type, worker);
     } else if(type == PredicateType::RECURRENT) {
-        recurrent_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
+        lists.recurrent_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
                 predicate, std::make_shared<trig>(trigger)));
-        return pred_handle(--recurrent_predicates.end(), type);
+        return pred_handle(--lists.recurrent_predicates.end(), type, worker);
     } else {
-        transition_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
+        lists.transition_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
                 predicate, std::make_shared<trig>(trigger)));
-        transition_predicate_states.push_back(false);
-        return pred_handle(--transition_predicates.end(), type);
+        lists.transition_predicate_states.push_back(false);
+        return pred_handle(--lists.transition_predicates.end(), type, worker);
     }
 }
 
 template <class DerivedSST>
 void Predicates<DerivedSST>::remove(pred_handle& handle) {
-    std::lock_guard<std::mutex> lock(predicate_mutex);
+    std::lock_guard<std::mutex> lock(workers[handle.worker]->predicate_mutex);
     if(!handle.is_valid()) {
         return;
     }
@@ -135,14 +176,16 @@ void Predicates<DerivedSST>::remove(pred_handle& handle) {
 
 template <class DerivedSST>
 void Predicates<DerivedSST>::clear() {
-    std::lock_guard<std::mutex> lock(predicate_mutex);
     using ptr_to_pred = std::unique_ptr<std::pair<pred, std::shared_ptr<trig>>>;
-    std::for_each(one_time_predicates.begin(), one_time_predicates.end(),
-                  [](ptr_to_pred& ptr) { ptr.reset(); });
-    std::for_each(recurrent_predicates.begin(), recurrent_predicates.end(),
-                  [](ptr_to_pred& ptr) { ptr.reset(); });
-    std::for_each(transition_predicates.begin(), transition_predicates.end(),
-                  [](ptr_to_pred& ptr) { ptr.reset(); });
+    for(auto& lists : workers) {
+        std::lock_guard<std::mutex> lock(lists->predicate_mutex);
+        std::for_each(lists->one_time_predicates.begin(), lists->one_time_predicates.end(),
+                      [](ptr_to_pred& ptr) { ptr.reset(); });
+        std::for_each(lists->recurrent_predicates.begin(), lists->recurrent_predicates.end(),
+                      [](ptr_to_pred& ptr) { ptr.reset(); });
+        std::for_each(lists->transition_predicates.begin(), lists->transition_predicates.end(),
+                      [](ptr_to_pred& ptr) { ptr.reset(); });
+    }
 }
 
 } /* namespace sst */
@@ -1,7 +1,9 @@
 #include "dijkstra.h"
 
+#include <algorithm>
 #include <iterator>
 #include <set>
+#include <unordered_map>
 #include <utility>
 #include <iostream>
 
@@ -73,6 +75,187 @@ list<pair<vertex_t, vertex_t>> PathToLinks(list<vertex_t> path) {
 	return links;
 }
 
+DynamicShortestPaths::DynamicShortestPaths(vertex_t source, const adjacency_list_t& adjacency_list)
+	: source(source), out_edges(adjacency_list), in_edges(adjacency_list.size()),
+	  first_hop(adjacency_list.size(), -1), tree_children(adjacency_list.size())
+{
+	for (vertex_t u = 0; u < static_cast<vertex_t>(out_edges.size()); ++u) {
+		for (const neighbor& edge : out_edges[u]) {
+			in_edges[edge.target].push_back(neighbor(u, edge.weight));
+		}
+	}
+	DijkstraComputePaths(source, out_edges, min_distance, previous_vertex);
+	//Visit vertices in order of distance so that parents get first hops before their children
+	vector<vertex_t> order;
+	for (vertex_t v = 0; v < static_cast<vertex_t>(out_edges.size()); ++v) {
+		if (previous_vertex[v] != -1) {
+			tree_children[previous_vertex[v]].push_back(v);
+		}
+		order.push_back(v);
+	}
+	std::sort(order.begin(), order.end(), [this](vertex_t a, vertex_t b) {
+		return min_distance[a] < min_distance[b];
+	});
+	first_hop[source] = source;
+	for (vertex_t v : order) {
+		if (previous_vertex[v] != -1) {
+			first_hop[v] = previous_vertex[v] == source ? v : first_hop[previous_vertex[v]];
+		}
+	}
+}
+
+weight_t DynamicShortestPaths::set_weight(vector<neighbor>& edges, vertex_t target, weight_t weight) {
+	for (auto iter = edges.begin(); iter != edges.end(); ++iter) {
+		if (iter->target == target) {
+			weight_t old_weight = iter->weight;
+			if (weight == max_weight) {
+				edges.erase(iter);
+			} else {
+				iter->weight = weight;
+			}
+			return old_weight;
+		}
+	}
+	if (weight != max_weight) {
+		edges.push_back(neighbor(target, weight));
+	}
+	return max_weight;
+}
+
+void DynamicShortestPaths::set_parent(vertex_t vertex, vertex_t parent) {
+	vertex_t old_parent = previous_vertex[vertex];
+	if (old_parent == parent) {
+		return;
+	}
+	if (old_parent != -1) {
+		vector<vertex_t>& siblings = tree_children[old_parent];
+		siblings.erase(std::find(siblings.begin(), siblings.end(), vertex));
+	}
+	if (parent != -1) {
+		tree_children[parent].push_back(vertex);
+	}
+	previous_vertex[vertex] = parent;
+}
+
+void DynamicShortestPaths::collect_subtree(vertex_t root, vector<vertex_t>& subtree) const {
+	size_t next = subtree.size();
+	subtree.push_back(root);
+	for ( ; next < subtree.size(); ++next) {
+		const vector<vertex_t>& children = tree_children[subtree[next]];
+		subtree.insert(subtree.end(), children.begin(), children.end());
+	}
+}
+
+size_t DynamicShortestPaths::update(const vector<edge_change>& changes,
+		vector<vertex_t>& changed_first_hops,
+		vector<pair<vertex_t, vertex_t>>& changed_links)
+{
+	changed_first_hops.clear();
+	changed_links.clear();
+	const size_t n = out_edges.size();
+	//Parent of each vertex before the update, for the vertices that were touched
+	std::unordered_map<vertex_t, vertex_t> old_parent;
+	vector<char> invalidated(n, false);
+	vector<vertex_t> invalidated_vertices;
+	vector<edge_change> decreases;
+	for (const edge_change& change : changes) {
+		weight_t old_weight = set_weight(out_edges[change.source], change.target, change.weight);
+		set_weight(in_edges[change.target], change.source, change.weight);
+		if (change.weight > old_weight) {
+			//Only an edge on the tree can lengthen any path
+			if (previous_vertex[change.target] == change.source && !invalidated[change.target]) {
+				size_t first = invalidated_vertices.size();
+				collect_subtree(change.target, invalidated_vertices);
+				for (size_t i = first; i < invalidated_vertices.size(); ++i) {
+					invalidated[invalidated_vertices[i]] = true;
+				}
+			}
+		} else if (change.weight < old_weight) {
+			decreases.push_back(change);
+		}
+	}
+
+	std::set<pair<weight_t, vertex_t>> vertex_queue;
+	auto relax = [&](vertex_t u, vertex_t v, weight_t weight) {
+		weight_t distance_through_u = min_distance[u] + weight;
+		if (distance_through_u < min_distance[v]) {
+			vertex_queue.erase(make_pair(min_distance[v], v));
+			old_parent.emplace(v, previous_vertex[v]);
+			min_distance[v] = distance_through_u;
+			set_parent(v, u);
+			vertex_queue.insert(make_pair(distance_through_u, v));
+		}
+	};
+	//Detach the invalidated subtrees, then reattach each vertex through its best edge from outside them
+	for (vertex_t v : invalidated_vertices) {
+		old_parent.emplace(v, previous_vertex[v]);
+		min_distance[v] = max_weight;
+	}
+	for (vertex_t v : invalidated_vertices) {
+		set_parent(v, -1);
+	}
+	for (vertex_t v : invalidated_vertices) {
+		for (const neighbor& edge : in_edges[v]) {
+			if (!invalidated[edge.target] && min_distance[edge.target] != max_weight) {
+				relax(edge.target, v, edge.weight);
+			}
+		}
+	}
+	for (const edge_change& change : decreases) {
+		if (min_distance[change.source] != max_weight) {
+			relax(change.source, change.target, change.weight);
+		}
+	}
+	while (!vertex_queue.empty()) {
+		vertex_t u = vertex_queue.begin()->second;
+		vertex_queue.erase(vertex_queue.begin());
+		for (const neighbor& edge : out_edges[u]) {
+			relax(u, edge.target, edge.weight);
+		}
+	}
+
+	//Only the touched vertices and the subtrees below them can have new first hops
+	vector<pair<vertex_t, vertex_t>> added_links;
+	vector<vertex_t> recheck;
+	for (const auto& entry : old_parent) {
+		vertex_t v = entry.first;
+		if (entry.second == previous_vertex[v]) {
+			continue;
+		}
+		if (entry.second != -1) {
+			changed_links.push_back(make_pair(entry.second, v));
+		}
+		if (previous_vertex[v] != -1) {
+			added_links.push_back(make_pair(previous_vertex[v], v));
+		}
+		recheck.push_back(v);
+	}
+	const size_t num_removed = changed_links.size();
+	changed_links.insert(changed_links.end(), added_links.begin(), added_links.end());
+	//Recompute top-down, so a vertex's parent is done before the vertex
+	std::sort(recheck.begin(), recheck.end(), [this](vertex_t a, vertex_t b) {
+		return min_distance[a] < min_distance[b];
+	});
+	vector<char> rechecked(n, false);
+	for (vertex_t root : recheck) {
+		if (rechecked[root]) {
+			continue;
+		}
+		vector<vertex_t> subtree;
+		collect_subtree(root, subtree);
+		for (vertex_t v : subtree) {
+			rechecked[v] = true;
+			vertex_t parent = previous_vertex[v];
+			vertex_t hop = parent == -1 ? -1 : (parent == source ? v : first_hop[parent]);
+			if (hop != first_hop[v]) {
+				first_hop[v] = hop;
+				changed_first_hops.push_back(v);
+			}
+		}
+	}
+	return num_removed;
+}
+
 } //namespace path_finding
 
 } //namespace sst
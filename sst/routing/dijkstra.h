@@ -1,6 +1,7 @@
 #ifndef ROUTING_DIJKSTRA_H_
 #define ROUTING_DIJKSTRA_H_
 
+#include <cstddef>
 #include <limits> // for numeric_limits
 #include <list>
 #include <vector>
@@ -39,6 +40,66 @@ std::list<vertex_t> DijkstraGetShortestPathTo(vertex_t vertex,
 
 std::list<std::pair<vertex_t, vertex_t>> PathToLinks(std::list<vertex_t> path);
 
+/** A change to the weight of the edge from source to target; a weight of
+ * max_weight means the edge no longer exists. */
+struct edge_change {
+	vertex_t source;
+	vertex_t target;
+	weight_t weight;
+	edge_change(vertex_t arg_source, vertex_t arg_target, weight_t arg_weight)
+	: source(arg_source), target(arg_target), weight(arg_weight) { }
+};
+
+/**
+ * A shortest-path tree from a single source that is kept up to date as edge
+ * weights change, without rerunning Dijkstra over the whole graph. An
+ * increase (or removal) of a tree edge only invalidates the subtree below
+ * it; those vertices are reattached through their cheapest edge from the
+ * rest of the tree and the changes are propagated Dijkstra-style from there.
+ * A decrease is propagated from the edge's target. Each vertex also records
+ * the first hop on its path from the source, and an update reports the
+ * vertices whose first hop changed.
+ */
+class DynamicShortestPaths {
+	vertex_t source;
+	adjacency_list_t out_edges;
+	/** For each vertex, the sources of its incoming edges (in `target`). */
+	adjacency_list_t in_edges;
+	std::vector<weight_t> min_distance;
+	std::vector<vertex_t> previous_vertex;
+	std::vector<vertex_t> first_hop;
+	std::vector<std::vector<vertex_t>> tree_children;
+
+	/** Sets the weight of the edge in the list that points to target,
+	 * returning its old weight. */
+	static weight_t set_weight(std::vector<neighbor>& edges, vertex_t target, weight_t weight);
+	void set_parent(vertex_t vertex, vertex_t parent);
+	void collect_subtree(vertex_t root, std::vector<vertex_t>& subtree) const;
+
+public:
+	DynamicShortestPaths(vertex_t source, const adjacency_list_t& adjacency_list);
+
+	/**
+	 * Applies a batch of edge weight changes and repairs the shortest-path
+	 * tree.
+	 * @param changes The edges whose weights changed
+	 * @param changed_first_hops Filled with the vertices whose first hop
+	 * changed, including ones that became (un)reachable
+	 * @param changed_links Filled with the tree links (parent, vertex) that
+	 * were removed from the tree, followed by the ones that were added
+	 * @return the number of removed links at the front of changed_links
+	 */
+	size_t update(const std::vector<edge_change>& changes,
+			std::vector<vertex_t>& changed_first_hops,
+			std::vector<std::pair<vertex_t, vertex_t>>& changed_links);
+
+	const std::vector<weight_t>& distances() const { return min_distance; }
+	const std::vector<vertex_t>& previous_vertexes() const { return previous_vertex; }
+	/** @return the first hop from the source toward each vertex; the vertex
+	 * itself for the source, -1 if unreachable. */
+	const std::vector<vertex_t>& first_hops() const { return first_hop; }
+};
+
 } //namespace path_finding
 
 } //namespace sst
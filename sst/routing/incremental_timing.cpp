@@ -0,0 +1,197 @@
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "sst/experiments/statistics.h"
+#include "dijkstra.h"
+
+using std::tie;
+using std::string;
+using std::vector;
+using std::pair;
+using std::make_pair;
+
+using namespace sst::path_finding;
+
+/*
+ * Compares rebuilding the routing state from scratch with Dijkstra against
+ * repairing it with DynamicShortestPaths, for random link flaps (a link
+ * going down, then coming back up with its old cost) in random networks of
+ * 30 to 1000 nodes. Both halves of each flap are timed separately. Both
+ * sides produce the first hop for every destination, which is what the
+ * router's forwarding table needs; after every change the incremental side's
+ * distances and first hops are checked against the full recompute.
+ */
+
+static const long long int SECONDS_TO_NS = 1000000000LL;
+static const int EXPERIMENT_REPS = 1000;
+static const int LINKS_PER_NODE = 4;
+/** The two halves of a flap, indexing the timing vectors. */
+static const int LINK_DOWN = 0;
+static const int LINK_UP = 1;
+
+long long int now_ns() {
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return now.tv_sec * SECONDS_TO_NS + now.tv_nsec;
+}
+
+void set_link_cost(adjacency_list_t& graph, vertex_t source, vertex_t target, weight_t weight) {
+	for (auto iter = graph[source].begin(); iter != graph[source].end(); ++iter) {
+		if (iter->target == target) {
+			if (weight == max_weight) {
+				graph[source].erase(iter);
+			} else {
+				iter->weight = weight;
+			}
+			return;
+		}
+	}
+	if (weight != max_weight) {
+		graph[source].push_back(neighbor(target, weight));
+	}
+}
+
+weight_t link_cost(const adjacency_list_t& graph, vertex_t source, vertex_t target) {
+	for (const neighbor& edge : graph[source]) {
+		if (edge.target == target) {
+			return edge.weight;
+		}
+	}
+	return max_weight;
+}
+
+/** What the router does today: Dijkstra over the whole graph, then a first hop per destination. */
+void full_recompute(vertex_t source, const adjacency_list_t& graph, vector<weight_t>& min_distance, vector<vertex_t>& first_hop) {
+	vector<vertex_t> previous_vertexes;
+	DijkstraComputePaths(source, graph, min_distance, previous_vertexes);
+	for (vertex_t dest = 0; dest < static_cast<vertex_t>(graph.size()); ++dest) {
+		vertex_t hop = dest;
+		while (hop != -1 && previous_vertexes[hop] != source) {
+			hop = previous_vertexes[hop];
+		}
+		first_hop[dest] = dest == source ? source : hop;
+	}
+}
+
+/**
+ * Checks the incremental first hops against the full recompute. Where two
+ * paths tie, the two sides may pick different first hops, so a differing
+ * hop is still correct if the incremental tree's path to the destination
+ * starts with it and uses only edges that are tight under min_distance.
+ * @return the number of destinations whose first hop is wrong
+ */
+int check_first_hops(vertex_t source, const adjacency_list_t& graph, const vector<weight_t>& min_distance,
+		const vector<vertex_t>& first_hop, const DynamicShortestPaths& paths) {
+	int wrong = 0;
+	for (vertex_t dest = 0; dest < static_cast<vertex_t>(graph.size()); ++dest) {
+		const vertex_t hop = paths.first_hops()[dest];
+		if (hop == first_hop[dest]) {
+			continue;
+		}
+		bool valid = dest != source && min_distance[dest] != max_weight;
+		vertex_t vertex = dest;
+		while (valid && paths.previous_vertexes()[vertex] != source) {
+			const vertex_t parent = paths.previous_vertexes()[vertex];
+			const weight_t cost = parent == -1 ? max_weight : link_cost(graph, parent, vertex);
+			valid = cost != max_weight && min_distance[parent] + cost == min_distance[vertex];
+			vertex = parent;
+		}
+		valid = valid && vertex == hop && link_cost(graph, source, hop) == min_distance[hop];
+		if (!valid) {
+			++wrong;
+		}
+	}
+	return wrong;
+}
+
+void time_flaps(int num_nodes, std::mt19937& rng, vector<long long int> full_start[2], vector<long long int> full_end[2],
+		vector<long long int> incremental_start[2], vector<long long int> incremental_end[2], int& mismatches) {
+	//A ring, so the network starts out connected, plus random links
+	std::uniform_int_distribution<int> node_dist(0, num_nodes - 1);
+	std::uniform_int_distribution<int> cost_dist(1, 10);
+	adjacency_list_t graph(num_nodes);
+	vector<pair<vertex_t, vertex_t>> links;
+	auto add_link = [&](vertex_t a, vertex_t b) {
+		weight_t cost = cost_dist(rng);
+		set_link_cost(graph, a, b, cost);
+		set_link_cost(graph, b, a, cost);
+		links.push_back(make_pair(a, b));
+	};
+	for (vertex_t node = 0; node < num_nodes; ++node) {
+		add_link(node, (node + 1) % num_nodes);
+		for (int i = 1; i < LINKS_PER_NODE / 2; ++i) {
+			vertex_t other = node_dist(rng);
+			if (other != node) {
+				add_link(node, other);
+			}
+		}
+	}
+
+	const vertex_t source = 0;
+	DynamicShortestPaths paths(source, graph);
+	vector<weight_t> min_distance(num_nodes);
+	vector<vertex_t> first_hop(num_nodes);
+	vector<vertex_t> changed_first_hops;
+	vector<pair<vertex_t, vertex_t>> changed_links;
+	std::uniform_int_distribution<size_t> link_dist(0, links.size() - 1);
+	for (int rep = 0; rep < EXPERIMENT_REPS; ++rep) {
+		vertex_t a, b;
+		tie(a, b) = links[link_dist(rng)];
+		const weight_t cost = link_cost(graph, a, b);
+		//Take the link down, then bring it back
+		for (int half : {LINK_DOWN, LINK_UP}) {
+			const weight_t new_cost = half == LINK_DOWN ? max_weight : cost;
+			set_link_cost(graph, a, b, new_cost);
+			set_link_cost(graph, b, a, new_cost);
+			vector<edge_change> changes{edge_change(a, b, new_cost), edge_change(b, a, new_cost)};
+
+			full_start[half][rep] = now_ns();
+			full_recompute(source, graph, min_distance, first_hop);
+			full_end[half][rep] = now_ns();
+
+			incremental_start[half][rep] = now_ns();
+			paths.update(changes, changed_first_hops, changed_links);
+			incremental_end[half][rep] = now_ns();
+			if (paths.distances() != min_distance
+					|| check_first_hops(source, graph, min_distance, first_hop, paths) != 0) {
+				++mismatches;
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	std::ofstream data_out_stream(string("incremental_routing_timing.csv").c_str());
+	std::mt19937 rng(12345);
+
+	for (int num_nodes : {30, 100, 300, 1000}) {
+		vector<long long int> full_start[2], full_end[2], incremental_start[2], incremental_end[2];
+		for (int half : {LINK_DOWN, LINK_UP}) {
+			full_start[half].resize(EXPERIMENT_REPS);
+			full_end[half].resize(EXPERIMENT_REPS);
+			incremental_start[half].resize(EXPERIMENT_REPS);
+			incremental_end[half].resize(EXPERIMENT_REPS);
+		}
+		int mismatches = 0;
+		time_flaps(num_nodes, rng, full_start, full_end, incremental_start, incremental_end, mismatches);
+		data_out_stream << num_nodes;
+		for (int half : {LINK_DOWN, LINK_UP}) {
+			double full_mean, full_stdev, incremental_mean, incremental_stdev;
+			tie(full_mean, full_stdev) = sst::experiments::compute_statistics(full_start[half], full_end[half]);
+			tie(incremental_mean, incremental_stdev) = sst::experiments::compute_statistics(incremental_start[half], incremental_end[half]);
+			std::cout << num_nodes << " nodes, link " << (half == LINK_DOWN ? "down" : "up") << ": full "
+					<< full_mean << " us, incremental " << incremental_mean << " us" << std::endl;
+			data_out_stream << "," << full_mean << "," << full_stdev << ","
+					<< incremental_mean << "," << incremental_stdev;
+		}
+		std::cout << num_nodes << " nodes: " << mismatches << " updates mismatched the full recompute" << std::endl;
+		data_out_stream << "," << mismatches << std::endl;
+	}
+
+	data_out_stream.close();
+}
@@ -130,6 +130,8 @@ int main (int argc, char** argv) {
 
   //Compute initial routing table
   compute_routing_table(this_node_rank, num_nodes, forwarding_table, links_used, *linkstate_snapshot);
+  sst::path_finding::DynamicShortestPaths paths(this_node_rank, build_network_graph(num_nodes, *linkstate_snapshot));
+  vector<int> changed_destinations;
 //  print_routing_table(forwarding_table);
 
 
@@ -152,10 +154,12 @@ int main (int argc, char** argv) {
 	  return false;
   };
 
-  //Action: Recompute my local routing table
-  auto recompute_action = [&forwarding_table, &links_used, &linkstate_snapshot] (RoutingSST& sst) {
-	  linkstate_snapshot = sst.get_snapshot();
-	  compute_routing_table(this_node_rank, num_nodes, forwarding_table, links_used, *linkstate_snapshot);
+  //Action: Update the routes in my local routing table that the link changes affect
+  auto recompute_action = [&forwarding_table, &links_used, &linkstate_snapshot, &paths, &changed_destinations] (RoutingSST& sst) {
+	  std::unique_ptr<RoutingSST::SST_Snapshot> new_snapshot = sst.get_snapshot();
+	  update_routing_table(paths, num_nodes, forwarding_table, links_used, *linkstate_snapshot, *new_snapshot,
+			  changed_destinations);
+	  linkstate_snapshot = std::move(new_snapshot);
 	  //If the recompute was triggered by the experiment, not the reset...
 	  if((*linkstate_snapshot)[0].link_cost[1] == 10) {
 		  //Update the barrier
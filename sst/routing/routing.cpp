@@ -52,15 +52,7 @@ void compute_routing_table(int this_node_num, int num_nodes, vector<int>& forwar
         RoutingSST::SST_Snapshot& linkstate_rows) {
     assert(forwarding_table.size() == static_cast<vector<int>::size_type>(num_nodes));
 	//Build a graph of the network from the link state table, then pass it to Dijkstra
-	path_finding::adjacency_list_t network_adjacency_list(num_nodes);
-	for (int source = 0; source < num_nodes; ++source) {
-		for (int target = 0; target < num_nodes; ++target) {
-			if (source != target && linkstate_rows[source].link_cost[target] > 0) {
-				network_adjacency_list[source].push_back(
-						path_finding::neighbor(target, linkstate_rows[source].link_cost[target]));
-			}
-		}
-	}
+	path_finding::adjacency_list_t network_adjacency_list = build_network_graph(num_nodes, linkstate_rows);
 	vector<path_finding::weight_t> min_distance; //Unused output parameter
 	vector<path_finding::vertex_t> previous_vertexes;
 	path_finding::DijkstraComputePaths(this_node_num, network_adjacency_list,
@@ -81,6 +73,74 @@ void compute_routing_table(int this_node_num, int num_nodes, vector<int>& forwar
 	}
 }
 
+/**
+ * @details
+ * A link whose cost is not positive does not exist.
+ *
+ * @param num_nodes The number of nodes in the system
+ * @param linkstate_rows The link state table, which is a snapshot of the
+ * link state SST.
+ * @return An adjacency list with an edge for every link, weighted by its cost
+ */
+path_finding::adjacency_list_t build_network_graph(int num_nodes, RoutingSST::SST_Snapshot& linkstate_rows) {
+	path_finding::adjacency_list_t network_adjacency_list(num_nodes);
+	for (int source = 0; source < num_nodes; ++source) {
+		for (int target = 0; target < num_nodes; ++target) {
+			if (source != target && linkstate_rows[source].link_cost[target] > 0) {
+				network_adjacency_list[source].push_back(
+						path_finding::neighbor(target, linkstate_rows[source].link_cost[target]));
+			}
+		}
+	}
+	return network_adjacency_list;
+}
+
+/**
+ * @details
+ * Compares the two snapshots row by row and hands only the links whose cost
+ * changed to the dynamic shortest-path tree, which repairs the parts of the
+ * tree they affect instead of rerunning Dijkstra over the whole graph.
+ *
+ * @param[in,out] paths The shortest-path tree from the local node, built
+ * from the graph of `old_linkstate_rows`
+ * @param[in] num_nodes The number of nodes in the system
+ * @param[in,out] forwarding_table The routing table to update
+ * @param[in,out] links_used The set of links used by the routing paths, as
+ * computed by compute_routing_table
+ * @param[in] old_linkstate_rows The link state table the routing table was
+ * last computed from
+ * @param[in] new_linkstate_rows The current link state table
+ * @param[out] changed_destinations The destinations whose forwarding entry
+ * changed
+ */
+void update_routing_table(path_finding::DynamicShortestPaths& paths, int num_nodes, vector<int>& forwarding_table,
+		unordered_set<pair<int, int>>& links_used, RoutingSST::SST_Snapshot& old_linkstate_rows,
+		RoutingSST::SST_Snapshot& new_linkstate_rows, vector<int>& changed_destinations) {
+	vector<path_finding::edge_change> changes;
+	for (int source = 0; source < num_nodes; ++source) {
+		for (int target = 0; target < num_nodes; ++target) {
+			int old_cost = old_linkstate_rows[source].link_cost[target];
+			int new_cost = new_linkstate_rows[source].link_cost[target];
+			if (source != target && old_cost != new_cost) {
+				changes.push_back(path_finding::edge_change(source, target,
+						new_cost > 0 ? new_cost : path_finding::max_weight));
+			}
+		}
+	}
+	vector<pair<path_finding::vertex_t, path_finding::vertex_t>> changed_links;
+	size_t num_removed = paths.update(changes, changed_destinations, changed_links);
+	for (size_t i = 0; i < changed_links.size(); ++i) {
+		if (i < num_removed) {
+			links_used.erase(changed_links[i]);
+		} else {
+			links_used.insert(changed_links[i]);
+		}
+	}
+	for (int dest_node : changed_destinations) {
+		forwarding_table[dest_node] = paths.first_hops()[dest_node];
+	}
+}
+
 /**
  * @param forwarding_table The routing table to print, as a vector mapping
  * destination node ranks to first hops on the path.
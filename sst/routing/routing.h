@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "sst/sst.h"
+#include "dijkstra.h"
 #include "lsdb_row.h"
 #include "std_hashes.h"
 
@@ -23,6 +24,17 @@ using RoutingSST = SST<LSDB_Row<RACK_SIZE>, Mode::Writes>;
 void compute_routing_table(int this_node_num, int num_nodes, std::vector<int>& forwarding_table, std::unordered_set<std::pair<int, int>>& links_used,
 		RoutingSST::SST_Snapshot& linkstate_rows);
 
+/** Builds a graph of network connectivity from the link state information
+ * provided in `linkstate_rows`. */
+path_finding::adjacency_list_t build_network_graph(int num_nodes, RoutingSST::SST_Snapshot& linkstate_rows);
+
+/** Updates a routing table created by compute_routing_table to reflect the
+ * changes between two link state snapshots, touching only the entries whose
+ * route changed. */
+void update_routing_table(path_finding::DynamicShortestPaths& paths, int num_nodes, std::vector<int>& forwarding_table,
+		std::unordered_set<std::pair<int, int>>& links_used, RoutingSST::SST_Snapshot& old_linkstate_rows,
+		RoutingSST::SST_Snapshot& new_linkstate_rows, std::vector<int>& changed_destinations);
+
 /** Prints a routing table to stdout. */
 void print_routing_table(std::vector<int>& forwarding_table);
 
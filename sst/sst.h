@@ -4,6 +4,7 @@
 #include <bitset>
 #include <cassert>
 #include <condition_variable>
+#include <cstdlib>
 #include <functional>
 #include <iostream>
 #include <list>
@@ -14,8 +15,10 @@
 #include <string.h>
 #include <string>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
+#include "derecho/placement.h"
 #include "predicates.h"
 #include "verbs.h"
 
@@ -26,25 +29,60 @@ namespace sst {
 const int alignTo = sizeof(long);
 
 constexpr int padded_len(const int& len) {
-    return (len < alignTo) ? alignTo : (len + alignTo) | (alignTo - 1);
+    return (len < alignTo) ? alignTo : (len + alignTo - 1) & ~(alignTo - 1);
 }
 
+/** The unit of the cache-line placement hints. */
+constexpr int cache_line_size = 64;
+
+constexpr int round_up_to_cache_line(const int& offset) {
+    return (offset + cache_line_size - 1) & ~(cache_line_size - 1);
+}
+
+/**
+ * Placement hints for an SST field, applied when the row layout is computed.
+ * Fields are laid out in the order they are passed to SSTInit, so a group of
+ * hot fields that are updated and pushed together should be passed
+ * consecutively, with the first one CACHE_LINE_ALIGNED.
+ */
+enum class Placement {
+    /** Packed right after the previous field. */
+    PACKED,
+    /** Starts on a cache line boundary. */
+    CACHE_LINE_ALIGNED,
+    /** Starts and ends on cache line boundaries, so NIC writes to its
+     * neighbours never touch the cache lines it occupies. */
+    CACHE_LINE_ISOLATED
+};
+
 /** Internal helper class, never exposed to the client. */
 class _SSTField {
 public:
     volatile char* base;
     int rowLen;
     int field_len;
+    Placement placement;
+    /** Where the field starts within a row; set when the row layout is computed. */
+    int row_offset;
+
+    _SSTField(const int field_len) : base(nullptr), rowLen(0), field_len(field_len), placement(Placement::PACKED), row_offset(0) {}
 
-    _SSTField(const int field_len) : base(nullptr), rowLen(0), field_len(field_len) {}
+    /** Sets the placement hint; must be called before SSTInit. */
+    void set_placement(Placement p) { placement = p; }
+
+    /** @return the offset within the row at which this field starts, if the previous field ends at offset. */
+    int start_offset(const int offset) const {
+        return placement == Placement::PACKED ? offset : round_up_to_cache_line(offset);
+    }
 
-    virtual bool operator==(_SSTField const&) {
-        assert(false);
+    /** @return the offset within the row after this field, if it starts at offset. */
+    int end_offset(const int offset) const {
+        const int end = offset + padded_len(field_len);
+        return placement == Placement::CACHE_LINE_ISOLATED ? round_up_to_cache_line(end) : end;
     }
 
-    int set_base(volatile char* const base) {
+    void set_base(volatile char* const base) {
         this->base = base;
-        return padded_len(field_len);
     }
 
     char* get_base() {
@@ -116,6 +154,135 @@ public:
     }
 };
 
+/**
+ * An SST field for values larger than a word that remote rows may overwrite
+ * while they are being read. The value is stored between two copies of a
+ * version stamp, and the whole field is pushed with a single put, so the NIC
+ * writes the leading stamp first and the trailing stamp last. A reader that
+ * sees the same stamp at both ends has a copy that no write overlapped;
+ * otherwise it is told to retry, with no lock and no extra synchronizing
+ * write.
+ *
+ * Only the owner of a row may write it, with write(), and must then put the
+ * field as a whole (get_base() and field_len give its offset and length).
+ */
+template <typename T>
+class SSTFieldVersioned : public _SSTField {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "SSTFieldVersioned values are copied with memcpy");
+
+    struct Stamped {
+        uint64_t begin_version;
+        T value;
+        uint64_t end_version;
+    };
+
+    volatile Stamped& stamped(const int row_idx) const {
+        return *(volatile Stamped*)(base + row_idx * rowLen);
+    }
+
+public:
+    using _SSTField::base;
+    using _SSTField::rowLen;
+    using _SSTField::field_len;
+    using value_type = T;
+
+    SSTFieldVersioned() : _SSTField(sizeof(Stamped)) {
+    }
+
+    /** Sets the value and its version to 0; for initializing rows before any put. */
+    void init(const int row_idx, const T& initial) {
+        volatile Stamped& s = stamped(row_idx);
+        s.begin_version = 0;
+        memcpy(const_cast<T*>(&s.value), &initial, sizeof(T));
+        s.end_version = 0;
+    }
+
+    /**
+     * Stores a new value in a row, which must be the local row, and bumps its
+     * version. Readers of this row (including local ones) will retry until
+     * the write is complete.
+     */
+    void write(const int row_idx, const T& value) {
+        volatile Stamped& s = stamped(row_idx);
+        const uint64_t version = s.end_version + 1;
+        s.begin_version = version;
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(const_cast<T*>(&s.value), &value, sizeof(T));
+        std::atomic_thread_fence(std::memory_order_release);
+        s.end_version = version;
+    }
+
+    /**
+     * Copies the value in a row, if no write to it was in progress.
+     * @param row_idx The row to read
+     * @param out Receives the value; its contents are unspecified on failure
+     * @return true if out holds a consistent copy, false if the caller should retry
+     */
+    bool read(const int row_idx, T& out) const {
+        volatile Stamped& s = stamped(row_idx);
+        const uint64_t end_version = s.end_version;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        memcpy(&out, const_cast<const T*>(&s.value), sizeof(T));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return s.begin_version == end_version;
+    }
+
+    /**
+     * Copies the value in a row, retrying until the copy is consistent.
+     * @return the number of retries it took
+     */
+    uint32_t read_consistent(const int row_idx, T& out) const {
+        uint32_t retries = 0;
+        while(!read(row_idx, out)) {
+            ++retries;
+        }
+        return retries;
+    }
+
+    /** @return the version of the last write to the row that has fully arrived. */
+    uint64_t version(const int row_idx) const { return stamped(row_idx).end_version; }
+};
+
+/**
+ * An SST whose whole row is a standard-layout struct, as an alternative to
+ * declaring it field by field. The row length is then known at compile time:
+ * indexing a row is a multiplication by a constant, so the compiler can fold
+ * member offsets into the address and unroll or vectorize scans across rows,
+ * and the range of a put can be computed with offsetof, e.g.
+ * put(offsetof(Row, member), sizeof(Row::member)).
+ *
+ * It must be the only field passed to SSTInit, and cannot be used with a
+ * relay region, since either would make the row longer than the struct. Use
+ * SSTField and SSTFieldVector when the row's size is only known at runtime.
+ */
+template <typename Row>
+class SSTRows : public _SSTField {
+    static_assert(std::is_standard_layout<Row>::value,
+                  "SSTRows rows must be standard-layout so that offsetof works");
+
+public:
+    using _SSTField::base;
+    using value_type = Row;
+    /** The distance between consecutive rows, which is the length of a row. */
+    static constexpr int stride = padded_len(sizeof(Row));
+
+    SSTRows() : _SSTField(sizeof(Row)) {
+    }
+
+    volatile Row& operator[](const int row_idx) const {
+        return *(volatile Row*)(base + row_idx * stride);
+    }
+
+    /** Checks that the SST's row is exactly this struct; called by SSTInit. */
+    void set_rowLen(const int& _rowLen) {
+        if(_rowLen != stride) {
+            throw std::logic_error("SSTRows must be the only field of an SST, without a relay region");
+        }
+        rowLen = _rowLen;
+    }
+};
+
 typedef std::function<void(uint32_t)> failure_upcall_t;
 
 /** Constructor parameter pack for SST. */
@@ -125,6 +292,10 @@ struct SSTParams {
     const failure_upcall_t failure_upcall;
     const std::vector<char> already_failed;
     const bool start_predicate_thread;
+    const uint32_t relay_fanout;
+    const uint32_t num_detect_threads;
+    const uint32_t tcp_port;
+    const std::shared_ptr<TransportContext> context;
 
     /**
      *
@@ -141,17 +312,34 @@ struct SSTParams {
      * should be started immediately on construction of the SST. If false,
      * predicate evaluation will not start until start_predicate_evalution()
      * is called.
+     * @param relay_fanout If nonzero, group-wide puts of the relay region
+     * (see SST::set_relay_fields) travel over a tree of members with this
+     * many children per node, instead of being written to every member.
+     * @param num_detect_threads The number of threads that evaluate
+     * predicates; see Predicates for how predicates are divided among them.
+     * @param tcp_port The port of the TCP connections, set up by
+     * verbs_initialize, used to connect to the members.
+     * @param context The transport context to connect through; if null, the
+     * context of my_node_id.
      */
     SSTParams(const std::vector<uint32_t>& _members,
               const uint32_t my_node_id,
               const failure_upcall_t failure_upcall = nullptr,
               const std::vector<char> already_failed = {},
-              const bool start_predicate_thread = true)
+              const bool start_predicate_thread = true,
+              const uint32_t relay_fanout = 0,
+              const uint32_t num_detect_threads = 1,
+              const uint32_t tcp_port = derecho::sst_tcp_port,
+              std::shared_ptr<TransportContext> context = nullptr)
             : members(_members),
               my_node_id(my_node_id),
               failure_upcall(failure_upcall),
               already_failed(already_failed),
-              start_predicate_thread(start_predicate_thread) {}
+              start_predicate_thread(start_predicate_thread),
+              relay_fanout(relay_fanout),
+              num_detect_threads(num_detect_threads),
+              tcp_port(tcp_port),
+              context(context ? std::move(context) : TransportContext::get(my_node_id)) {}
 };
 
 template <class DerivedSST>
@@ -160,11 +348,32 @@ private:
     template <typename... Fields>
     void init_SSTFields(Fields&... fields) {
         rowLen = 0;
-        compute_rowLen(rowLen, fields...);
-        rows = new char[rowLen * num_members];
+        bool cache_line_placement = false;
+        compute_rowLen(rowLen, cache_line_placement, fields...);
+        // The two relay slots go after the fields, on their own cache lines
+        if(relay_fanout && relay_first) {
+            relay_begin = relay_first->row_offset;
+            relay_end = relay_last->row_offset + padded_len(relay_last->field_len);
+            relay_slot_len = 2 * sizeof(uint64_t) + padded_len(relay_end - relay_begin);
+            relay_slots_offset = round_up_to_cache_line(rowLen);
+            rowLen = relay_slots_offset + 2 * relay_slot_len;
+            cache_line_placement = true;
+        }
+        // Keep every row, not just the first, aligned to the hints
+        if(cache_line_placement) {
+            rowLen = round_up_to_cache_line(rowLen);
+        }
+        // Fields that reject the row length throw here, before there are rows to free
+        set_rowLens(rowLen, fields...);
+        // Page-aligned, so also aligned to a cache line
+        rows = derecho::allocate_registered_memory(rowLen * num_members);
         // snapshot = new char[rowLen * num_members];
-        volatile char* base = rows;
-        set_bases_and_rowLens(base, rowLen, fields...);
+        set_bases(fields...);
+        for(unsigned int row = 0; row < num_members; ++row) {
+            memset(const_cast<char*>(rows) + row * rowLen + relay_slots_offset, 0, 2 * relay_slot_len);
+        }
+        relay_applied.assign(num_members, 0);
+        relay_scratch.resize(relay_slot_len);
     }
 
     DerivedSST* derived_this;
@@ -172,7 +381,10 @@ private:
     std::vector<std::thread> background_threads;
     std::atomic<bool> thread_shutdown;
 
-    void detect();
+    /** Evaluates the predicates of one worker; worker 0 also relays updates. */
+    void detect(uint32_t worker);
+    /** The number of evaluation passes each predicate thread has finished. */
+    std::unique_ptr<std::atomic<uint64_t>[]> detect_passes;
 
 public:
     Predicates<DerivedSST> predicates;
@@ -180,7 +392,7 @@ public:
 
 private:
     /** Pointer to memory where the SST rows are stored. */
-    volatile char* rows;
+    volatile char* rows = nullptr;
     // char* snapshot;
     /** Length of each row in this SST, in bytes. */
     int rowLen;
@@ -210,6 +422,9 @@ private:
 
     /** RDMA resources vector, one for each member. */
     std::vector<std::unique_ptr<resources>> res_vec;
+    /** Whether the resources of each member register the whole table, rather
+     * than the two rows it shares with this node. */
+    std::vector<bool> table_registered;
 
     /** Indicates whether the predicate evaluation thread should start after being
      * forked in the constructor. */
@@ -219,10 +434,37 @@ private:
     /** Notified when the predicate evaluation thread should start. */
     std::condition_variable thread_start_cv;
 
+    /** Children per node in the relay tree; 0 if puts are never relayed. */
+    const uint32_t relay_fanout;
+    /** The port of the TCP connections to the members. */
+    const uint32_t tcp_port;
+    /** The transport context of the local node. */
+    const std::shared_ptr<TransportContext> context;
+    /** The first and last fields of the relay region, if one was set. */
+    _SSTField* relay_first = nullptr;
+    _SSTField* relay_last = nullptr;
+    /** The relay region, as offsets within a row. */
+    int relay_begin = 0;
+    int relay_end = 0;
+    /** Where a row's two relay slots start, and the length of each; each holds
+     * a version, a snapshot of the relay region, and the version again. */
+    int relay_slots_offset = 0;
+    int relay_slot_len = 0;
+    /** Serializes publish_relay_region. */
+    std::mutex relay_mutex;
+    uint64_t relay_published = 0;
+    /** The version of the last relay snapshot applied from each row. */
+    std::vector<uint64_t> relay_applied;
+    /** The value of num_frozen when the relay trees were last used. */
+    int relay_frozen_seen = 0;
+    std::vector<char> relay_scratch;
+
 public:
     SST(DerivedSST* derived_class_pointer, const SSTParams& params)
             : derived_this(derived_class_pointer),
               thread_shutdown(false),
+              detect_passes(new std::atomic<uint64_t>[std::max(1u, params.num_detect_threads)]),
+              predicates(params.num_detect_threads),
               members(params.members),
               num_members(members.size()),
               all_indices(num_members),
@@ -230,7 +472,11 @@ public:
               row_is_frozen(num_members),
               failure_upcall(params.failure_upcall),
               res_vec(num_members),
-              thread_start(params.start_predicate_thread) {
+              table_registered(num_members, false),
+              thread_start(params.start_predicate_thread),
+              relay_fanout(params.relay_fanout),
+              tcp_port(params.tcp_port),
+              context(params.context) {
         //Figure out my SST index
         for(uint32_t i = 0; i < num_members; ++i) {
             if(members[i] == my_node_id) {
@@ -256,31 +502,68 @@ public:
         }
     }
 
+    /**
+     * Sets the relay region: the fields from first to last, in the order they
+     * are passed to SSTInit. If the SST was constructed with a nonzero
+     * relay_fanout, a put of any part of this region to every row (put() or
+     * put(offset, size)) publishes a versioned snapshot of the whole region
+     * that is written only to this node's children in a k-ary tree rooted at
+     * this node; every node applies the newest complete snapshot of each row
+     * to its copy and forwards it to its own children. Each node thus writes
+     * to at most relay_fanout rows per update, and an update reaches every
+     * member in a logarithmic number of hops. Fields in the region must only
+     * be written with puts to every row. Must be called before SSTInit.
+     */
+    void set_relay_fields(_SSTField& first, _SSTField& last) {
+        relay_first = &first;
+        relay_last = &last;
+    }
+
+    /** @return true if puts of the relay region go through the relay tree. */
+    bool is_relaying() const { return relay_slot_len > 0; }
+
     template <typename... Fields>
     void SSTInit(Fields&... fields) {
         //Initialize rows and set the "base" field of each SSTField
         init_SSTFields(fields...);
 
-        //Initialize res_vec with the correct offsets for each row
+        //Initialize res_vec with the correct offsets for each row, then
+        //connect all of their queue pairs together
         unsigned int node_rank, sst_index;
+        std::vector<resources*> peers;
         for(auto const& rank_index : members_by_id) {
             std::tie(node_rank, sst_index) = rank_index;
-            char *write_addr, *read_addr;
-            write_addr = const_cast<char*>(rows) + rowLen * sst_index;
-            read_addr = const_cast<char*>(rows) + rowLen * my_index;
             if(sst_index != my_index) {
                 if(row_is_frozen[sst_index]) {
                     continue;
                 }
+                // A relay node writes other rows than its own, so the whole
+                // table is registered between it and the nodes it relays to
+                char *write_addr, *read_addr;
+                int size;
+                if(is_relaying() && relays_between(my_index, sst_index)) {
+                    table_registered[sst_index] = true;
+                    write_addr = const_cast<char*>(rows);
+                    read_addr = const_cast<char*>(rows);
+                    size = rowLen * num_members;
+                } else {
+                    write_addr = const_cast<char*>(rows) + rowLen * sst_index;
+                    read_addr = const_cast<char*>(rows) + rowLen * my_index;
+                    size = rowLen;
+                }
                 res_vec[sst_index] = std::make_unique<resources>(
-                        node_rank, write_addr, read_addr, rowLen, rowLen);
+                        context, node_rank, write_addr, read_addr, size, size, false, tcp_port);
+                peers.push_back(res_vec[sst_index].get());
                 // update qp_num_to_index
                 qp_num_to_index[res_vec[sst_index].get()->qp->qp_num] = sst_index;
             }
         }
+        connect_all(peers);
 
-        std::thread detector(&SST::detect, this);
-        background_threads.push_back(std::move(detector));
+        for(uint32_t worker = 0; worker < predicates.num_workers(); ++worker) {
+            detect_passes[worker] = 0;
+            background_threads.emplace_back(&SST::detect, this, worker);
+        }
 
         std::cout << "Initialized SST and Started Threads" << std::endl;
     }
@@ -290,6 +573,14 @@ public:
     /** Starts the predicate evaluation loop. */
     void start_predicate_evaluation();
 
+    /**
+     * Waits until every predicate thread other than the calling one has
+     * finished the trigger it was running, if any. After removing predicates,
+     * this guarantees that none of their triggers are still running on
+     * another thread.
+     */
+    void wait_for_predicate_threads();
+
     /** Does a TCP sync with each member of the SST. */
     void sync_with_members() const;
 
@@ -343,24 +634,60 @@ public:
     void put_with_completion(const std::vector<uint32_t> receiver_ranks, long long int offset, long long int size);
 
 private:
-    using char_p = volatile char*;
-
-    void compute_rowLen(int&) {}
+    void compute_rowLen(int&, bool&) {}
 
     template <typename Field, typename... Fields>
-    void compute_rowLen(int& rowLen, Field& f, Fields&... rest) {
-        rowLen += padded_len(f.field_len);
-        compute_rowLen(rowLen, rest...);
+    void compute_rowLen(int& rowLen, bool& cache_line_placement, Field& f, Fields&... rest) {
+        f.row_offset = f.start_offset(rowLen);
+        rowLen = f.end_offset(f.row_offset);
+        cache_line_placement = cache_line_placement || f.placement != Placement::PACKED;
+        compute_rowLen(rowLen, cache_line_placement, rest...);
     }
 
-    void set_bases_and_rowLens(char_p&, const int) {}
+    void set_rowLens(const int) {}
 
     template <typename Field, typename... Fields>
-    void set_bases_and_rowLens(char_p& base, const int rlen, Field& f, Fields&... rest) {
-        base += f.set_base(base);
+    void set_rowLens(const int rlen, Field& f, Fields&... rest) {
         f.set_rowLen(rlen);
-        set_bases_and_rowLens(base, rlen, rest...);
+        set_rowLens(rlen, rest...);
+    }
+
+    void set_bases() {}
+
+    template <typename Field, typename... Fields>
+    void set_bases(Field& f, Fields&... rest) {
+        f.set_base(rows + f.row_offset);
+        set_bases(rest...);
+    }
+
+    /** @return true if a put of this range to these rows goes through the relay tree. */
+    bool is_relayed(const std::vector<uint32_t>& receiver_ranks, long long int offset, long long int size) const {
+        return relay_slot_len && receiver_ranks.size() == num_members
+               && offset < relay_end && offset + size > relay_begin;
+    }
+    /** @return the parts of a relayed put that are still written directly to every row. */
+    std::vector<std::pair<long long int, long long int>> direct_ranges(long long int offset, long long int size) const;
+    /** @return the offset, from the start of the table, of one of a row's relay slots. */
+    long long int relay_slot_offset(uint32_t row, uint64_t version) const {
+        return (long long int)row * rowLen + relay_slots_offset + (version % 2) * relay_slot_len;
+    }
+    /** @return true if either node forwards other rows' relay slots to the
+     * other, in some relay tree, now or after failures. */
+    bool relays_between(uint32_t first_index, uint32_t second_index) const;
+    /** @return the offset of a range of the table in the buffers registered with a member. */
+    long long int remote_offset(uint32_t index, long long int table_offset) const {
+        return table_registered[index] ? table_offset : table_offset - (long long int)my_index * rowLen;
     }
+    /** Appends the children of the row at node_index in the relay tree rooted at writer_index. */
+    void append_relay_children(uint32_t writer_index, uint32_t node_index, std::vector<uint32_t>& children) const;
+    /** Copies the relay region of the local row into its next relay slot.
+     * @return the version of the snapshot */
+    uint64_t snapshot_relay_region();
+    /** Takes a snapshot of the relay region and writes it to this node's children. */
+    void publish_relay_region();
+    /** Applies and forwards new relay region snapshots from other rows; run by the predicate thread.
+     * @return true if any row's relay region changed */
+    bool relay_step();
 
     // void take_snapshot() {
     //   memcpy(snapshot, const_cast<char*>(rows), rowLen * num_members);
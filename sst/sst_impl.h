@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
 #include <memory>
@@ -16,6 +17,7 @@
 #include <time.h>
 #include <vector>
 
+#include "derecho/placement.h"
 #include "poll_utils.h"
 #include "predicates.h"
 #include "sst.h"
@@ -34,7 +36,7 @@ SST<DerivedSST>::~SST() {
     }
 
     if(rows != nullptr) {
-        delete[](const_cast<char*>(rows));
+        derecho::free_registered_memory(const_cast<char*>(rows));
     }
 }
 
@@ -58,23 +60,26 @@ void SST<DerivedSST>::start_predicate_evaluation() {
  * row's observed values of those functions.
  */
 template <typename DerivedSST>
-void SST<DerivedSST>::detect() {
-    pthread_setname_np(pthread_self(), "sst_detect");
+void SST<DerivedSST>::detect(uint32_t worker) {
+    const std::string thread_name = worker ? "sst_detect_" + std::to_string(worker) : "sst_detect";
+    pthread_setname_np(pthread_self(), thread_name.c_str());
+    derecho::pin_thread(derecho::ThreadRole::SST_DETECT);
     if(!thread_start) {
         std::unique_lock<std::mutex> lock(thread_start_mutex);
         thread_start_cv.wait(lock, [this]() { return thread_start; });
     }
     struct timespec last_time, cur_time;
     clock_gettime(CLOCK_REALTIME, &last_time);
+    auto& lists = *predicates.workers[worker];
 
     while(!thread_shutdown) {
         try {
-            bool predicate_fired = false;
+            bool predicate_fired = worker == 0 && relay_slot_len && relay_step();
             // Take the predicate lock before reading the predicate lists
-            std::unique_lock<std::mutex> predicates_lock(predicates.predicate_mutex);
+            std::unique_lock<std::mutex> predicates_lock(lists.predicate_mutex);
 
             // one time predicates need to be evaluated only until they become true
-            for(auto& pred : predicates.one_time_predicates) {
+            for(auto& pred : lists.one_time_predicates) {
                 if(pred != nullptr && (pred->first(*derived_this) == true)) {
                     predicate_fired = true;
                     // Copy the trigger pointer locally, so it can continue running without
@@ -89,7 +94,7 @@ void SST<DerivedSST>::detect() {
             }
 
             // recurrent predicates are evaluated each time they are found to be true
-            for(auto& pred : predicates.recurrent_predicates) {
+            for(auto& pred : lists.recurrent_predicates) {
                 if(pred != nullptr && (pred->first(*derived_this) == true)) {
                     predicate_fired = true;
                     std::shared_ptr<typename Predicates<DerivedSST>::trig> trigger(pred->second);
@@ -101,9 +106,9 @@ void SST<DerivedSST>::detect() {
 
             // transition predicates are only evaluated when they change from false to true
             // We need to use iterators here because we need to iterate over two lists in parallel
-            auto pred_it = predicates.transition_predicates.begin();
-            auto pred_state_it = predicates.transition_predicate_states.begin();
-            while(pred_it != predicates.transition_predicates.end()) {
+            auto pred_it = lists.transition_predicates.begin();
+            auto pred_state_it = lists.transition_predicate_states.begin();
+            while(pred_it != lists.transition_predicates.end()) {
                 if(*pred_it != nullptr) {
                     //*pred_state_it is the previous state of the predicate at *pred_it
                     bool curr_pred_state = (*pred_it)->first(*derived_this);
@@ -141,22 +146,191 @@ void SST<DerivedSST>::detect() {
         } catch(const std::exception& e) {
             std::cout << "Exception in the SST detect thread: " << e.what() << std::endl;
         }
+        detect_passes[worker]++;
+    }
+}
+
+template <typename DerivedSST>
+void SST<DerivedSST>::wait_for_predicate_threads() {
+    const uint32_t num_workers = predicates.num_workers();
+    if(num_workers == 1) {
+        return;
+    }
+    std::vector<uint64_t> passes(num_workers);
+    for(uint32_t worker = 0; worker < num_workers; ++worker) {
+        passes[worker] = detect_passes[worker];
+    }
+    const std::thread::id my_id = std::this_thread::get_id();
+    for(uint32_t worker = 0; worker < num_workers; ++worker) {
+        if(background_threads[worker].get_id() == my_id) {
+            continue;
+        }
+        // The pass under way now ends after any trigger it is running
+        while(detect_passes[worker] == passes[worker] && thread_start && !thread_shutdown) {
+            std::this_thread::yield();
+        }
     }
 }
 
 template <typename DerivedSST>
 void SST<DerivedSST>::put(const std::vector<uint32_t> receiver_ranks, long long int offset, long long int size) {
+    std::vector<std::pair<long long int, long long int>> ranges{{offset, size}};
+    if(is_relayed(receiver_ranks, offset, size)) {
+        publish_relay_region();
+        ranges = direct_ranges(offset, size);
+    }
+    const long long int row_offset = (long long int)my_index * rowLen;
     for(auto index : receiver_ranks) {
         // don't write to yourself or a frozen row
         if(index == my_index || row_is_frozen[index]) {
             continue;
         }
         // perform a remote RDMA write on the owner of the row
-        res_vec[index]->post_remote_write(0, offset, size);
+        for(const auto& range : ranges) {
+            res_vec[index]->post_remote_write(0, remote_offset(index, row_offset + range.first), range.second);
+        }
     }
     return;
 }
 
+template <typename DerivedSST>
+std::vector<std::pair<long long int, long long int>> SST<DerivedSST>::direct_ranges(long long int offset, long long int size) const {
+    std::vector<std::pair<long long int, long long int>> ranges;
+    const long long int end = std::min<long long int>(offset + size, relay_slots_offset);
+    if(offset < relay_begin) {
+        ranges.emplace_back(offset, std::min<long long int>(end, relay_begin) - offset);
+    }
+    if(end > relay_end) {
+        const long long int begin = std::max<long long int>(offset, relay_end);
+        ranges.emplace_back(begin, end - begin);
+    }
+    return ranges;
+}
+
+template <typename DerivedSST>
+bool SST<DerivedSST>::relays_between(uint32_t first_index, uint32_t second_index) const {
+    // A failed node's children are adopted by its parent, so a node can end up
+    // forwarding to any of its descendants in a tree; the writer at the root
+    // of a tree only ever writes its own row
+    for(uint32_t writer_index = 0; writer_index < num_members; ++writer_index) {
+        uint64_t first_position = (first_index + num_members - writer_index) % num_members;
+        uint64_t second_position = (second_index + num_members - writer_index) % num_members;
+        if(first_position > second_position) {
+            std::swap(first_position, second_position);
+        }
+        if(first_position == 0) {
+            continue;
+        }
+        while(second_position > first_position) {
+            second_position = (second_position - 1) / relay_fanout;
+        }
+        if(second_position == first_position) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename DerivedSST>
+void SST<DerivedSST>::append_relay_children(uint32_t writer_index, uint32_t node_index,
+                                            std::vector<uint32_t>& children) const {
+    // Positions in the tree count from the writer, around the ring of rows
+    const uint64_t position = (node_index + num_members - writer_index) % num_members;
+    for(uint64_t child_position = position * relay_fanout + 1;
+        child_position <= position * relay_fanout + relay_fanout && child_position < num_members;
+        ++child_position) {
+        const uint32_t child = (child_position + writer_index) % num_members;
+        // A failed node's children are adopted by its parent
+        if(row_is_frozen[child]) {
+            append_relay_children(writer_index, child, children);
+        } else {
+            children.push_back(child);
+        }
+    }
+}
+
+template <typename DerivedSST>
+uint64_t SST<DerivedSST>::snapshot_relay_region() {
+    std::lock_guard<std::mutex> lock(relay_mutex);
+    const uint64_t version = ++relay_published;
+    char* slot = const_cast<char*>(rows) + relay_slot_offset(my_index, version);
+    volatile uint64_t* begin_version = reinterpret_cast<volatile uint64_t*>(slot);
+    volatile uint64_t* end_version = reinterpret_cast<volatile uint64_t*>(slot + relay_slot_len - sizeof(uint64_t));
+    *begin_version = version;
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(slot + sizeof(uint64_t), const_cast<char*>(rows) + my_index * rowLen + relay_begin, relay_end - relay_begin);
+    std::atomic_thread_fence(std::memory_order_release);
+    *end_version = version;
+    return version;
+}
+
+template <typename DerivedSST>
+void SST<DerivedSST>::publish_relay_region() {
+    const uint64_t version = snapshot_relay_region();
+    std::vector<uint32_t> children;
+    append_relay_children(my_index, my_index, children);
+    for(auto child : children) {
+        res_vec[child]->post_remote_write(0, remote_offset(child, relay_slot_offset(my_index, version)), relay_slot_len);
+    }
+}
+
+template <typename DerivedSST>
+bool SST<DerivedSST>::relay_step() {
+    // After a failure the trees change shape, so every snapshot is forwarded
+    // again to whichever children a node has now
+    const bool trees_changed = num_frozen != relay_frozen_seen;
+    relay_frozen_seen = num_frozen;
+    if(trees_changed) {
+        std::lock_guard<std::mutex> lock(relay_mutex);
+        if(relay_published) {
+            std::vector<uint32_t> children;
+            append_relay_children(my_index, my_index, children);
+            for(auto child : children) {
+                res_vec[child]->post_remote_write(0, remote_offset(child, relay_slot_offset(my_index, relay_published)),
+                                                  relay_slot_len);
+            }
+        }
+    }
+
+    bool changed = false;
+    char* scratch = relay_scratch.data();
+    for(uint32_t row = 0; row < num_members; ++row) {
+        if(row == my_index || row_is_frozen[row]) {
+            continue;
+        }
+        // Take the newer of the two slots that holds a complete snapshot
+        uint64_t newest = relay_applied[row];
+        for(uint64_t parity = 0; parity < 2; ++parity) {
+            const char* slot = const_cast<char*>(rows) + relay_slot_offset(row, parity);
+            const uint64_t end_version = *reinterpret_cast<const volatile uint64_t*>(slot + relay_slot_len - sizeof(uint64_t));
+            if(end_version <= newest) {
+                continue;
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            memcpy(scratch, slot + sizeof(uint64_t), relay_end - relay_begin);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(*reinterpret_cast<const volatile uint64_t*>(slot) == end_version) {
+                newest = end_version;
+                memcpy(const_cast<char*>(rows) + row * rowLen + relay_begin, scratch, relay_end - relay_begin);
+            }
+        }
+        if(newest == relay_applied[row] && !trees_changed) {
+            continue;
+        }
+        changed = changed || newest != relay_applied[row];
+        relay_applied[row] = newest;
+        if(!newest) {
+            continue;
+        }
+        std::vector<uint32_t> children;
+        append_relay_children(row, my_index, children);
+        for(auto child : children) {
+            res_vec[child]->post_remote_write(0, remote_offset(child, relay_slot_offset(row, newest)), relay_slot_len);
+        }
+    }
+    return changed;
+}
+
 template <typename DerivedSST>
 void SST<DerivedSST>::put_with_completion(const std::vector<uint32_t> receiver_ranks, long long int offset, long long int size) {
     unsigned int num_writes_posted = 0;
@@ -168,13 +342,23 @@ void SST<DerivedSST>::put_with_completion(const std::vector<uint32_t> receiver_r
 
     util::polling_data.set_waiting(tid);
 
+    // A relayed range is written directly to every row as well, so that the
+    // completions confirm it has arrived. The snapshot goes first, so that an
+    // older one still on its way through the tree is not applied over it.
+    const bool relayed = is_relayed(receiver_ranks, offset, size);
+    const uint64_t version = relayed ? snapshot_relay_region() : 0;
+    const long long int row_offset = (long long int)my_index * rowLen;
     for(auto index : receiver_ranks) {
         // don't write to yourself or a frozen row
         if(index == my_index || row_is_frozen[index]) {
             continue;
         }
-        // perform a remote RDMA write on the owner of the row
-        res_vec[index]->post_remote_write_with_completion(id, offset, size);
+        // perform a remote RDMA write on the owner of the row; writes on a
+        // queue pair complete in order, so only the last one signals
+        if(relayed) {
+            res_vec[index]->post_remote_write(0, remote_offset(index, relay_slot_offset(my_index, version)), relay_slot_len);
+        }
+        res_vec[index]->post_remote_write_with_completion(id, remote_offset(index, row_offset + offset), size);
         posted_write_to[index] = true;
         num_writes_posted++;
     }
@@ -186,30 +370,15 @@ void SST<DerivedSST>::put_with_completion(const std::vector<uint32_t> receiver_r
 
     /** Completion Queue poll timeout in millisec */
     const int MAX_POLL_CQ_TIMEOUT = 2000;
-    unsigned long start_time_msec;
-    unsigned long cur_time_msec;
-    struct timeval cur_time;
 
     // wait for completion for a while before giving up of doing it ..
-    gettimeofday(&cur_time, NULL);
-    start_time_msec = (cur_time.tv_sec * 1000) + (cur_time.tv_usec / 1000);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(MAX_POLL_CQ_TIMEOUT);
 
     // poll for surviving number of rows
     for(unsigned int index = 0; index < num_writes_posted; ++index) {
-        std::experimental::optional<std::pair<int32_t, int32_t>> ce;
-
-        while(true) {
-            // check if polling result is available
-            ce = util::polling_data.get_completion_entry(tid);
-            if(ce) {
-                break;
-            }
-            gettimeofday(&cur_time, NULL);
-            cur_time_msec = (cur_time.tv_sec * 1000) + (cur_time.tv_usec / 1000);
-            if((cur_time_msec - start_time_msec) >= MAX_POLL_CQ_TIMEOUT) {
-                break;
-            }
-        }
+        // spins briefly, then sleeps until the polling thread delivers the entry
+        std::experimental::optional<std::pair<int32_t, int32_t>> ce
+                = util::polling_data.wait_for_completion_entry(id, deadline);
         // if waiting for a completion entry timed out
         if(!ce) {
             // find some node that hasn't been polled yet and report it
@@ -281,7 +450,7 @@ void SST<DerivedSST>::sync_with_members() const {
     for(auto const& id_index : members_by_id) {
         std::tie(node_id, sst_index) = id_index;
         if(sst_index != my_index && !row_is_frozen[sst_index]) {
-            sync(node_id);
+            context->sync(node_id, tcp_port);
         }
     }
 }
@@ -296,7 +465,7 @@ void SST<DerivedSST>::sync_with_members(std::vector<uint32_t> row_indices) const
             continue;
         }
         if(!row_is_frozen[row_index]) {
-            sync(members[row_index]);
+            context->sync(members[row_index], tcp_port);
         }
     }
 }
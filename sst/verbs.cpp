@@ -3,7 +3,10 @@
  * Contains the implementation of the IB Verbs adapter layer of %SST.
  */
 #include <arpa/inet.h>
+#include <atomic>
 #include <byteswap.h>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
 #include <endian.h>
 #include <errno.h>
@@ -11,7 +14,10 @@
 #include <infiniband/verbs.h>
 #include <inttypes.h>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <netdb.h>
+#include <poll.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -24,6 +30,7 @@
 
 #include "derecho/connection_manager.h"
 #include "derecho/derecho_ports.h"
+#include "derecho/placement.h"
 #include "poll_utils.h"
 #include "tcp/tcp.h"
 #include "verbs.h"
@@ -54,11 +61,9 @@ int ib_port = 1;
 /** GID index to use. */
 int gid_idx = 0;
 
-tcp::tcp_connections *sst_connections;
-
 //  unsigned int max_time_to_completion = 0;
 
-/** Structure containing global system resources. */
+/** Structure containing the RDMA resources of a TransportContext. */
 struct global_resources {
     /** RDMA device attributes. */
     struct ibv_device_attr device_attr;
@@ -70,17 +75,29 @@ struct global_resources {
     struct ibv_pd *pd;
     /** Completion Queue handle. */
     struct ibv_cq *cq;
+    /** Completion channel the polling thread sleeps on when spinning is not worthwhile. */
+    struct ibv_comp_channel *cc;
 };
-/** The single instance of global_resources for the %SST system */
-struct global_resources *g_res;
 
-std::thread polling_thread;
-static bool shutdown = false;
+/** Guards contexts and default_context. */
+static std::mutex contexts_mutex;
+/** The context of each node in this process, keyed by node id. */
+static std::map<uint32_t, std::shared_ptr<TransportContext>> contexts;
+/** The first context created, used by the functions that do not take one. */
+static std::shared_ptr<TransportContext> default_context;
+
+static uint64_t steady_time_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
 
 /**
  * Initializes the resources. Registers write_addr and read_addr as the read
  * and write buffers and connects a queue pair with the specified remote node.
  *
+ * @param context The context of the local node, which must have been
+ * initialized on tcp_port.
  * @param r_index The node rank of the remote node to connect to.
  * @param write_addr A pointer to the memory to use as the write buffer. This
  * is where data should be written locally in order to send it in an RDMA write
@@ -89,9 +106,13 @@ static bool shutdown = false;
  * where the results of RDMA reads from the remote node will arrive.
  * @param size_w The size of the write buffer (in bytes).
  * @param size_r The size of the read buffer (in bytes).
+ * @param connect Whether to connect the queue pair now; if false, it must be
+ * connected with connect_all.
  */
-resources::resources(int r_index, char *write_addr, char *read_addr, int size_w,
-                     int size_r) {
+resources::resources(std::shared_ptr<TransportContext> context, int r_index, char *write_addr,
+                     char *read_addr, int size_w, int size_r, bool connect, uint32_t tcp_port)
+        : context(std::move(context)),
+          tcp_port(tcp_port) {
     // set the remote index
     remote_index = r_index;
 
@@ -110,8 +131,8 @@ resources::resources(int r_index, char *write_addr, char *read_addr, int size_w,
     // allow access for only local writes and remote reads
     mr_flags = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
     // register memory with the protection domain and the buffer
-    write_mr = ibv_reg_mr(g_res->pd, write_buf, size_w, mr_flags);
-    read_mr = ibv_reg_mr(g_res->pd, read_buf, size_r, mr_flags);
+    write_mr = ibv_reg_mr(context->g_res->pd, write_buf, size_w, mr_flags);
+    read_mr = ibv_reg_mr(context->g_res->pd, read_buf, size_r, mr_flags);
     if(!write_mr) {
         cout << "Could not register memory region : write_mr, error code is: " << errno << endl;
     }
@@ -125,25 +146,32 @@ resources::resources(int r_index, char *write_addr, char *read_addr, int size_w,
     qp_init_attr.qp_type = IBV_QPT_RC;
     qp_init_attr.sq_sig_all = 0;
     // same completion queue for both send and receive operations
-    qp_init_attr.send_cq = g_res->cq;
-    qp_init_attr.recv_cq = g_res->cq;
+    qp_init_attr.send_cq = context->g_res->cq;
+    qp_init_attr.recv_cq = context->g_res->cq;
     // allow a lot of requests at a time
     qp_init_attr.cap.max_send_wr = 4000;
     qp_init_attr.cap.max_recv_wr = 4000;
     qp_init_attr.cap.max_send_sge = 1;
     qp_init_attr.cap.max_recv_sge = 1;
     // create the queue pair
-    qp = ibv_create_qp(g_res->pd, &qp_init_attr);
+    qp = ibv_create_qp(context->g_res->pd, &qp_init_attr);
 
     if(!qp) {
         cout << "Could not create queue pair, error code is: " << errno << endl;
     }
 
     // connect the QPs
-    connect_qp();
-    cout << "Established RDMA connection with node " << r_index << endl;
+    if(connect) {
+        connect_qp();
+        cout << "Established RDMA connection with node " << r_index << endl;
+    }
 }
 
+resources::resources(int r_index, char *write_addr, char *read_addr, int size_w,
+                     int size_r, bool connect, uint32_t tcp_port)
+        : resources(TransportContext::get_default(), r_index, write_addr, read_addr,
+                    size_w, size_r, connect, tcp_port) {}
+
 /**
  * Cleans up all IB Verbs resources associated with this connection.
  */
@@ -250,16 +278,33 @@ void resources::set_qp_ready_to_send() {
  * `modify_qp_*` methods in the process.
  */
 void resources::connect_qp() {
-    // local connection data
-    struct cm_con_data_t local_con_data;
-    // remote connection data. Obtained via TCP
-    struct cm_con_data_t remote_con_data;
     // this is used to ensure that host byte order is correct at each node
     struct cm_con_data_t tmp_con_data;
 
+    // exchange using TCP sockets info required to connect QPs
+    tcp::tcp_connections *connections = context->connections_on(tcp_port);
+    bool success = connections && connections->exchange(remote_index, local_connection_data(), tmp_con_data);
+    if(!success) {
+        cout << "Could not exchange qp data in connect_qp" << endl;
+    }
+    finish_connect_qp(tmp_con_data);
+
+    // sync to make sure that both sides are in states that they can connect to
+    // prevent packet loss
+    // just send a dummy char back and forth
+    success = context->sync(remote_index, tcp_port);
+    if(!success) {
+        cout << "Could not sync in connect_qp after qp transition to RTS state" << endl;
+    }
+}
+
+cm_con_data_t resources::local_connection_data() {
+    // local connection data
+    struct cm_con_data_t local_con_data;
+
     union ibv_gid my_gid;
     if(gid_idx >= 0) {
-        int rc = ibv_query_gid(g_res->ib_ctx, ib_port, gid_idx, &my_gid);
+        int rc = ibv_query_gid(context->g_res->ib_ctx, ib_port, gid_idx, &my_gid);
         if(rc) {
             cout << "ibv_query_gid failed, error code is " << errno << endl;
         }
@@ -271,12 +316,14 @@ void resources::connect_qp() {
     local_con_data.addr = htonll((uintptr_t)(char *)write_buf);
     local_con_data.rkey = htonl(write_mr->rkey);
     local_con_data.qp_num = htonl(qp->qp_num);
-    local_con_data.lid = htons(g_res->port_attr.lid);
+    local_con_data.lid = htons(context->g_res->port_attr.lid);
     memcpy(local_con_data.gid, &my_gid, 16);
-    bool success = sst_connections->exchange(remote_index, local_con_data, tmp_con_data);
-    if(!success) {
-        cout << "Could not exchange qp data in connect_qp" << endl;
-    }
+    return local_con_data;
+}
+
+void resources::finish_connect_qp(const cm_con_data_t &tmp_con_data) {
+    // remote connection data. Obtained via TCP
+    struct cm_con_data_t remote_con_data;
     remote_con_data.addr = ntohll(tmp_con_data.addr);
     remote_con_data.rkey = ntohl(tmp_con_data.rkey);
     remote_con_data.qp_num = ntohl(tmp_con_data.qp_num);
@@ -293,13 +340,43 @@ void resources::connect_qp() {
 
     // modify it to RTS
     set_qp_ready_to_send();
+}
 
-    // sync to make sure that both sides are in states that they can connect to
-    // prevent packet loss
-    // just send a dummy char back and forth
-    success = sync(remote_index);
-    if(!success) {
-        cout << "Could not sync in connect_qp after qp transition to RTS state" << endl;
+void connect_all(const std::vector<resources *> &peers) {
+    if(peers.empty()) {
+        return;
+    }
+    tcp::tcp_connections *sst_connections = peers.front()->context->connections_on(peers.front()->tcp_port);
+    if(!sst_connections) {
+        cout << "No connections were set up on port " << peers.front()->tcp_port << endl;
+        return;
+    }
+    for(resources *peer : peers) {
+        const cm_con_data_t local_con_data = peer->local_connection_data();
+        if(!sst_connections->write(peer->remote_index, (const char *)&local_con_data, sizeof(local_con_data))) {
+            cout << "Could not send qp data to node " << peer->remote_index << endl;
+        }
+    }
+    for(resources *peer : peers) {
+        cm_con_data_t tmp_con_data;
+        if(!sst_connections->read(peer->remote_index, (char *)&tmp_con_data, sizeof(tmp_con_data))) {
+            cout << "Could not receive qp data from node " << peer->remote_index << endl;
+        }
+        peer->finish_connect_qp(tmp_con_data);
+    }
+    // the same dummy exchange as sync, so that no peer writes before the other side's QP is ready
+    const int s = 0;
+    for(resources *peer : peers) {
+        if(!sst_connections->write(peer->remote_index, (const char *)&s, sizeof(s))) {
+            cout << "Could not sync with node " << peer->remote_index << " after qp transition to RTS state" << endl;
+        }
+    }
+    for(resources *peer : peers) {
+        int t;
+        if(!sst_connections->read(peer->remote_index, (char *)&t, sizeof(t))) {
+            cout << "Could not sync with node " << peer->remote_index << " after qp transition to RTS state" << endl;
+        }
+        cout << "Established RDMA connection with node " << peer->remote_index << endl;
     }
 }
   
@@ -404,14 +481,22 @@ void resources::post_remote_write_with_completion(const uint32_t id, const long
     }
 }
 
-void polling_loop() {
+void TransportContext::polling_loop() {
     pthread_setname_np(pthread_self(), "sst_poll");
+    derecho::pin_thread(derecho::ThreadRole::SST_POLL);
     cout << "Polling thread starting" << endl;
+    poll_start_ns = steady_time_ns();
+    std::vector<std::pair<uint32_t, std::pair<int, int>>> completions;
+    completions.reserve(poll_batch_size);
     while(!shutdown) {
-        auto ce = verbs_poll_completion();
-        util::polling_data.insert_completion_entry(ce.first, ce.second);
+        poll_completions(completions);
+        for(const auto& ce : completions) {
+            util::polling_data.insert_completion_entry(ce.first, ce.second);
+        }
     }
-    cout << "Polling thread ending" << endl;
+    PollerStats stats = get_poller_stats();
+    cout << "Polling thread ending; idle " << (stats.elapsed_ns ? 100.0 * stats.idle_ns / stats.elapsed_ns : 0)
+         << "% of the time, average wakeup latency " << stats.avg_wakeup_latency_ns << " ns" << endl;
 }
 
 /**
@@ -423,7 +508,7 @@ void polling_loop() {
  * @return pair(qp_num,result) The queue pair number associated with the
  * completed request and the result (1 for successful, -1 for unsuccessful)
  */
-std::pair<uint32_t, std::pair<int, int>> verbs_poll_completion() {
+std::pair<uint32_t, std::pair<int, int>> TransportContext::poll_completion() {
     struct ibv_wc wc;
     int poll_result;
 
@@ -456,15 +541,105 @@ std::pair<uint32_t, std::pair<int, int>> verbs_poll_completion() {
     return {wc.wr_id, {wc.qp_num, 1}};
 }
 
-/** Allocates memory for global RDMA resources. */
-void resources_init() {
-    // initialize the global resources
+/**
+ * @details
+ * This blocks until at least one entry in the completion queue has
+ * completed, then takes up to poll_batch_size entries at once.
+ * It is exclusively used by the polling thread
+ * the thread sleeps in util::polling_data.wait_for_requests while no thread
+ * is waiting for a completion, and on the completion channel once it has
+ * spun for poll_spin_budget_ns without finding one
+ * @param completions Replaced with pair(wr_id, pair(qp_num, result)) for each
+ * completed request: the queue pair number associated with the completed
+ * request and the result (1 for successful, -1 for unsuccessful)
+ */
+void TransportContext::poll_completions(std::vector<std::pair<uint32_t, std::pair<int, int>>>& completions) {
+    struct ibv_wc wcs[poll_batch_size];
+    int poll_result;
+
+    completions.clear();
+    uint64_t spin_start = steady_time_ns();
+    poll_result = 0;
+    while(!shutdown) {
+        poll_result = ibv_poll_cq(g_res->cq, poll_batch_size, wcs);
+        if(poll_result) {
+            break;
+        }
+        if(!util::polling_data.has_waiting()) {
+            // Only writes with completion produce entries, and their threads
+            // wait for them, so sleep until some thread does. Wake up now
+            // and then anyway to drain error completions and see shutdown.
+            const uint64_t sleep_start = steady_time_ns();
+            const bool requested = util::polling_data.wait_for_requests(std::chrono::milliseconds(50));
+            const uint64_t wake_time = steady_time_ns();
+            poll_idle_ns += wake_time - sleep_start;
+            poll_request_sleeps++;
+            const uint64_t waiting_since = util::polling_data.get_waiting_since();
+            if(requested && waiting_since > sleep_start) {
+                poll_wakeup_latency_ns += wake_time - waiting_since;
+                poll_wakeups++;
+            }
+            spin_start = steady_time_ns();
+            continue;
+        }
+        if(steady_time_ns() - spin_start < poll_spin_budget_ns) {
+            continue;
+        }
+        // Arm the channel, then poll once more so an entry that arrived
+        // before arming isn't slept through
+        if(ibv_req_notify_cq(g_res->cq, 0)) {
+            cout << "Could not request completion notification" << endl;
+        }
+        poll_result = ibv_poll_cq(g_res->cq, poll_batch_size, wcs);
+        if(poll_result) {
+            break;
+        }
+        pollfd file_descriptor;
+        file_descriptor.fd = g_res->cc->fd;
+        file_descriptor.events = POLLIN;
+        file_descriptor.revents = 0;
+        const uint64_t sleep_start = steady_time_ns();
+        int rc = poll(&file_descriptor, 1, 50);
+        poll_idle_ns += steady_time_ns() - sleep_start;
+        poll_channel_sleeps++;
+        if(rc > 0) {
+            ibv_cq *ev_cq;
+            void *ev_ctx;
+            ibv_get_cq_event(g_res->cc, &ev_cq, &ev_ctx);
+            ibv_ack_cq_events(ev_cq, 1);
+        }
+        spin_start = steady_time_ns();
+    }
+    // not sure what to do when we cannot read entries off the CQ
+    // this means that something is wrong with the local node
+    if(poll_result < 0) {
+        cout << "Poll completion failed" << endl;
+        exit(-1);
+    }
+    for(int i = 0; i < poll_result; ++i) {
+        const struct ibv_wc& wc = wcs[i];
+        // check the completion status (here we don't care about the completion
+        // opcode)
+        if(wc.status != IBV_WC_SUCCESS) {
+            cout << "got bad completion with status: "
+                 << wc.status << ", vendor syndrome: " << wc.vendor_err;
+            completions.emplace_back(wc.wr_id, std::make_pair(static_cast<int>(wc.qp_num), -1));
+        } else {
+            completions.emplace_back(wc.wr_id, std::make_pair(static_cast<int>(wc.qp_num), 1));
+        }
+    }
+}
+
+void TransportContext::create_resources() {
+    // The previous polling thread, which was shut down by destroy or
+    // shutdown_polling_thread, must stop using g_res before it is replaced
+    if(polling_thread.joinable()) {
+        polling_thread.join();
+    }
+    // init all of the resources, so cleanup will be easy
     g_res = (global_resources *)malloc(sizeof(global_resources));
     memset(g_res, 0, sizeof *g_res);
-}
 
-/** Creates global RDMA resources. */
-void resources_create() {
     struct ibv_device **dev_list = NULL;
     struct ibv_device *ib_dev = NULL;
     int i;
@@ -526,54 +701,171 @@ void resources_create() {
 
     // set to many entries
     int cq_size = 1000;
-    g_res->cq = ibv_create_cq(g_res->ib_ctx, cq_size, NULL, NULL, 0);
+    g_res->cc = ibv_create_comp_channel(g_res->ib_ctx);
+    if(!g_res->cc) {
+        cout << "Could not create completion channel, error code is " << errno << endl;
+    }
+    g_res->cq = ibv_create_cq(g_res->ib_ctx, cq_size, NULL, g_res->cc, 0);
     if(!g_res->cq) {
         cout << "Could not create completion queue, error code is " << errno << endl;
     }
 
     // start the polling thread
-    polling_thread = std::thread(polling_loop);
-    polling_thread.detach();
+    shutdown = false;
+    polling_thread = std::thread(&TransportContext::polling_loop, this);
+}
+
+TransportContext::TransportContext(uint32_t node_rank) : node_rank(node_rank) {}
+
+TransportContext::~TransportContext() {
+    shutdown = true;
+    if(polling_thread.joinable()) {
+        polling_thread.join();
+    }
+}
+
+std::shared_ptr<TransportContext> TransportContext::get(uint32_t node_rank) {
+    std::lock_guard<std::mutex> lock(contexts_mutex);
+    std::shared_ptr<TransportContext>& context = contexts[node_rank];
+    if(!context) {
+        context = std::make_shared<TransportContext>(node_rank);
+        if(!default_context) {
+            default_context = context;
+        }
+    }
+    return context;
+}
+
+std::shared_ptr<TransportContext> TransportContext::find(uint32_t node_rank) {
+    std::lock_guard<std::mutex> lock(contexts_mutex);
+    auto it = contexts.find(node_rank);
+    return it != contexts.end() ? it->second : nullptr;
+}
+
+std::shared_ptr<TransportContext> TransportContext::get_default() {
+    std::lock_guard<std::mutex> lock(contexts_mutex);
+    return default_context;
+}
+
+tcp::tcp_connections *TransportContext::connections_on(uint32_t tcp_port) {
+    std::unique_lock<std::mutex> lock(resources_mutex);
+    connections_made.wait(lock, [this, tcp_port]() {
+        auto it = connections.find(tcp_port);
+        return it == connections.end() || !it->second.connecting;
+    });
+    auto it = connections.find(tcp_port);
+    return it != connections.end() ? it->second.connections.get() : nullptr;
 }
 
-bool add_node(uint32_t new_id, const std::string new_ip_addr) {
-    return sst_connections->add_node(new_id, new_ip_addr);
+bool TransportContext::add_node(uint32_t new_id, const std::string &new_ip_addr, uint32_t tcp_port) {
+    tcp::tcp_connections *port_connections = connections_on(tcp_port);
+    return port_connections && port_connections->add_node(new_id, new_ip_addr);
 }
 
 /**
 *@param r_index The node rank of the node to exchange data with.
+*@param tcp_port The port of the connection to that node.
 */
-bool sync(uint32_t r_index) {
+bool TransportContext::sync(uint32_t r_index, uint32_t tcp_port) {
     int s = 0, t = 0;
-    return sst_connections->exchange(r_index, s, t);
+    tcp::tcp_connections *port_connections = connections_on(tcp_port);
+    return port_connections && port_connections->exchange(r_index, s, t);
 }
 
 /**
  * @details
- * This must be called before creating or using any SST instance.
+ * This must be called before creating or using any SST instance of this
+ * node.
  */
-void verbs_initialize(const std::map<uint32_t, std::string> &ip_addrs, uint32_t node_rank) {
-    sst_connections = new tcp::tcp_connections(node_rank, ip_addrs, derecho::sst_tcp_port);
+bool TransportContext::initialize(const std::map<uint32_t, std::string> &ip_addrs, uint32_t tcp_port) {
+    std::unique_lock<std::mutex> lock(resources_mutex);
+    if(shutdown && num_users > 0) {
+        cout << "The polling thread of node " << node_rank << " was shut down while it is in use" << endl;
+        return false;
+    }
+    if(num_users++ == 0) {
+        create_resources();
+        cout << "Initialized RDMA resources of node " << node_rank << endl;
+    }
+
+    // The first call on a port leaves a placeholder while it connects, so
+    // later calls on that port wait for its connections instead of making
+    // their own
+    auto inserted = connections.emplace(tcp_port, port_connections{});
+    if(!inserted.second) {
+        connections_made.wait(lock, [this, tcp_port]() {
+            auto it = connections.find(tcp_port);
+            return it == connections.end() || !it->second.connecting;
+        });
+        auto it = connections.find(tcp_port);
+        if(it == connections.end()) {
+            num_users--;
+            return false;
+        }
+        tcp::tcp_connections *existing_connections = it->second.connections.get();
+        lock.unlock();
+        for(const auto &id_ip : ip_addrs) {
+            if(id_ip.first != node_rank) {
+                existing_connections->add_node(id_ip.first, id_ip.second);
+            }
+        }
+        return true;
+    }
+
+    lock.unlock();
+    std::unique_ptr<tcp::tcp_connections> new_connections;
+    try {
+        new_connections = std::make_unique<tcp::tcp_connections>(node_rank, ip_addrs, tcp_port);
+    } catch(...) {
+        lock.lock();
+        connections.erase(tcp_port);
+        num_users--;
+        connections_made.notify_all();
+        throw;
+    }
+    lock.lock();
+    port_connections &entry = connections.at(tcp_port);
+    entry.connections = std::move(new_connections);
+    entry.connecting = false;
+    connections_made.notify_all();
+    return true;
+}
 
-    // init all of the resources, so cleanup will be easy
-    resources_init();
-    // create resources before using them
-    resources_create();
+void TransportContext::shutdown_polling_thread() {
+    shutdown = true;
+}
 
-    cout << "Initialized global RDMA resources" << endl;
+PollerStats TransportContext::get_poller_stats() const {
+    PollerStats stats;
+    stats.elapsed_ns = poll_start_ns ? steady_time_ns() - poll_start_ns : 0;
+    stats.idle_ns = poll_idle_ns;
+    stats.request_sleeps = poll_request_sleeps;
+    stats.channel_sleeps = poll_channel_sleeps;
+    stats.avg_wakeup_latency_ns = poll_wakeups ? poll_wakeup_latency_ns / poll_wakeups : 0;
+    return stats;
 }
 
-void shutdown_polling_thread() {
-    shutdown = true;
+void TransportContext::set_poll_spin_budget(uint64_t budget_ns) {
+    poll_spin_budget_ns = budget_ns;
 }
 
 /**
  * @details
- * This cleans up all the global resources used by the SST system, so it should
- * only be called once all SST instances have been destroyed.
+ * The last call, once every initialize call has been matched, stops the
+ * polling thread, so it should only be made once all SST instances of this
+ * node have been destroyed. A later initialize starts over with new
+ * resources and a new polling thread.
  */
-void verbs_destroy() {
+void TransportContext::destroy() {
+    std::lock_guard<std::mutex> lock(resources_mutex);
+    if(num_users == 0 || --num_users > 0) {
+        return;
+    }
+    // The polling thread sees this within one of its 50 ms sleeps
     shutdown = true;
+    if(polling_thread.joinable()) {
+        polling_thread.join();
+    }
     // int rc;
     // if(g_res->cq) {
     //     rc = ibv_destroy_cq(g_res->cq);
@@ -597,4 +889,67 @@ void verbs_destroy() {
     cout << "Shutting down" << endl;
 }
 
+bool add_node(uint32_t new_id, const std::string new_ip_addr, uint32_t tcp_port) {
+    std::shared_ptr<TransportContext> context = TransportContext::get_default();
+    return context && context->add_node(new_id, new_ip_addr, tcp_port);
+}
+
+bool sync(uint32_t r_index, uint32_t tcp_port) {
+    std::shared_ptr<TransportContext> context = TransportContext::get_default();
+    return context && context->sync(r_index, tcp_port);
+}
+
+bool verbs_initialize(const std::map<uint32_t, std::string> &ip_addrs, uint32_t node_rank,
+                      uint32_t tcp_port) {
+    return TransportContext::get(node_rank)->initialize(ip_addrs, tcp_port);
+}
+
+std::pair<uint32_t, std::pair<int, int>> verbs_poll_completion() {
+    return TransportContext::get_default()->poll_completion();
+}
+
+void verbs_poll_completions(std::vector<std::pair<uint32_t, std::pair<int, int>>> &completions) {
+    TransportContext::get_default()->poll_completions(completions);
+}
+
+void shutdown_polling_thread() {
+    if(std::shared_ptr<TransportContext> context = TransportContext::get_default()) {
+        context->shutdown_polling_thread();
+    }
+}
+
+void shutdown_polling_thread(uint32_t node_rank) {
+    if(std::shared_ptr<TransportContext> context = TransportContext::find(node_rank)) {
+        context->shutdown_polling_thread();
+    }
+}
+
+PollerStats get_poller_stats() {
+    std::shared_ptr<TransportContext> context = TransportContext::get_default();
+    return context ? context->get_poller_stats() : PollerStats{};
+}
+
+PollerStats get_poller_stats(uint32_t node_rank) {
+    std::shared_ptr<TransportContext> context = TransportContext::find(node_rank);
+    return context ? context->get_poller_stats() : PollerStats{};
+}
+
+void set_poll_spin_budget(uint64_t budget_ns) {
+    if(std::shared_ptr<TransportContext> context = TransportContext::get_default()) {
+        context->set_poll_spin_budget(budget_ns);
+    }
+}
+
+void verbs_destroy() {
+    if(std::shared_ptr<TransportContext> context = TransportContext::get_default()) {
+        context->destroy();
+    }
+}
+
+void verbs_destroy(uint32_t node_rank) {
+    if(std::shared_ptr<TransportContext> context = TransportContext::find(node_rank)) {
+        context->destroy();
+    }
+}
+
 }  // namespace sst
@@ -7,10 +7,25 @@
  * including the Resources class and global setup functions.
  */
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <infiniband/verbs.h>
 
+#include "derecho/derecho_ports.h"
+
+namespace tcp {
+class tcp_connections;
+}
+
 namespace sst {
 
 /** Structure to exchange the data needed to connect the Queue Pairs */
@@ -27,6 +42,121 @@ struct cm_con_data_t {
     uint8_t gid[16];
 } __attribute__((packed));
 
+struct global_resources;
+
+/** The most completion entries the polling thread takes from the queue at once. */
+constexpr int poll_batch_size = 32;
+
+/** How much the SST polling thread has slept, and how quickly it woke up. */
+struct PollerStats {
+    /** Nanoseconds since the polling thread started. */
+    uint64_t elapsed_ns;
+    /** Nanoseconds it spent asleep, waiting for requests or completion events. */
+    uint64_t idle_ns;
+    /** Times it slept because no thread was waiting for a completion. */
+    uint64_t request_sleeps;
+    /** Times it slept on the completion channel after its spin budget ran out. */
+    uint64_t channel_sleeps;
+    /** Average time from a thread starting to wait for completions to the
+     * sleeping polling thread resuming, in nanoseconds. */
+    uint64_t avg_wakeup_latency_ns;
+};
+/**
+ * The RDMA resources of one node in this process: its device handle,
+ * completion queue and polling thread, and its TCP connections to other
+ * nodes. All the SSTs of a node share its context, while each node a process
+ * runs has its own, so several nodes can share a process without sharing
+ * node ids, connections or completions.
+ */
+class TransportContext {
+    /** The device, protection domain and completion queue, once created. */
+    global_resources* g_res = nullptr;
+    std::atomic<bool> shutdown{false};
+
+    /** The TCP connections made on one port. */
+    struct port_connections {
+        std::unique_ptr<tcp::tcp_connections> connections;
+        /** Set while the connections are being made, without holding resources_mutex. */
+        bool connecting = true;
+    };
+    /** Guards g_res, connections and num_users. */
+    std::mutex resources_mutex;
+    /** The TCP connections to other nodes, keyed by the port they were made on. */
+    std::map<uint32_t, port_connections> connections;
+    /** Notified when the connections on a port have been made, or have failed. */
+    std::condition_variable connections_made;
+    /** The number of initialize calls sharing g_res and the polling thread. */
+    uint32_t num_users = 0;
+    /** Joined once it has been shut down, before another is started. */
+    std::thread polling_thread;
+
+    std::atomic<uint64_t> poll_spin_budget_ns{100000};
+    std::atomic<uint64_t> poll_start_ns{0};
+    std::atomic<uint64_t> poll_idle_ns{0};
+    std::atomic<uint64_t> poll_request_sleeps{0};
+    std::atomic<uint64_t> poll_channel_sleeps{0};
+    std::atomic<uint64_t> poll_wakeup_latency_ns{0};
+    std::atomic<uint64_t> poll_wakeups{0};
+
+    /** Opens the device and starts the polling thread, after joining the
+     * previous one, if any. */
+    void create_resources();
+    void polling_loop();
+
+    friend class resources;
+
+public:
+    /** The id of the node this context connects as. */
+    const uint32_t node_rank;
+
+    explicit TransportContext(uint32_t node_rank);
+    TransportContext(const TransportContext&) = delete;
+    ~TransportContext();
+
+    /** @return the context of the node with this id, creating it on first use. */
+    static std::shared_ptr<TransportContext> get(uint32_t node_rank);
+    /** @return the context of the node with this id, or nullptr if there is none. */
+    static std::shared_ptr<TransportContext> find(uint32_t node_rank);
+    /** @return the first context created in this process, or nullptr if there
+     * is none; used by the functions that do not take a context. */
+    static std::shared_ptr<TransportContext> get_default();
+
+    /**
+     * Connects to the given nodes over TCP on tcp_port and, on the first call,
+     * creates the device resources and the polling thread; this includes the
+     * first call after the last destroy, so a node can be set up again once
+     * it has been torn down. A call on a port
+     * already set up adds any nodes it is not yet connected to. Setting up the
+     * connections holds no lock that calls for other ports wait on, since such
+     * a call may be waiting on a node that is itself still connecting on this
+     * port.
+     * @return false if the polling thread was shut down while the context is
+     * still in use
+     */
+    bool initialize(const std::map<uint32_t, std::string>& ip_addrs, uint32_t tcp_port);
+    /** Releases one initialize call's share of the resources; the last stops
+     * the polling thread and waits for it to exit. */
+    void destroy();
+
+    /**
+     * @return the connections made on tcp_port, waiting if they are still
+     * being made, or nullptr if there are none.
+     */
+    tcp::tcp_connections* connections_on(uint32_t tcp_port);
+    bool add_node(uint32_t new_id, const std::string& new_ip_addr, uint32_t tcp_port);
+    bool sync(uint32_t r_index, uint32_t tcp_port);
+
+    /** Polls for completion of a single posted remote write. */
+    std::pair<uint32_t, std::pair<int, int>> poll_completion();
+    /** Polls for completion of one or more posted remote writes. */
+    void poll_completions(std::vector<std::pair<uint32_t, std::pair<int, int>>>& completions);
+    /** @return the polling thread's idle time and wakeup latency so far. */
+    PollerStats get_poller_stats() const;
+    /** See sst::set_poll_spin_budget. */
+    void set_poll_spin_budget(uint64_t budget_ns);
+    void shutdown_polling_thread();
+};
+
 /**
  * Represents the set of RDMA resources needed to maintain a two-way connection
  * to a single remote node.
@@ -41,12 +171,22 @@ private:
     void set_qp_ready_to_send();
     /** Connect the queue pairs. */
     void connect_qp();
+    /** @return the data the remote side needs to connect to this queue pair, in network byte order. */
+    cm_con_data_t local_connection_data();
+    /** Moves the queue pair to the ready-to-send state, given the remote side's connection data. */
+    void finish_connect_qp(const cm_con_data_t& tmp_con_data);
+
+    friend void connect_all(const std::vector<resources*>& peers);
     /** Post a remote RDMA operation. */
     int post_remote_send(const uint32_t id, const long long int offset, const long long int size, const int op, const bool completion);
 
 public:
+    /** The context of the local node. */
+    const std::shared_ptr<TransportContext> context;
     /** Index of the remote node. */
     int remote_index;
+    /** Port of the TCP connection to the remote node. */
+    uint32_t tcp_port;
     /** Handle for the IB Verbs Queue Pair object. */
     struct ibv_qp *qp;
     /** Memory Region handle for the write buffer. */
@@ -63,8 +203,13 @@ public:
 
     /** Constructor; initializes Queue Pair, Memory Regions, and `remote_props`.
      */
+    resources(std::shared_ptr<TransportContext> context, int r_index, char *write_addr,
+              char *read_addr, int size_w, int size_r, bool connect = true,
+              uint32_t tcp_port = derecho::sst_tcp_port);
+    /** Constructs resources in the default context. */
     resources(int r_index, char *write_addr, char *read_addr, int size_w,
-              int size_r);
+              int size_r, bool connect = true,
+              uint32_t tcp_port = derecho::sst_tcp_port);
     /** Destroys the resources. */
     virtual ~resources();
     /*
@@ -84,16 +229,48 @@ public:
     void post_remote_write_with_completion(const uint32_t id, const long long int offset, const long long int size);
 };
 
-bool add_node(uint32_t new_id, const std::string new_ip_addr);
-bool sync(uint32_t r_index);
-/** Initializes the global verbs resources. */
-void verbs_initialize(const std::map<uint32_t, std::string> &ip_addrs,
-                      uint32_t node_rank);
-/** Polls for completion of a single posted remote write. */
+/** Adds a node to the connections of the default context. */
+bool add_node(uint32_t new_id, const std::string new_ip_addr,
+              uint32_t tcp_port = derecho::sst_tcp_port);
+/** Exchanges a byte with a node over the connections of the default context. */
+bool sync(uint32_t r_index, uint32_t tcp_port = derecho::sst_tcp_port);
+/**
+ * Connects the queue pairs of resources constructed with connect = false.
+ * Each step of the handshake is sent to every peer before any reply is
+ * awaited, so the round trips to the peers overlap instead of adding up.
+ */
+void connect_all(const std::vector<resources*>& peers);
+/**
+ * Initializes the context of node_rank; see TransportContext::initialize.
+ * Calls with different node ranks set up separate contexts.
+ */
+bool verbs_initialize(const std::map<uint32_t, std::string> &ip_addrs,
+                      uint32_t node_rank,
+                      uint32_t tcp_port = derecho::sst_tcp_port);
+/** @return the default context's polling thread's idle time and wakeup latency so far. */
+PollerStats get_poller_stats();
+/** @return the idle time and wakeup latency so far of the polling thread of
+ * node_rank's context, if it has one. */
+PollerStats get_poller_stats(uint32_t node_rank);
+/**
+ * Sets how long the default context's polling thread spins on an empty
+ * completion queue, while threads are waiting for completions, before it
+ * sleeps on the completion channel. 0 sleeps right away; the default is 100
+ * microseconds.
+ */
+void set_poll_spin_budget(uint64_t budget_ns);
+/** Polls the default context for completion of a single posted remote write. */
 std::pair<uint32_t, std::pair<int, int>> verbs_poll_completion();
+/** Polls the default context for completion of one or more posted remote writes. */
+void verbs_poll_completions(std::vector<std::pair<uint32_t, std::pair<int, int>>>& completions);
+/** Stops the default context's polling thread. */
 void shutdown_polling_thread();
-/** Destroys the global verbs resources. */
+/** Stops the polling thread of node_rank's context, if it has one. */
+void shutdown_polling_thread(uint32_t node_rank);
+/** Releases one verbs_initialize call's share of the default context. */
 void verbs_destroy();
+/** Releases one verbs_initialize call's share of node_rank's context. */
+void verbs_destroy(uint32_t node_rank);
 
 }  // namespace sst
 
@@ -4,12 +4,17 @@
 #include <algorithm>
 #include <arpa/inet.h>
 #include <cerrno>
+#include <chrono>
 #include <cstring>
+#include <fcntl.h>
 #include <iostream>
 #include <netdb.h>
+#include <sys/epoll.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <thread>
 #include <unistd.h>
+#include <vector>
 
 namespace tcp {
 
@@ -145,7 +150,8 @@ connection_listener::connection_listener(int port) {
                 strerror(errno));
 	std::cout << "Port is: " << port << std::endl;
     }
-    listen(listenfd, 5);
+    // Every node of a new group may connect at once
+    listen(listenfd, SOMAXCONN);
 
     fd = unique_ptr<int, std::function<void(int *)>>(
             new int(listenfd), [](int *fd) { close(*fd); delete fd; });
@@ -172,4 +178,152 @@ socket connection_listener::accept() {
 
     return socket(sock, std::string(client_ip_cstr));
 }
+
+std::map<uint32_t, socket> connect_all(const std::map<uint32_t, std::string>& servers, int port) {
+    std::map<uint32_t, sockaddr_in> server_addrs;
+    std::map<uint32_t, string> server_ips;
+    for(const auto& server : servers) {
+        hostent* host = gethostbyname(server.second.c_str());
+        if(host == nullptr) throw connection_failure();
+
+        char server_ip_cstr[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, host->h_addr, server_ip_cstr, sizeof(server_ip_cstr));
+        server_ips[server.first] = string(server_ip_cstr);
+
+        sockaddr_in& serv_addr = server_addrs[server.first];
+        memset(&serv_addr, 0, sizeof(serv_addr));
+        serv_addr.sin_family = AF_INET;
+        serv_addr.sin_port = htons(port);
+        bcopy((char*)host->h_addr, (char*)&serv_addr.sin_addr.s_addr,
+              host->h_length);
+    }
+
+    int epoll_fd = epoll_create1(0);
+    if(epoll_fd < 0) throw connection_failure();
+
+    std::map<uint32_t, socket> connected;
+    // Sockets whose connect is in progress, by file descriptor
+    std::map<int, uint32_t> pending;
+    std::vector<uint32_t> to_start;
+    for(const auto& server : server_addrs) {
+        to_start.push_back(server.first);
+    }
+    while(!to_start.empty() || !pending.empty()) {
+        std::vector<uint32_t> refused;
+        for(uint32_t id : to_start) {
+            int sock = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            if(sock < 0) {
+                close(epoll_fd);
+                throw connection_failure();
+            }
+            if(connect(sock, (sockaddr*)&server_addrs[id], sizeof(sockaddr_in)) == 0) {
+                fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) & ~O_NONBLOCK);
+                connected[id] = socket(sock, server_ips[id]);
+            } else if(errno == EINPROGRESS) {
+                epoll_event event;
+                event.events = EPOLLOUT;
+                event.data.fd = sock;
+                epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock, &event);
+                pending[sock] = id;
+            } else {
+                close(sock);
+                refused.push_back(id);
+            }
+        }
+
+        if(!pending.empty()) {
+            epoll_event events[64];
+            int num_events = epoll_wait(epoll_fd, events, 64, 10);
+            for(int i = 0; i < num_events; ++i) {
+                int sock = events[i].data.fd;
+                uint32_t id = pending.at(sock);
+                pending.erase(sock);
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, sock, nullptr);
+                int error = 0;
+                socklen_t len = sizeof(error);
+                getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &len);
+                if(error == 0) {
+                    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) & ~O_NONBLOCK);
+                    connected[id] = socket(sock, server_ips[id]);
+                } else {
+                    close(sock);
+                    refused.push_back(id);
+                }
+            }
+        }
+        // Give servers that are not listening yet a moment before retrying
+        if(!refused.empty() && pending.empty()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        to_start = std::move(refused);
+    }
+    close(epoll_fd);
+    return connected;
+}
+
+std::map<uint32_t, socket> establish_connections(uint32_t my_id,
+                                                 const std::map<uint32_t, std::string>& addresses,
+                                                 int port, connection_listener& listener) {
+    std::map<uint32_t, std::string> lower_nodes;
+    size_t num_higher_nodes = 0;
+    for(const auto& node : addresses) {
+        if(node.first < my_id) {
+            lower_nodes.insert(node);
+        } else if(node.first > my_id) {
+            num_higher_nodes++;
+        }
+    }
+
+    // Nodes with higher IDs connect to this one, in whatever order they get to it
+    std::map<uint32_t, socket> accepted;
+    std::thread accept_thread([&]() {
+        try {
+            for(size_t i = 0; i < num_higher_nodes; ++i) {
+                socket s = listener.accept();
+                uint32_t remote_id = 0;
+                if(!s.exchange(my_id, remote_id)) {
+                    std::cerr << "WARNING: failed to exchange id with node" << std::endl;
+                    continue;
+                }
+                accepted[remote_id] = std::move(s);
+            }
+        } catch(exception) {
+            std::cerr << "Got error while attempting to listen on port " << port << std::endl;
+        }
+    });
+
+    std::map<uint32_t, socket> sockets;
+    try {
+        sockets = connect_all(lower_nodes, port);
+    } catch(exception) {
+        std::cerr << "WARNING: failed to connect to the nodes with lower IDs" << std::endl;
+    }
+    // Send this node's ID on every socket before waiting for any reply
+    for(auto& s : sockets) {
+        if(!s.second.write(my_id)) {
+            std::cerr << "WARNING: failed to send id to node " << s.first << std::endl;
+        }
+    }
+    for(auto it = sockets.begin(); it != sockets.end();) {
+        uint32_t remote_id = 0;
+        if(!it->second.read(remote_id)) {
+            std::cerr << "WARNING: failed to exchange id with node " << it->first
+                      << " at " << lower_nodes.at(it->first) << ":" << port << std::endl;
+            it = sockets.erase(it);
+        } else if(remote_id != it->first) {
+            std::cerr << "WARNING: node at " << lower_nodes.at(it->first) << ":" << port
+                      << " replied with wrong id (expected " << it->first
+                      << " but got " << remote_id << ")" << std::endl;
+            it = sockets.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    accept_thread.join();
+    for(auto& s : accepted) {
+        sockets[s.first] = std::move(s.second);
+    }
+    return sockets;
+}
 }
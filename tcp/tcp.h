@@ -2,7 +2,9 @@
 #ifndef CONNECTION_H
 #define CONNECTION_H
 
+#include <cstdint>
 #include <functional>
+#include <map>
 #include <memory>
 #include <string>
 
@@ -20,6 +22,7 @@ class socket {
             : sock(_sock), remote_ip(remote_ip) {}
 
     friend class connection_listener;
+    friend std::map<uint32_t, socket> connect_all(const std::map<uint32_t, std::string>& servers, int port);
 
 public:
     std::string remote_ip;
@@ -122,6 +125,36 @@ public:
      */
     socket accept();
 };
+
+/**
+ * Connects to several servers at once: starts a non-blocking connect to each
+ * of them and waits for all of them together with epoll. Connections that are
+ * refused, because the server is not listening yet, are retried until they
+ * succeed, just like the blocking socket constructor does.
+ * @param servers A map from node ID to the address of each server
+ * @param port The port the servers are listening on
+ * @return A map from node ID to a connected socket, for every server
+ */
+std::map<uint32_t, socket> connect_all(const std::map<uint32_t, std::string>& servers, int port);
+
+/**
+ * Opens a socket to every node in the map except this one, with all the
+ * connection setup overlapped: this node connects to all the nodes with
+ * lower IDs at once, while a second thread accepts connections from the
+ * nodes with higher IDs, and the node IDs sent over each socket are
+ * verified. The connections are the same as those of connecting to each
+ * node in turn, but a group of n nodes starts in roughly one round trip
+ * instead of n.
+ * @param my_id The ID of this node
+ * @param addresses A map from node ID to address, including this node's
+ * @param port The port all the nodes listen on
+ * @param listener A listener on that port, bound before any node connects
+ * @return A map from node ID to a connected socket; nodes that could not be
+ * connected to are missing from it
+ */
+std::map<uint32_t, socket> establish_connections(uint32_t my_id,
+                                                 const std::map<uint32_t, std::string>& addresses,
+                                                 int port, connection_listener& listener);
 }
 
 #endif /* CONNECTION_H */
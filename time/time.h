@@ -2,9 +2,15 @@
 #ifndef TIME_TIME_H
 #define TIME_TIME_H
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <sys/resource.h>
 #include <time.h>
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
 
 // Returns the number of nanoseconds since some fixed time in the past.
 inline uint64_t get_time() {
@@ -22,4 +28,171 @@ inline uint64_t get_process_time() {
            (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000L;
 }
 
+// A wall clock read from the CPU's timestamp counter, for timestamps taken on
+// every message. The counter is converted to nanoseconds since the epoch with
+// integer arithmetic, using a rate and offset that are recalibrated against
+// CLOCK_REALTIME every calibration_period_ns by whichever reader finds them
+// stale. A recalibration never moves the clock back: if CLOCK_REALTIME is
+// behind the extrapolated value, the new rate is slowed so the clock converges
+// on it over the next period instead. Where the TSC is not invariant (or not
+// x86-64) it falls back to reading CLOCK_REALTIME directly. Readings on
+// different cores are only comparable if the TSCs are synchronized, which is
+// the case on any CPU that reports an invariant TSC.
+class TscClock {
+public:
+    static constexpr uint64_t calibration_period_ns = 1000000000ull;
+
+private:
+    // The rate is nanoseconds per tick in 32.32 fixed point
+    static constexpr int rate_shift = 32;
+
+    const bool use_tsc;
+    // Calibration parameters, published under a sequence lock: seq is odd
+    // while they are being rewritten
+    std::atomic<uint64_t> seq{0};
+    std::atomic<uint64_t> base_tsc{0};
+    std::atomic<uint64_t> base_ns{0};
+    std::atomic<uint64_t> rate{0};
+    // The counter value after which the parameters should be recalibrated
+    std::atomic<uint64_t> next_calibration_tsc{0};
+    std::atomic_flag calibrating = ATOMIC_FLAG_INIT;
+
+    static uint64_t read_realtime() {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        return now.tv_sec * 1000000000ull + now.tv_nsec;
+    }
+
+    static uint64_t read_tsc() {
+#if defined(__x86_64__)
+        unsigned int aux;
+        return __rdtscp(&aux);
+#else
+        return 0;
+#endif
+    }
+
+    static bool has_invariant_tsc() {
+#if defined(__x86_64__)
+        unsigned int eax, ebx, ecx, edx;
+        if(!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+        return edx & (1u << 8);
+#else
+        return false;
+#endif
+    }
+
+    // Reads the counter and CLOCK_REALTIME as close together as possible
+    static void sample(uint64_t& tsc, uint64_t& ns) {
+        uint64_t best_gap = UINT64_MAX;
+        tsc = ns = 0;
+        for(int i = 0; i < 5; ++i) {
+            const uint64_t before = read_tsc();
+            const uint64_t real = read_realtime();
+            const uint64_t after = read_tsc();
+            if(after - before < best_gap) {
+                best_gap = after - before;
+                tsc = before + (after - before) / 2;
+                ns = real;
+            }
+        }
+    }
+
+    static uint64_t extrapolate(uint64_t tsc, uint64_t base_tsc, uint64_t base_ns, uint64_t rate) {
+        return base_ns + static_cast<uint64_t>((static_cast<unsigned __int128>(tsc - base_tsc) * rate) >> rate_shift);
+    }
+
+    void publish(uint64_t tsc, uint64_t ns, uint64_t new_rate) {
+        seq.fetch_add(1, std::memory_order_acq_rel);
+        base_tsc.store(tsc, std::memory_order_relaxed);
+        base_ns.store(ns, std::memory_order_relaxed);
+        rate.store(new_rate, std::memory_order_relaxed);
+        next_calibration_tsc.store(tsc + (calibration_period_ns << rate_shift) / new_rate, std::memory_order_relaxed);
+        seq.fetch_add(1, std::memory_order_release);
+    }
+
+    void recalibrate() {
+        if(calibrating.test_and_set(std::memory_order_acquire)) {
+            return;
+        }
+        const uint64_t old_tsc = base_tsc.load(std::memory_order_relaxed);
+        const uint64_t old_ns = base_ns.load(std::memory_order_relaxed);
+        const uint64_t old_rate = rate.load(std::memory_order_relaxed);
+        // Keep readers from using the old parameters past this counter value
+        seq.fetch_add(1, std::memory_order_acq_rel);
+        uint64_t tsc, real_ns;
+        sample(tsc, real_ns);
+        seq.fetch_sub(1, std::memory_order_release);
+        uint64_t new_rate = old_rate;
+        if(tsc > old_tsc && real_ns > old_ns) {
+            new_rate = ((real_ns - old_ns) << rate_shift) / (tsc - old_tsc);
+        }
+        const uint64_t clock_ns = extrapolate(tsc, old_tsc, old_ns, old_rate);
+        uint64_t start_ns = real_ns;
+        if(clock_ns > real_ns) {
+            // Absorb at most half of the lead in the next period
+            const uint64_t lead = std::min(clock_ns - real_ns, calibration_period_ns / 2);
+            new_rate -= static_cast<uint64_t>((static_cast<unsigned __int128>(new_rate) * lead) / calibration_period_ns);
+            start_ns = clock_ns;
+        }
+        publish(tsc, start_ns, new_rate);
+        calibrating.clear(std::memory_order_release);
+    }
+
+    TscClock() : use_tsc(has_invariant_tsc()) {
+        if(!use_tsc) {
+            return;
+        }
+        uint64_t start_tsc, start_ns, end_tsc, end_ns;
+        sample(start_tsc, start_ns);
+        struct timespec pause = {0, 10000000};
+        nanosleep(&pause, nullptr);
+        sample(end_tsc, end_ns);
+        publish(end_tsc, end_ns, ((end_ns - start_ns) << rate_shift) / (end_tsc - start_tsc));
+    }
+
+public:
+    static TscClock& instance() {
+        static TscClock clock;
+        return clock;
+    }
+
+    // Returns the number of nanoseconds since the epoch. Never goes backward
+    // on a single thread, even if CLOCK_REALTIME is stepped back.
+    uint64_t now() {
+        if(!use_tsc) {
+            return read_realtime();
+        }
+        while(true) {
+            const uint64_t s = seq.load(std::memory_order_acquire);
+            if(s & 1) {
+                continue;
+            }
+            const uint64_t tsc = read_tsc();
+            const uint64_t t = base_tsc.load(std::memory_order_relaxed);
+            const uint64_t n = base_ns.load(std::memory_order_relaxed);
+            const uint64_t r = rate.load(std::memory_order_relaxed);
+            const uint64_t next = next_calibration_tsc.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(seq.load(std::memory_order_relaxed) != s) {
+                continue;
+            }
+            if(tsc >= next) {
+                recalibrate();
+            }
+            return extrapolate(tsc, t, n, r);
+        }
+    }
+
+    // Returns true if readings come from the TSC rather than the system clock
+    bool is_tsc() const { return use_tsc; }
+};
+
+// Returns the number of nanoseconds since the epoch, from TscClock.
+inline uint64_t get_walltime() {
+    return TscClock::instance().now();
+}
+
 #endif /* TIME_TIME_H */